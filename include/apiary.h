@@ -0,0 +1,112 @@
+#ifndef APIARY_H
+#define APIARY_H
+
+#include "common.h"
+#include "beetable.h"
+#include "supervisor.h"
+#include "checkpoint.h"
+#include "configpage.h"
+
+/**
+ * Largest number of hives in an apiary.
+ */
+#define APIARY_MAX_HIVES 64
+
+/**
+ * Bee IDs of hive h start at h * APIARY_ID_STRIDE, so a bee keeps a unique ID wherever it migrates.
+ */
+#define APIARY_ID_STRIDE 10000000
+
+/**
+ * Interval (in seconds) at which every hive reports its load to the coordinator.
+ */
+#define APIARY_REPORT_INTERVAL 1.0
+
+/**
+ * Difference of population ratios (beesAlive / N) between two hives above which bees are moved.
+ */
+#define APIARY_IMBALANCE 0.2
+
+/**
+ * Largest number of bees moved by a single migration order.
+ */
+#define APIARY_MAX_BATCH 16
+
+/**
+ * Kinds of messages exchanged between the coordinator and the hives.
+ */
+typedef enum {
+    APIARY_MSG_LOAD = 1, ///< Hive -> coordinator: current load of the hive.
+    APIARY_MSG_EMIGRATE, ///< Coordinator -> hive: send `count` bees to hive `hive`.
+    APIARY_MSG_BEE       ///< Either way: a migrating bee, addressed to hive `hive`.
+} ApiaryMessageType;
+
+/**
+ * A message on the socket between the coordinator and a hive (one datagram each).
+ */
+typedef struct {
+    int32_t type;      ///< ApiaryMessageType.
+    int32_t hive;      ///< Reporting hive (LOAD), destination of the bees (EMIGRATE, BEE).
+    int32_t origin;    ///< Hive the bee comes from (BEE).
+    int32_t count;     ///< Number of bees to send (EMIGRATE).
+    int32_t bounced;   ///< Set on a bee sent back to its origin because the destination was full (BEE).
+    int32_t beesAlive; ///< Population of the hive (LOAD).
+    int32_t N;         ///< Hive size (LOAD).
+    int32_t occupancy; ///< Bees inside the hive (LOAD).
+    CheckpointBee bee; ///< State of the migrating bee (BEE).
+} ApiaryMessage;
+
+/**
+ * Runs one hive of the apiary in a child process of the coordinator.
+ *
+ * @param context Caller data given to apiaryRun.
+ * @param hiveIndex Index of the hive (0-based).
+ * @param fd The hive's socket to the coordinator.
+ * @return Exit status of the hive process.
+ */
+typedef int (*ApiaryHiveFunction)(void* context, int hiveIndex, int fd);
+
+/**
+ * apiaryRun:
+ * Starts `hives` hive processes, each connected to the calling process by a Unix-domain
+ * socket pair, and coordinates them until all have exited: hives report their load,
+ * the coordinator orders bees from the most to the least populated hive, and relays
+ * the migrating bees.
+ *
+ * @param hives Number of hives (2 to APIARY_MAX_HIVES).
+ * @param splitCpus Whether to give every hive an equal share of the CPUs of the calling process.
+ * @param run Function running one hive.
+ * @param context Caller data passed to run.
+ * @return 0 if every hive exited successfully, 1 otherwise, or -1 with errno set if the
+ *         hives could not be started or coordinated (those already running are stopped).
+ */
+int apiaryRun(int hives, bool splitCpus, ApiaryHiveFunction run, void* context);
+
+/**
+ * The hive side of the apiary: what a hive's main process needs to report its load,
+ * send emigrants and take in immigrants.
+ */
+typedef struct {
+    int hiveIndex;              ///< Index of the hive.
+    int fd;                     ///< Socket to the coordinator, or -1 once it is gone.
+    HiveData* hive;             ///< Shared hive state.
+    HiveSemaphores* semaphores; ///< Hive locks.
+    BeeTable* table;            ///< Per-bee state table.
+    Supervisor* supervisor;     ///< Supervisor owning the hive's bees.
+    SpawnBeeFunction spawn;     ///< Forks an immigrant that resumes from its slot.
+    void* spawnContext;         ///< Caller data passed to spawn.
+    double nextReport;          ///< CLOCK_MONOTONIC seconds of the next load report.
+    const ConfigPage* config;   ///< Live colony parameters (maxVisits).
+} ApiaryLink;
+
+/**
+ * apiaryService:
+ * Called regularly by a hive's main loop: sends the load report when it is due and
+ * handles every message waiting on the socket, without blocking.
+ *
+ * @param link The hive's link to the coordinator.
+ * @param now Current CLOCK_MONOTONIC time in seconds.
+ */
+void apiaryService(ApiaryLink* link, double now);
+
+#endif
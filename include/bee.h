@@ -2,6 +2,9 @@
 #define BEE_H
 
 #include "common.h"
+#include "beetable.h"
+#include "eventbus.h"
+#include "configpage.h"
 
 /**
  * The BeeArgs struct contains all the necessary data for each bee process.
@@ -11,13 +14,16 @@
 typedef struct {
     int id;         ///< Unique ID of the bee.
     int visits;     ///< Number of visits the bee has made to the hive.
-    int maxVisits;  ///< Maximum number of visits after which the bee dies.
-    int T_inHive;   ///< Time (in seconds) the bee spends inside the hive during each visit.
     HiveData* hive; ///< Pointer to the shared memory structure representing the hive state.
     HiveSemaphores* semaphores; ///< Pointer to the shared semaphore structure for synchronization.
     bool startInHive; ///< Indicates whether the bee starts its life inside the hive.
     int semid;      ///< Shared memory identifier for semaphores.
     int shmid;      ///< Shared memory identifier for hive data.
+    BeeTable* table; ///< Per-bee state table shared by the colony.
+    int slot;       ///< Slot of this bee in the table.
+    bool resume;    ///< Continue from the lifecycle state recorded in the slot (restored checkpoint).
+    EventBus* events; ///< Event bus receiving the bee's queue, enter, leave, reject and death events.
+    const ConfigPage* config; ///< Live colony parameters, read at every step of the lifecycle.
 } BeeArgs;
 
 /**
@@ -28,7 +34,7 @@ typedef struct {
  * - Attaches to shared memory for hive data and semaphores.
  * - Manages the bee's lifecycle, including entering and leaving the hive.
  * - Synchronizes hive access using semaphores to ensure proper concurrent behavior.
- * - Logs relevant events such as entering, exiting, and dying.
+ * - Publishes its lifecycle events to the event bus and logs them once its locks are released.
  * - Cleans up shared memory attachments before termination.
  * 
  * @param arg A pointer to a BeeArgs structure containing the bee's individual and shared parameters.
@@ -0,0 +1,232 @@
+#ifndef BEEHIVE_H
+#define BEEHIVE_H
+
+#include "common.h"
+#include "placement.h"
+#include "eventbus.h"
+#include "configpage.h"
+
+/**
+ * libbeehive: the colony engine behind beehive_simulation, embeddable in other programs.
+ *
+ * Every Beehive is an isolated colony with its own shared memory, bee table, supervisor and
+ * child processes (queen, beekeeper, bees), so any number of them can run in one process.
+ * The library never exits or changes signal dispositions of the calling process: failures
+ * are returned and reported through the instance's error callback. Log messages of an
+ * instance, including those of its child processes, go to its log callback.
+ *
+ * The calling thread drives an instance with beehiveStep; an instance must not be used by
+ * two threads at once, but different instances may be stepped from different threads.
+ * The colony's processes are killed when the thread that forked them exits, so the threads
+ * that create and step an instance must outlive it.
+ */
+
+/**
+ * Reports a failure of a library call.
+ *
+ * @param user Caller data given in BeehiveOptions.
+ * @param message What failed.
+ * @param errnum errno value of the failure (0 if none).
+ */
+typedef void (*BeehiveErrorFunction)(void* user, const char* message, int errnum);
+
+/**
+ * Parameters of a colony. Fill with beehiveDefaultOptions, then override.
+ */
+typedef struct {
+    int N;                          ///< Initial hive size (ignored when restoring).
+    int T_k;                        ///< Queen's egg-laying interval in seconds.
+    int eggsCount;                  ///< Eggs laid per cycle.
+    int maxVisits;                  ///< Visits after which a bee dies.
+    int T_inHive;                   ///< Time a bee spends inside the hive per visit.
+    int capacity;                   ///< Bees alive at once (0: max(N, BEE_TABLE_DEFAULT_CAPACITY), or maxBees of the configuration file if larger).
+    const char* configPath;         ///< Configuration file applied over these options (see configLoad), or NULL.
+    bool hugePages;                 ///< Back the bee table with huge pages.
+    size_t eventCapacity;           ///< Events kept by the event bus (0: EVENT_BUS_DEFAULT_CAPACITY).
+    double targetUtilization;       ///< Adaptive laying target (0 disables it).
+    const char* restorePath;        ///< Checkpoint to resume, or NULL.
+    const char* metricsAddress;     ///< Port or socket path of the metrics endpoint, or NULL.
+    int apiaryHive;                 ///< Index of the hive in an apiary, or -1.
+    int apiaryFd;                   ///< Socket to the apiary coordinator, or -1.
+    const PlacementConfig* placement; ///< CPU and NUMA placement, or NULL for none.
+    LogSink log;                    ///< Destination of the instance's log (no function: the global logConfig).
+    BeehiveErrorFunction error;     ///< Called on failures, or NULL.
+    void* errorUser;                ///< Caller data passed to error.
+} BeehiveOptions;
+
+/**
+ * State and statistics of a colony, as returned by beehiveQuery.
+ */
+typedef struct {
+    int occupancy;                 ///< Bees inside the hive.
+    int N;                         ///< Current hive size.
+    int capacity;                  ///< calculateP(N).
+    int beesAlive;                 ///< Living bees.
+    int queued[2];                 ///< Bees queued at each entrance.
+    int entries;                   ///< Successful entries.
+    int rejections;                ///< Entry attempts refused because the hive was full.
+    int deaths;                    ///< Bees that died.
+    int emigrations;               ///< Bees sent to other hives of an apiary.
+    int immigrations;              ///< Bees received from other hives of an apiary.
+    unsigned long eggsLaid;        ///< Eggs laid by the queen.
+    unsigned long eggsSkipped;     ///< Eggs not laid for lack of space.
+    unsigned long transits[2];     ///< Passages through each entrance.
+    int lockRecoveries;            ///< Locks recovered from dead owners.
+    unsigned long lockAcquisitions[HIVE_MAX_NODES]; ///< Hive and frame lock acquisitions per NUMA node.
+    unsigned long crossNodeHandoffs; ///< Hive and frame lock handoffs between NUMA nodes.
+    HiveTunables tunables;         ///< Current values of the live parameters.
+    unsigned long configVersion;   ///< Version of the configuration page they were read from.
+    CohortStats cohorts[BEE_COHORTS]; ///< Lifetime statistics of the bees that died, per BeeCohort.
+    double elapsed;                ///< Seconds since the colony was created (or stopped).
+    double meanOccupancy;          ///< Mean of the occupancy samples.
+    int maxOccupancy;              ///< Highest sampled occupancy.
+    double survivalTime;           ///< Seconds until no bee was alive, or -1.
+    int beeExits;                  ///< Bee processes reaped.
+    int abnormalExits;             ///< Processes that were killed or failed.
+    double meanBeeLifetime;        ///< Mean lifetime of reaped bees in seconds.
+    double maxBeeLifetime;         ///< Longest lifetime of a reaped bee in seconds.
+    pid_t beekeeperPid;            ///< Beekeeper process (signal it to resize the hive).
+    bool running;                  ///< Whether the colony still has processes.
+} BeehiveStatus;
+
+/**
+ * Colony parameters that beehiveSet can change while the colony runs.
+ */
+typedef enum {
+    BEEHIVE_PARAM_N,                ///< Hive size (number of frames), from 1 to the capacity.
+    BEEHIVE_PARAM_T_K,              ///< Queen's egg-laying interval in seconds (at least 1).
+    BEEHIVE_PARAM_EGGS_COUNT,       ///< Eggs laid per cycle (at least 1).
+    BEEHIVE_PARAM_T_IN_HIVE,        ///< Time a bee spends inside the hive per visit in seconds.
+    BEEHIVE_PARAM_MAX_VISITS,       ///< Visits after which a bee dies (at least 1).
+    BEEHIVE_PARAM_MIN_OUTSIDE_TIME, ///< Shortest flight outside in seconds (at most the longest).
+    BEEHIVE_PARAM_MAX_OUTSIDE_TIME, ///< Longest flight outside in seconds (at least the shortest).
+    BEEHIVE_PARAM_TRANSIT_MS,       ///< Time a bee takes to pass through an entrance in milliseconds.
+    BEEHIVE_PARAM_MAX_BEES,         ///< Bees alive at once, from 1 to the capacity.
+    BEEHIVE_PARAM_COUNT
+} BeehiveParameter;
+
+/**
+ * Opaque handle to a colony.
+ */
+typedef struct Beehive Beehive;
+
+/**
+ * Fills options with the defaults of beehive_simulation; N, T_k and eggsCount must be set.
+ *
+ * @param options Options to initialize.
+ */
+void beehiveDefaultOptions(BeehiveOptions* options);
+
+/**
+ * beehiveCreate:
+ * Sets up the shared state of a colony and starts its queen, beekeeper and initial bees
+ * (or the bees of a checkpoint).
+ *
+ * @param options Parameters of the colony.
+ * @return The colony, or NULL on failure (everything already started is torn down).
+ */
+Beehive* beehiveCreate(const BeehiveOptions* options);
+
+/**
+ * beehiveStep:
+ * Advances the colony's supervision for up to timeoutMs: samples occupancy, forks
+ * requested bees, reaps exits, and serves the metrics endpoint and apiary link.
+ *
+ * @param beehive The colony.
+ * @param timeoutMs Longest time to wait for events in milliseconds.
+ * @return 1 while the colony runs, 0 once every process has exited or the beekeeper was
+ *         asked to stop the simulation (SIGINT), or -1 on failure.
+ */
+int beehiveStep(Beehive* beehive, int timeoutMs);
+
+/**
+ * Writes a checkpoint of the running colony (see checkpointWrite).
+ *
+ * @param beehive The colony.
+ * @param path Destination file.
+ * @return 0 on success, or -1 on failure.
+ */
+int beehiveCheckpoint(Beehive* beehive, const char* path);
+
+/**
+ * Returns the name of a parameter ("N", "T_k", "eggsCount", "T_inHive", "maxVisits",
+ * "minOutsideTime", "maxOutsideTime", "transitMs", "maxBees"), or NULL for an invalid one.
+ *
+ * @param parameter The parameter.
+ * @return The name.
+ */
+const char* beehiveParameterName(BeehiveParameter parameter);
+
+/**
+ * beehiveSet:
+ * Changes a colony parameter while the colony runs. The queen and the bees pick up the
+ * new value at their next cycle or lifecycle step; N changes under the hive lock, as a
+ * resize by the beekeeper would.
+ *
+ * @param beehive The colony.
+ * @param parameter The parameter.
+ * @param value The new value.
+ * @return 0 on success, or -1 if the value is out of range (errno EINVAL).
+ */
+int beehiveSet(Beehive* beehive, BeehiveParameter parameter, int value);
+
+/**
+ * beehiveAddBees:
+ * Adds a burst of bees that start outside the hive, beyond the queen's N limit; the live
+ * maxBees limit of bees alive at once bounds it (and so the capacity of the bee table).
+ *
+ * @param beehive The colony.
+ * @param count Number of bees to add.
+ * @return Number of bees added (none once the colony is shutting down).
+ */
+int beehiveAddBees(Beehive* beehive, int count);
+
+/**
+ * beehiveKillBees:
+ * Kills a share of the living bees, chosen at random, as if they had crashed. Their exits
+ * count as abnormal and their hive counters are reconciled as for any crashed bee.
+ *
+ * @param beehive The colony.
+ * @param fraction Share of the living bees to kill, from 0 to 1.
+ * @param seed State of the random number generator choosing the bees.
+ * @return Number of bees killed, or -1 if fraction is out of range (errno EINVAL).
+ */
+int beehiveKillBees(Beehive* beehive, double fraction, unsigned int* seed);
+
+/**
+ * Reads the state and statistics of the colony.
+ *
+ * @param beehive The colony.
+ * @param status Receives the state.
+ */
+void beehiveQuery(const Beehive* beehive, BeehiveStatus* status);
+
+/**
+ * Returns the colony's event bus, to be read with eventBusSubscribe and eventBusNext from
+ * the calling process. Tools in other processes map it by the name logged at creation
+ * (EventBus.path) with eventBusAttach.
+ *
+ * @param beehive The colony.
+ * @return The event bus; valid until beehiveDestroy.
+ */
+const EventBus* beehiveEvents(const Beehive* beehive);
+
+/**
+ * beehiveStop:
+ * Flags the colony as shutting down, stops all of its processes with one signal to their
+ * process group, and waits for them; those still running after a short drain period are
+ * killed. The statistics stay available to beehiveQuery.
+ *
+ * @param beehive The colony.
+ * @return 0 on success, or -1 on failure.
+ */
+int beehiveStop(Beehive* beehive);
+
+/**
+ * Stops the colony if it still runs and releases all of its resources.
+ *
+ * @param beehive The colony.
+ */
+void beehiveDestroy(Beehive* beehive);
+
+#endif
@@ -2,6 +2,8 @@
 #define BEEKEEPER_H
 
 #include "common.h"
+#include "beetable.h"
+#include "eventbus.h"
 
 /**
  * The BeekeeperArgs struct is used to pass necessary data to the beekeeper process.
@@ -13,6 +15,8 @@ typedef struct {
     HiveSemaphores* semaphores; // Pointer to the shared semaphore structure used for synchronization.
     int semid;                 // Shared memory identifier for semaphores.
     int shmid;                 // Shared memory identifier for hive data.
+    BeeTable* table;           // Per-bee state table, used to repair the hive after a lock owner died.
+    EventBus* events;          // Event bus receiving a resize event per change of N.
 } BeekeeperArgs;
 
 /**
@@ -28,11 +32,11 @@ typedef struct {
  * - Sets up signal handlers to handle:
  *   1. SIGUSR1: Add frames to the hive.
  *   2. SIGUSR2: Remove frames from the hive.
- *   3. SIGINT: Perform cleanup and release shared memory and semaphores.
- * - Operates in an infinite loop to ensure it remains active and responsive.
+ *   3. SIGINT: Request a coordinated shutdown of the colony (see requestShutdown).
+ * - Stays active and responsive until the colony shuts down.
  *
  * @param arg A pointer to a BeekeeperArgs structure containing shared memory and synchronization details.
  */
 void beekeeperWorker(BeekeeperArgs* arg);
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
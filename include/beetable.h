@@ -0,0 +1,221 @@
+#ifndef BEETABLE_H
+#define BEETABLE_H
+
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * Default capacity of the per-bee state table when none is given on the command line.
+ */
+#define BEE_TABLE_DEFAULT_CAPACITY MAX_BEES
+
+/**
+ * Lifecycle state of a bee as recorded in its slot.
+ * Every transition happens while the bee holds the hive lock or the lock of a frame, so
+ * with all of them held the counters in HiveData can always be recomputed from the table.
+ */
+typedef enum {
+    BEE_SLOT_FREE = 0,   ///< Slot is unused (bee died or was never born).
+    BEE_SLOT_OUTSIDE,    ///< Flying outside the hive.
+    BEE_SLOT_QUEUED_IN,  ///< Counted in beesWaiting[entrance], waiting to enter.
+    BEE_SLOT_INSIDE,     ///< Counted in currentBeesInHive and on its frame.
+    BEE_SLOT_QUEUED_OUT  ///< Counted in currentBeesInHive, on its frame and in beesWaiting[entrance], waiting to leave.
+} BeeSlotState;
+
+/**
+ * Slot flag set while a bee born inside the hive has not left it yet; its first exit
+ * does not count as a visit.
+ */
+#define BEE_SLOT_NEWBORN 0x1u
+
+/**
+ * One entry of the per-bee state table (64 bytes, one cache line).
+ * Written only by the bee that owns it; read by anyone without locking.
+ * Together with HiveData, the slots hold everything needed to checkpoint the colony.
+ */
+typedef struct {
+    int32_t id;        ///< Bee ID.
+    uint8_t state;     ///< BeeSlotState.
+    uint8_t entrance;  ///< Entrance of the current or last queue.
+    uint16_t visits;   ///< Completed visits.
+    pid_t pid;         ///< Process of the bee (0 until the bee starts running).
+    uint32_t next;     ///< Free-list link (slot index + 1, 0 terminates the list).
+    uint32_t seed;     ///< RNG state of the bee when its current pause started.
+    uint16_t flags;    ///< BEE_SLOT_* flags.
+    uint16_t frame;    ///< Frame the bee is on while inside, and the one it returns to first.
+    int64_t bornAt;    ///< CLOCK_REALTIME nanoseconds when the slot was acquired.
+    int64_t changedAt; ///< CLOCK_REALTIME nanoseconds of the last state change.
+    int64_t wakeAt;    ///< CLOCK_MONOTONIC nanoseconds at which the current pause ends, or 0 if none is running.
+    uint32_t queueMs;  ///< Time spent queued at the entrances before the current state, in milliseconds.
+    uint32_t insideMs; ///< Time spent inside the hive before the current state, in milliseconds.
+    uint32_t outsideMs; ///< Time spent outside the hive before the current state, in milliseconds.
+    uint16_t rejections; ///< Entry attempts refused because the hive was full.
+    uint8_t cohort;    ///< BeeCohort.
+    uint8_t reserved;
+} BeeSlot;
+
+/**
+ * Time a bee spent in each part of its lifecycle, up to a given moment.
+ */
+typedef struct {
+    uint32_t queueMs;   ///< Queued at the entrances, in milliseconds.
+    uint32_t insideMs;  ///< Inside the hive.
+    uint32_t outsideMs; ///< Outside the hive.
+} BeeTimes;
+
+/**
+ * Header of the per-bee state table, followed by `capacity` slots.
+ * The table lives in a POSIX shared memory object (or a hugetlbfs file) so that
+ * external tools can map it by name while the colony runs.
+ */
+typedef struct {
+    uint64_t capacity;  ///< Number of slots.
+    uint64_t freeHead;  ///< Tagged head of the free list: (tag << 32) | (slot index + 1).
+    int32_t used;       ///< Slots currently acquired.
+    int32_t highWater;  ///< Largest number of slots acquired at once.
+    size_t mappedBytes; ///< Size of the mapping (rounded to the page size in use).
+    bool hugePages;     ///< Whether the table is backed by hugetlbfs pages.
+    char path[128];     ///< shm_open name, or hugetlbfs file path when hugePages is set.
+    BeeSlot slots[];    ///< The slots.
+} BeeTable;
+
+/**
+ * Creates the per-bee state table for the current simulation.
+ * With hugePages set, the table is placed on a mounted hugetlbfs; if none is
+ * available it falls back to a POSIX shared memory object advised for
+ * transparent huge pages.
+ *
+ * @param capacity Maximum number of bees alive at the same time.
+ * @param hugePages Whether to back the table with huge pages.
+ * @return Pointer to the mapped table, or NULL on failure.
+ */
+BeeTable* beeTableCreate(size_t capacity, bool hugePages);
+
+/**
+ * Maps an existing table read-only, e.g. from a monitoring tool.
+ *
+ * @param path Name or path recorded in the table (as logged by the main process).
+ * @return Pointer to the mapped table, or NULL on failure.
+ */
+const BeeTable* beeTableAttach(const char* path);
+
+/**
+ * Unmaps a table mapped with beeTableAttach.
+ *
+ * @param table The table to unmap.
+ */
+void beeTableDetach(const BeeTable* table);
+
+/**
+ * Unmaps the table and removes its shared memory object or file.
+ *
+ * @param table The table to destroy.
+ */
+void beeTableDestroy(BeeTable* table);
+
+/**
+ * Takes a free slot for a new bee (lock-free).
+ *
+ * @param table The bee table.
+ * @param id ID of the bee.
+ * @param state Initial lifecycle state.
+ * @return Slot index, or -1 if the table is full.
+ */
+int beeTableAcquire(BeeTable* table, int id, BeeSlotState state);
+
+/**
+ * Returns a slot to the free list when its bee dies (lock-free).
+ *
+ * @param table The bee table.
+ * @param slot Slot index returned by beeTableAcquire.
+ */
+void beeTableRelease(BeeTable* table, int slot);
+
+/**
+ * Records a lifecycle transition of a bee in its slot. The time spent in the previous
+ * state is added to the bee's queue, inside or outside time.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param state New lifecycle state.
+ * @param visits Completed visits.
+ * @param entrance Entrance used by the transition.
+ */
+void beeTableUpdate(BeeTable* table, int slot, BeeSlotState state, int visits, int entrance);
+
+/**
+ * Records the pause a bee starts in its current state, so a checkpoint can resume it.
+ * Every state change clears the pause.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param wakeAt CLOCK_MONOTONIC nanoseconds at which the pause ends.
+ * @param seed RNG state of the bee after drawing the pause.
+ */
+void beeTableSetPause(BeeTable* table, int slot, int64_t wakeAt, uint32_t seed);
+
+/**
+ * Replaces the BEE_SLOT_* flags of a slot.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param flags New flags.
+ */
+void beeTableSetFlags(BeeTable* table, int slot, uint32_t flags);
+
+/**
+ * Sets the cohort of a bee (BEE_COHORT_INITIAL after beeTableAcquire).
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param cohort The BeeCohort.
+ */
+void beeTableSetCohort(BeeTable* table, int slot, BeeCohort cohort);
+
+/**
+ * Counts an entry attempt of a bee that was refused because the hive was full.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ */
+void beeTableCountRejection(BeeTable* table, int slot);
+
+/**
+ * Restores the history of a bee resumed from a checkpoint or another hive.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param times Time it spent queued, inside and outside so far.
+ * @param rejections Entry attempts refused so far.
+ */
+void beeTableSetHistory(BeeTable* table, int slot, const BeeTimes* times, int rejections);
+
+/**
+ * Returns the time a bee spent queued, inside and outside, including its current state up to now.
+ *
+ * @param slot The bee's slot.
+ * @param times Receives the times.
+ */
+void beeTableTimes(const BeeSlot* slot, BeeTimes* times);
+
+/**
+ * Records the frame a bee takes in the hive (before the transition that puts it there).
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param frame Index of the frame.
+ */
+void beeTableSetFrame(BeeTable* table, int slot, int frame);
+
+/**
+ * Records the process ID of a bee once its process has started.
+ *
+ * @param table The bee table.
+ * @param slot Slot index of the bee.
+ * @param pid Process ID of the bee.
+ */
+void beeTableSetPid(BeeTable* table, int slot, pid_t pid);
+
+#endif
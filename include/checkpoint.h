@@ -0,0 +1,102 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "common.h"
+#include "beetable.h"
+#include <stdint.h>
+
+/**
+ * Identifies a checkpoint file; bumped with CHECKPOINT_VERSION whenever the layout changes.
+ */
+#define CHECKPOINT_MAGIC "BEECKPT"
+#define CHECKPOINT_VERSION 4
+
+/**
+ * Saved state of one living bee (40 bytes).
+ */
+typedef struct {
+    int32_t id;          ///< Bee ID.
+    uint8_t state;       ///< BeeSlotState the bee was in.
+    uint8_t entrance;    ///< Entrance of its current or last queue.
+    uint16_t visits;     ///< Completed visits.
+    uint32_t seed;       ///< RNG state of the bee (0 if it had not drawn anything yet).
+    uint16_t flags;      ///< BEE_SLOT_* flags.
+    uint16_t frame;      ///< Frame the bee was on, or returns to first.
+    int64_t remainingNs; ///< Time left in the pause the bee was in, or -1 if none was running.
+    uint32_t queueMs;    ///< Time spent queued so far, in milliseconds (see BeeTimes).
+    uint32_t insideMs;   ///< Time spent inside the hive so far.
+    uint32_t outsideMs;  ///< Time spent outside the hive so far.
+    uint16_t rejections; ///< Entry attempts refused so far.
+    uint8_t cohort;      ///< BeeCohort.
+    uint8_t reserved;
+} CheckpointBee;
+
+/**
+ * Layout of a checkpoint file: a header followed by one record per living bee.
+ * The file is used in place through a read-only mapping, without any parsing.
+ */
+typedef struct {
+    char magic[8];        ///< CHECKPOINT_MAGIC.
+    uint32_t version;     ///< CHECKPOINT_VERSION.
+    uint32_t hiveSize;    ///< sizeof(HiveData) of the writer.
+    uint32_t beeSize;     ///< sizeof(CheckpointBee) of the writer.
+    uint32_t beeCount;    ///< Number of records in bees.
+    int64_t takenAt;      ///< CLOCK_REALTIME nanoseconds when the snapshot was taken.
+    double elapsed;       ///< Seconds the colony had been running, across earlier restores.
+    HiveData hive;        ///< Hive state at the time of the snapshot.
+    CheckpointBee bees[]; ///< The living bees.
+} Checkpoint;
+
+/**
+ * checkpointWrite:
+ * Snapshots the colony and writes it to a file. The hive lock and every frame lock are
+ * held only while the state is copied: every lifecycle transition happens under one of
+ * them, so HiveData and the bee table are consistent with each other for the duration
+ * of the copy.
+ * The file is written next to its destination and renamed into place.
+ *
+ * @param path Destination file.
+ * @param hive Shared hive state.
+ * @param semaphores Hive locks.
+ * @param table Per-bee state table.
+ * @param elapsed Seconds the colony has been running.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int checkpointWrite(const char* path, HiveData* hive, HiveSemaphores* semaphores, BeeTable* table, double elapsed);
+
+/**
+ * Maps a checkpoint file read-only and validates its header.
+ *
+ * @param path The checkpoint file.
+ * @return The mapped checkpoint, or NULL if the file cannot be read or is not a compatible checkpoint.
+ */
+const Checkpoint* checkpointMap(const char* path);
+
+/**
+ * Unmaps a checkpoint mapped with checkpointMap.
+ *
+ * @param checkpoint The checkpoint.
+ */
+void checkpointUnmap(const Checkpoint* checkpoint);
+
+/**
+ * Restores the hive state of a checkpoint into a freshly initialized HiveData.
+ * Colony state (N, frames, occupancy, queues, population, next bee ID) is carried over; run
+ * statistics start from zero so the summary covers the resumed run only.
+ *
+ * @param checkpoint The checkpoint.
+ * @param hive Shared hive state to fill.
+ */
+void checkpointRestoreHive(const Checkpoint* checkpoint, HiveData* hive);
+
+/**
+ * Gives a saved bee a slot carrying its lifecycle state, RNG state and remaining pause,
+ * ready for a bee process started with BeeArgs.resume.
+ *
+ * @param table Per-bee state table.
+ * @param bee The saved bee.
+ * @return Slot index, or -1 if the table is full.
+ */
+int checkpointRestoreBee(BeeTable* table, const CheckpointBee* bee);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef COHORTS_H
+#define COHORTS_H
+
+#include "common.h"
+#include "beetable.h"
+
+/**
+ * Lifetime statistics per cohort.
+ *
+ * Every bee keeps running totals of its own history in its slot (visits, rejections, time
+ * queued, inside and outside). When it dies, they are folded once into the streaming
+ * statistics of its cohort in HiveData, so the colony-wide picture costs a few doubles per
+ * cohort instead of a record of every event.
+ */
+
+/**
+ * Folds the history of a bee that is dying into the statistics of its cohort (hive lock held).
+ *
+ * @param hive Shared hive state.
+ * @param slot The bee's slot, still acquired.
+ * @param abnormal Whether the bee died without giving back its slot (reclaimed by a repair).
+ */
+void cohortRecord(HiveData* hive, const BeeSlot* slot, bool abnormal);
+
+/**
+ * Returns the standard deviation of a statistic.
+ *
+ * @param stat The statistic.
+ * @param count Number of samples folded into it.
+ * @return The population standard deviation, or 0 with fewer than two samples.
+ */
+double runningStatStddev(const RunningStat* stat, long count);
+
+/**
+ * Returns the name of a cohort ("initial", "queen", "added").
+ *
+ * @param cohort The BeeCohort.
+ * @return A static string.
+ */
+const char* cohortName(int cohort);
+
+#endif
@@ -19,23 +19,46 @@
 #include <time.h>
 #include <semaphore.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 /**
- * Maximum allowed bees in the hive.
- * This constant is used to limit the number of bees that can exist simultaneously.
+ * Number of NUMA nodes tracked by the per-node lock counters; higher nodes are counted in the last one.
+ */
+#define HIVE_MAX_NODES 8
+
+/**
+ * Number of frames the hive's capacity can be laid out on (see frames.h).
+ */
+#define HIVE_MAX_FRAMES 64
+
+/**
+ * Bees a frame is sized for: calculateP(N) is spread over ceil(P / HIVE_FRAME_BEES) frames,
+ * up to HIVE_MAX_FRAMES, beyond which every frame holds more.
+ */
+#define HIVE_FRAME_BEES 8
+
+/**
+ * Default number of bees that can exist simultaneously.
+ * The live limit is maxBees in the colony's configuration page, bounded by the capacity of
+ * the per-bee state table chosen at startup.
  */
 #define MAX_BEES 1000
 
 /**
- * Time (in seconds) a bee spends inside the hive during each visit.
+ * Default time (in seconds) a bee spends inside the hive during each visit.
  */
 #define T_IN_HIVE 3
 
 /**
- * Maximum number of visits a bee can make before it dies.
+ * Default number of visits a bee can make before it dies.
  */
 #define MAX_BEE_VISITS 3
 
+/**
+ * Default time (in milliseconds) a bee takes to pass through an entrance, which it holds meanwhile.
+ */
+#define TRANSIT_TIME_MS 100
+
 /**
  * Minimum time (in seconds) a bee waits before entering the hive.
  */
@@ -47,14 +70,15 @@
 #define MAX_WAIT_TIME 50
 
 /**
- * Minimum time (in seconds) a bee spends outside the hive.
+ * Default minimum time (in seconds) a bee spends outside the hive.
  */
 #define MIN_OUTSIDE_TIME 1
 
 /**
- * Maximum time (in seconds) a bee spends outside the hive.
+ * Default maximum time (in seconds) a bee spends outside the hive.
  */
 #define MAX_OUTSIDE_TIME 10
+
 /**
  * Console color codes for pretty-printed messages.
  * These can be used to differentiate log levels when printing to the terminal.
@@ -85,36 +109,143 @@ typedef struct {
     bool logToFile;            // Whether to log messages to a file.
     LogLevel consoleLogLevel;  // Minimum log level for console messages.
     LogLevel fileLogLevel;     // Minimum log level for file messages.
+    const char* filePath;      // Log file (closed segments get a .<seq> suffix, see logfile.h).
+    size_t segmentSize;        // Size at which the log file is rotated into a segment (0: never).
+    int keepSegments;          // Closed segments kept on disk (0: all of them).
 } LogConfig;
 
+/**
+ * Receives formatted log messages instead of the console and file of logConfig.
+ *
+ * @param user Caller data given in the LogSink.
+ * @param level Severity of the message.
+ * @param message The formatted message.
+ */
+typedef void (*LogFunction)(void* user, LogLevel level, const char* message);
+
+/**
+ * A log destination: lets every colony embedded in one process log to its own place.
+ */
+typedef struct {
+    LogFunction log; // Called for every message.
+    void* user;      // Caller data passed to log.
+} LogSink;
+
+/**
+ * Colony parameters that can be changed while the simulation runs. They live in the
+ * colony's configuration page (see configpage.h) and are read at each laying cycle or
+ * lifecycle step, so a change takes effect at the next one.
+ */
+typedef struct {
+    int T_k;             // Queen's egg-laying interval in seconds.
+    int eggsCount;       // Eggs laid per cycle.
+    int T_inHive;        // Time (in seconds) a bee spends inside the hive per visit.
+    int maxVisits;       // Visits after which a bee dies.
+    int minOutsideTime;  // Shortest flight outside the hive in seconds.
+    int maxOutsideTime;  // Longest flight outside the hive in seconds.
+    int transitMs;       // Time (in milliseconds) a bee takes to pass through an entrance.
+    int maxBees;         // Bees alive at once, up to the capacity of the bee table.
+} HiveTunables;
+
+/**
+ * Occupancy of one frame, on a cache line of its own. Both fields change only under the
+ * frame's lock (HiveSemaphores.frameSem); anyone may read them with relaxed loads.
+ */
+typedef struct {
+    int bees;     // Bees on the frame (inside the hive or queued to leave it).
+    int capacity; // Bees the frame takes; 0 for a frame being drained or not attached.
+} __attribute__((aligned(64))) HiveFrame;
+
+/**
+ * Lock of one frame, padded to a cache line so frames never contend through false sharing.
+ * The NUMA accounting of the lock changes only under it, like the hive lock's in HiveData.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int lastNode;                               // Node of the previous holder, or -1.
+    unsigned long crossNodeHandoffs;            // Acquisitions from a different node than the previous holder's.
+    unsigned long acquisitions[HIVE_MAX_NODES]; // Acquisitions by the NUMA node of the acquiring CPU.
+} __attribute__((aligned(64))) HiveFrameLock;
+
+/**
+ * Where a bee comes from. Each cohort has lifetime statistics of its own.
+ */
+typedef enum {
+    BEE_COHORT_INITIAL, // Started with the colony.
+    BEE_COHORT_QUEEN,   // Laid by the queen.
+    BEE_COHORT_ADDED,   // Added to a running colony from outside (beehiveAddBees).
+    BEE_COHORTS
+} BeeCohort;
+
+/**
+ * Streaming statistics of one quantity, updated with Welford's method: no sample is kept.
+ */
+typedef struct {
+    double mean; // Mean of the samples.
+    double m2;   // Sum of the squared deviations from the mean.
+    double min;  // Smallest sample.
+    double max;  // Largest sample.
+} RunningStat;
+
+/**
+ * Lifetime statistics of the bees of one cohort that died, each folded in once at its
+ * death, under the hive lock (see cohorts.h).
+ */
+typedef struct {
+    long deaths;             // Bees folded in.
+    long abnormal;           // Of which died without giving back their slot (crash or kill).
+    RunningStat visits;      // Completed visits.
+    RunningStat rejections;  // Entry attempts refused because the hive was full.
+    RunningStat queueTime;   // Seconds spent queued at the entrances.
+    RunningStat insideTime;  // Seconds spent inside the hive.
+    RunningStat outsideTime; // Seconds spent outside the hive.
+    RunningStat lifetime;    // Seconds from birth to death.
+} CohortStats;
+
 /**
  * Struct representing the global state of the hive.
  * Tracks the number of bees in the hive and overall colony health.
  */
 typedef struct {
-    int currentBeesInHive;  // Current number of bees inside the hive.
+    int currentBeesInHive;  // Current number of bees inside the hive: the sum over the frames (atomic).
     int N;                  // Initial size of the hive (number of frames).
     int beesAlive;          // Total number of live bees in the colony.
-    int beesWaiting[2];     // Track bees waiting at each entrance
+    int beesWaiting[2];     // Track bees waiting at each entrance (atomic: changed under different frame locks)
+    int entries;            // Successful entries into the hive since the start of the run.
+    int rejections;         // Entry attempts refused because the hive was full.
+    int tableCapacity;      // Capacity of the per-bee state table; upper bound for N and maxBees.
+    unsigned long lockAcquisitions[HIVE_MAX_NODES]; // Hive lock acquisitions by the NUMA node of the acquiring CPU.
+    unsigned long crossNodeHandoffs; // Acquisitions from a different node than the previous holder's.
+    int lastLockNode;       // Node of the previous hive lock holder, or -1.
+    int deaths;             // Bees that died since the start of the run.
+    int resizeEpoch;        // Incremented by the beekeeper on every change of N.
+    int nextBeeID;          // ID of the next bee the queen lays.
+    int emigrations;        // Bees sent to other hives of the apiary.
+    int immigrations;       // Bees received from other hives of the apiary.
+    unsigned long eggsLaid;    // Eggs laid by the queen (relaxed atomic, read by the metrics exporter).
+    unsigned long eggsSkipped; // Eggs not laid for lack of space (relaxed atomic).
+    unsigned long transits[2]; // Passages through each entrance, in either direction (relaxed atomic).
+    CohortStats cohorts[BEE_COHORTS]; // Lifetime statistics of the bees that died, per cohort.
+    int frameCount;            // Frames attached to the hive; frames past it only drain.
+    HiveFrame frames[HIVE_MAX_FRAMES]; // Per-frame occupancy (see frames.h).
 } HiveData;
 
 /**
  * Struct for hive synchronization primitives.
- * Includes semaphores for controlling access to hive operations.
+ * All locks are process-shared robust mutexes (see hivelock.h), so a bee that dies
+ * while holding one does not stall the colony.
  */
 typedef struct {
-    sem_t hiveSem;          // Semaphore for general hive access control.
-    sem_t entranceSem[2];   // Semaphores for each hive entrance.
-    sem_t fifoQueue[2];     // FIFO queue semaphores for each entrance.
+    pthread_mutex_t hiveSem;        // Lock for general hive access control.
+    pthread_mutex_t entranceSem[2]; // Locks for each hive entrance.
+    pthread_mutex_t fifoQueue[2];   // FIFO queue locks for each entrance.
+    int repairPending;              // Set when a lock owner died; the next hive lock holder repairs HiveData.
+    int ownerDeaths;                // Number of locks recovered from dead owners.
+    sem_t queenWake;                // Posted by the beekeeper after a resize to wake the adaptive queen.
+    int shutdown;                   // Set once the colony is stopping; no process starts new work after it.
+    HiveFrameLock frameSem[HIVE_MAX_FRAMES]; // Locks of the frames (and their NUMA accounting); bees enter, leave and queue under them alone.
 } HiveSemaphores;
 
-/**
- * Global shared memory identifiers.
- * Used to track and release shared resources at the end of the program.
- */
-extern int shmid;  // Shared memory identifier for HiveData.
-extern int semid;  // Shared memory identifier for HiveSemaphores.
-
 /**
  * Global logging configuration.
  * This variable determines the logging behavior throughout the program.
@@ -129,11 +260,19 @@ extern LogConfig logConfig;
  */
 void logMessage(LogLevel level, const char* format, ...);
 
+/**
+ * Sends the log messages of the calling thread, and of the processes it forks, to a sink.
+ *
+ * @param sink The destination, or NULL to log according to logConfig.
+ * @return The previous destination of the thread.
+ */
+const LogSink* setLogSink(const LogSink* sink);
+
 /**
  * Initializes shared memory for hive data and returns a pointer to it.
  * @param N Initial hive size (number of frames).
  * @param shmid Pointer to store the shared memory ID.
- * @return Pointer to initialized HiveData.
+ * @return Pointer to initialized HiveData, or NULL with errno set on failure (nothing is left allocated).
  */
 HiveData* initHiveData(int N, int* shmid);
 
@@ -141,7 +280,7 @@ HiveData* initHiveData(int N, int* shmid);
 /**
  * Initializes shared memory for semaphores and returns a pointer to it.
  * @param semid Pointer to store the shared memory ID.
- * @return Pointer to initialized HiveSemaphores.
+ * @return Pointer to initialized HiveSemaphores, or NULL with errno set on failure (nothing is left allocated).
  */
 HiveSemaphores* initHiveSemaphores(int* semid);
 
@@ -168,7 +307,10 @@ void* attachSharedMemory(int shmid);
 void detachSharedMemory(void* sharedMemory);
 
 /**
- * Handles errors by logging the message, releasing shared resources, and terminating the program.
+ * Handles errors in a colony process by logging the message, releasing shared resources, and
+ * leaving through exitColonyProcess; the host never calls it. Colony processes pass -1 for
+ * both: the segments are removed once, by the process that created them, after every process
+ * of the colony is gone.
  *
  * @param message A descriptive error message.
  * @param shmid The shared memory identifier to release (if valid).
@@ -176,6 +318,15 @@ void detachSharedMemory(void* sharedMemory);
  */
 void handleError(const char* message, int shmid, int semid);
 
+/**
+ * Ends a colony process. Only the process's own console output is flushed: it leaves
+ * through _exit, so the stdio buffers and exit handlers it inherited from the host are
+ * never run a second time.
+ *
+ * @param status Exit status of the process.
+ */
+void exitColonyProcess(int status);
+
 /**
  * calculateP:
  * Calculates the maximum number of bees that can fit inside the hive at any given time.
@@ -185,6 +336,18 @@ void handleError(const char* message, int shmid, int semid);
  */
 int calculateP(int N);
 
+/**
+ * Returns the current time of a clock in nanoseconds.
+ *
+ * @param clock The clock, e.g. CLOCK_MONOTONIC or CLOCK_REALTIME.
+ */
+int64_t clockNanos(clockid_t clock);
+
+/**
+ * Returns the current CLOCK_MONOTONIC time in seconds.
+ */
+double monotonicSeconds(void);
+
 
 
 
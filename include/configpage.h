@@ -0,0 +1,153 @@
+#ifndef CONFIGPAGE_H
+#define CONFIGPAGE_H
+
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Identifies a configuration page; bumped whenever the layout of ConfigPage or HiveTunables changes.
+ */
+#define CONFIG_PAGE_LAYOUT 1
+
+/**
+ * Attempts configPageRead makes at a consistent copy before it gives up on a writer that
+ * is in the middle of an update.
+ */
+#define CONFIG_PAGE_READ_ATTEMPTS 64
+
+/**
+ * The live colony parameters in a POSIX shared memory object, /beehive_config_<pid>.
+ *
+ * The values are published with a sequence lock: a writer makes the sequence odd, stores
+ * the values and makes it even again, so readers take a consistent copy without locking and
+ * retry if the sequence moved under them. Bees read it once per lifecycle step and the queen
+ * once per laying cycle; a reader that cannot get a consistent copy keeps the one it had.
+ * Writers (beehiveSet, beehive-config) serialize on a robust mutex and update optimistically:
+ * a write based on an older version than the current one fails with EAGAIN.
+ */
+typedef struct {
+    uint32_t layout;       ///< CONFIG_PAGE_LAYOUT.
+    int32_t capacity;      ///< Capacity of the bee table, the upper bound of maxBees.
+    char path[128];        ///< shm_open name.
+    pthread_mutex_t writeLock; ///< Serializes the writers; robust, so a dead writer does not block the others.
+    uint64_t sequence __attribute__((aligned(64))); ///< Twice the version, odd while a write is in progress.
+    HiveTunables values;   ///< The parameters; read them with configPageRead or READ_TUNABLE.
+} ConfigPage;
+
+/**
+ * Reads one field of the live colony parameters, without the consistency of configPageRead.
+ */
+#define READ_TUNABLE(config, field) __atomic_load_n(&(config)->values.field, __ATOMIC_RELAXED)
+
+/**
+ * Fills values with the compiled-in defaults (T_k and eggsCount have none and are set to 1).
+ *
+ * @param values Parameters to initialize.
+ */
+void configDefaults(HiveTunables* values);
+
+/**
+ * Sets one parameter by name.
+ *
+ * @param values The parameters.
+ * @param name Name of the field, e.g. "maxVisits".
+ * @param value New value.
+ * @return 0 on success, or -1 if there is no such parameter.
+ */
+int configSet(HiveTunables* values, const char* name, int value);
+
+/**
+ * Returns the name of a parameter, for iterating over all of them.
+ *
+ * @param index Index of the parameter, from 0.
+ * @return The name, or NULL past the last one.
+ */
+const char* configName(int index);
+
+/**
+ * Returns the value of a parameter.
+ *
+ * @param values The parameters.
+ * @param index Index of the parameter (see configName).
+ * @return The value.
+ */
+int configValue(const HiveTunables* values, int index);
+
+/**
+ * Checks that a set of parameters can be given to a colony.
+ *
+ * @param values The parameters.
+ * @param capacity Capacity of the bee table (bounds maxBees).
+ * @return NULL if they are valid, or a description of the first problem.
+ */
+const char* configCheck(const HiveTunables* values, int capacity);
+
+/**
+ * configLoad:
+ * Applies a configuration file to a set of parameters: one "name = value" per line, with
+ * blank lines and '#' comments ignored. Parameters not in the file keep their value.
+ *
+ * @param path The file.
+ * @param values The parameters to update.
+ * @param error Receives a description of the problem on failure.
+ * @param errorSize Capacity of error.
+ * @return 0 on success, or -1 on failure (values may be partly updated).
+ */
+int configLoad(const char* path, HiveTunables* values, char* error, size_t errorSize);
+
+/**
+ * Creates the configuration page of the current colony.
+ *
+ * @param values Initial parameters (checked by the caller).
+ * @param capacity Capacity of the bee table.
+ * @return Pointer to the mapped page, or NULL on failure.
+ */
+ConfigPage* configPageCreate(const HiveTunables* values, int capacity);
+
+/**
+ * Maps the configuration page of a running colony for reading and writing (used by tools).
+ *
+ * @param path Name of the page as logged by [MAIN].
+ * @return Pointer to the mapped page, or NULL with errno set on failure.
+ */
+ConfigPage* configPageAttach(const char* path);
+
+/**
+ * Unmaps a page mapped with configPageAttach.
+ *
+ * @param page The page.
+ */
+void configPageDetach(ConfigPage* page);
+
+/**
+ * Unmaps and removes the page of the current colony.
+ *
+ * @param page The page.
+ */
+void configPageDestroy(ConfigPage* page);
+
+/**
+ * configPageRead:
+ * Takes a consistent copy of the parameters, without locking.
+ *
+ * @param page The page.
+ * @param values Receives the parameters; left unchanged if no consistent copy could be taken.
+ * @param version Receives the version of the copy, or NULL.
+ * @return true on success, false if a writer kept the page busy (or died while writing it).
+ */
+bool configPageRead(const ConfigPage* page, HiveTunables* values, uint64_t* version);
+
+/**
+ * configPageWrite:
+ * Publishes new parameters, unless the page changed since they were read.
+ *
+ * @param page The page.
+ * @param values The parameters.
+ * @param version Version they were based on (from configPageRead).
+ * @return The new version, or 0 with errno set: EAGAIN if the page changed in between
+ *         (read it again and retry), EINVAL if the values fail configCheck.
+ */
+uint64_t configPageWrite(ConfigPage* page, const HiveTunables* values, uint64_t version);
+
+#endif
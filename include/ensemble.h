@@ -0,0 +1,109 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stdint.h>
+
+/**
+ * Number of replicas advanced together by one vector kernel invocation.
+ * Every lane of a vector register holds the same bee of a different replica.
+ */
+#define ENSEMBLE_LANES 8
+
+/**
+ * Lifecycle states of a bee inside the ensemble engine.
+ * They mirror the phases of beeWorker: flying outside, queued at an entrance
+ * to enter, resting inside, and queued at an entrance to leave.
+ */
+typedef enum {
+    ENSEMBLE_DEAD = 0,       ///< Slot is free (bee died or was never born).
+    ENSEMBLE_OUTSIDE = 1,    ///< Flying outside, timer counts down to the next entry attempt.
+    ENSEMBLE_QUEUED_IN = 2,  ///< Waiting at an entrance to enter the hive.
+    ENSEMBLE_INSIDE = 3,     ///< Inside the hive, timer counts down to leaving.
+    ENSEMBLE_QUEUED_OUT = 4  ///< Waiting at an entrance to leave the hive.
+} EnsembleBeeState;
+
+/**
+ * Parameters shared by every replica of an ensemble.
+ * One step of the engine corresponds to one second of simulated time.
+ */
+typedef struct {
+    int N;               ///< Hive size (number of frames); also the number of initial bees.
+    int T_k;             ///< Steps between the queen's egg-laying cycles.
+    int eggsCount;       ///< Eggs laid per cycle.
+    int maxVisits;       ///< Visits after which a bee dies.
+    int T_inHive;        ///< Steps a bee spends inside the hive per visit.
+    int minOutside;      ///< Minimum steps spent outside between visits.
+    int maxOutside;      ///< Maximum steps spent outside between visits.
+    int transitsPerStep; ///< Entrance transits per step (each transit holds the hive lock for 100 ms).
+    int replicas;        ///< Number of independent colonies to simulate.
+    int steps;           ///< Simulated horizon in steps.
+    uint32_t seed;       ///< Base seed of the per-bee random number generators.
+} EnsembleConfig;
+
+/**
+ * Outcome of a single replica.
+ */
+typedef struct {
+    double meanOccupancy; ///< Time-averaged number of bees inside the hive.
+    int maxOccupancy;     ///< Highest occupancy observed.
+    int entries;          ///< Successful entries.
+    int rejections;       ///< Entry attempts refused because the hive was full.
+    int eggsLaid;         ///< Bees born from the queen's eggs.
+    int survivalTime;     ///< Step at which no bee was alive, or -1 if the colony survived.
+    int finalAlive;       ///< Bees alive at the end of the horizon.
+} EnsembleReplicaStats;
+
+/**
+ * Opaque handle to an ensemble and its structure-of-arrays bee state.
+ */
+typedef struct Ensemble Ensemble;
+
+/**
+ * Fills a configuration with the defaults used by the process simulation
+ * (visit limit, time in hive, outside time range, and transit delay from common.h).
+ *
+ * @param config Configuration to initialize.
+ */
+void ensembleDefaultConfig(EnsembleConfig* config);
+
+/**
+ * Allocates an ensemble and places every replica in its initial state:
+ * N bees outside the hive with random flight times.
+ *
+ * @param config Parameters of the ensemble.
+ * @return The new ensemble, or NULL if the configuration is invalid or allocation fails.
+ */
+Ensemble* ensembleCreate(const EnsembleConfig* config);
+
+/**
+ * Advances every replica by the configured number of steps.
+ *
+ * @param ensemble The ensemble to run.
+ */
+void ensembleRun(Ensemble* ensemble);
+
+/**
+ * Returns the per-replica results of a finished run.
+ *
+ * @param ensemble The ensemble that was run.
+ * @return Array of config.replicas entries owned by the ensemble.
+ */
+const EnsembleReplicaStats* ensembleResults(const Ensemble* ensemble);
+
+/**
+ * Returns the distribution of hive occupancy over all replicas and steps.
+ *
+ * @param ensemble The ensemble that was run.
+ * @param bins Receives the number of histogram bins (occupancy 0 .. bins - 1).
+ * @return Array of step counts per occupancy value, owned by the ensemble.
+ */
+const long* ensembleOccupancyHistogram(const Ensemble* ensemble, int* bins);
+
+/**
+ * Releases an ensemble and all of its state.
+ *
+ * @param ensemble The ensemble to destroy (may be NULL).
+ */
+void ensembleDestroy(Ensemble* ensemble);
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef EVENTBUS_H
+#define EVENTBUS_H
+
+#include "common.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Default number of events kept by the event bus (must be a power of two).
+ */
+#define EVENT_BUS_DEFAULT_CAPACITY 65536
+
+/**
+ * Number of newer events after which a subscriber gives up waiting for an event that was
+ * reserved but never published (its writer died in between) and counts it as lost.
+ */
+#define EVENT_BUS_STALL_LIMIT 1024
+
+/**
+ * Kinds of hive events.
+ */
+typedef enum {
+    HIVE_EVENT_QUEUE = 1, ///< A bee joined the queue of an entrance; value: bees waiting there.
+    HIVE_EVENT_ENTER,     ///< A bee entered the hive; value: bees in the hive.
+    HIVE_EVENT_LEAVE,     ///< A bee left the hive; value: bees in the hive.
+    HIVE_EVENT_REJECT,    ///< A bee was turned away because the hive was full; value: bees in the hive.
+    HIVE_EVENT_BIRTH,     ///< A bee was laid by the queen or added to the colony; value: bees alive.
+    HIVE_EVENT_DEATH,     ///< A bee died; value: its completed visits.
+    HIVE_EVENT_RESIZE,    ///< The hive size changed (bee is -1); value: the new N.
+    HIVE_EVENT_TYPES
+} HiveEventType;
+
+/**
+ * HIVE_EVENT_QUEUE: the bee queues to leave the hive rather than to enter it.
+ */
+#define HIVE_EVENT_OUTBOUND 0x1u
+
+/**
+ * HIVE_EVENT_BIRTH: the bee was added outside the hive instead of being laid by the queen.
+ */
+#define HIVE_EVENT_ADDED 0x2u
+
+/**
+ * HIVE_EVENT_DEATH: the bee's process died without giving back its slot (crash or kill);
+ * the event is published by the supervisor.
+ */
+#define HIVE_EVENT_ABNORMAL 0x4u
+
+/**
+ * One event of the bus (32 bytes).
+ */
+typedef struct {
+    uint64_t sequence; ///< Position in the stream + 1 once published; written last.
+    int64_t time;      ///< CLOCK_REALTIME nanoseconds.
+    int32_t bee;       ///< Bee ID, or -1 for events of the whole hive.
+    int32_t value;     ///< Type-specific value (see HiveEventType).
+    uint8_t type;      ///< HiveEventType.
+    uint8_t entrance;  ///< Entrance of queue, enter, leave and reject events.
+    uint16_t flags;    ///< HIVE_EVENT_* flags.
+    uint32_t reserved;
+} HiveEvent;
+
+/**
+ * Ring of typed hive events in a POSIX shared memory object.
+ *
+ * Producers (bees, queen, beekeeper, supervisor) reserve a position with one atomic
+ * fetch-and-add on head, fill the event and publish it by storing its sequence. They never
+ * wait for anyone: the oldest events are overwritten. Any number of subscribers read it
+ * with their own EventCursor, in the main process or in a tool that maps it by name, and
+ * see how many events they lost if they fell more than a lap behind.
+ */
+typedef struct {
+    uint64_t capacity;    ///< Number of events (a power of two).
+    size_t mappedBytes;   ///< Size of the mapping.
+    char path[128];       ///< shm_open name.
+    uint64_t head __attribute__((aligned(64))); ///< Next position to reserve, on a cache line of its own.
+    HiveEvent events[] __attribute__((aligned(64)));
+} EventBus;
+
+/**
+ * Read position of one subscriber.
+ */
+typedef struct {
+    uint64_t cursor; ///< Position of the next event to read.
+    uint64_t lost;   ///< Events overwritten or never published before they could be read.
+} EventCursor;
+
+/**
+ * Creates the event bus of the current simulation.
+ *
+ * @param capacity Number of events kept (rounded up to a power of two; 0 for the default).
+ * @return Pointer to the mapped bus, or NULL on failure.
+ */
+EventBus* eventBusCreate(size_t capacity);
+
+/**
+ * Maps an existing bus read-only, e.g. from a monitoring tool.
+ *
+ * @param path Name recorded in the bus (as logged by the main process).
+ * @return Pointer to the mapped bus, or NULL on failure.
+ */
+const EventBus* eventBusAttach(const char* path);
+
+/**
+ * Unmaps a bus mapped with eventBusAttach.
+ *
+ * @param bus The bus to unmap.
+ */
+void eventBusDetach(const EventBus* bus);
+
+/**
+ * Unmaps the bus and removes its shared memory object.
+ *
+ * @param bus The bus to destroy.
+ */
+void eventBusDestroy(EventBus* bus);
+
+/**
+ * Appends an event (lock-free, never blocks). Does nothing if bus is NULL.
+ *
+ * @param bus The bus.
+ * @param type Kind of event.
+ * @param bee Bee ID, or -1.
+ * @param entrance Entrance, or 0.
+ * @param value Type-specific value.
+ * @param flags HIVE_EVENT_* flags.
+ */
+void eventBusPublish(EventBus* bus, HiveEventType type, int bee, int entrance, int value, unsigned int flags);
+
+/**
+ * Starts a subscription.
+ *
+ * @param bus The bus.
+ * @param cursor Receives the subscriber's read position.
+ * @param fromOldest Start with the oldest event still kept instead of the next one published.
+ */
+void eventBusSubscribe(const EventBus* bus, EventCursor* cursor, bool fromOldest);
+
+/**
+ * eventBusNext:
+ * Reads the next event of a subscription, skipping (and counting in cursor->lost) those
+ * that were overwritten before it got to them.
+ *
+ * @param bus The bus.
+ * @param cursor The subscriber's read position.
+ * @param event Receives the event.
+ * @return true if an event was read, false if none is available yet.
+ */
+bool eventBusNext(const EventBus* bus, EventCursor* cursor, HiveEvent* event);
+
+/**
+ * Returns the display name of an event type ("queue", "enter", ...), or NULL if invalid.
+ *
+ * @param type The event type.
+ */
+const char* eventTypeName(int type);
+
+#endif
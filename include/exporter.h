@@ -0,0 +1,59 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include "common.h"
+
+/**
+ * Longest time (in milliseconds) a connected scraper has to send its whole request.
+ */
+#define EXPORTER_REQUEST_TIMEOUT_MS 200
+
+/**
+ * Most connections the exporter keeps open at once; further ones wait in the listen backlog.
+ */
+#define EXPORTER_MAX_CLIENTS 16
+
+/**
+ * Opaque handle to the metrics exporter.
+ */
+typedef struct Exporter Exporter;
+
+/**
+ * exporterCreate:
+ * Starts listening for scrapes of the hive metrics. The address is either a TCP port,
+ * bound on 127.0.0.1 only, or the path of a Unix-domain socket.
+ *
+ * @param address "PORT" or a socket path.
+ * @param hive Shared hive state the metrics are read from.
+ * @return The exporter, or NULL with errno set on failure.
+ */
+Exporter* exporterCreate(const char* address, const HiveData* hive);
+
+/**
+ * exporterService:
+ * Accepts new connections, reads what has arrived of their requests and answers the
+ * complete ones. It never waits: a request that is still incomplete is kept for the next
+ * call, until EXPORTER_REQUEST_TIMEOUT_MS after its connection was accepted. Meant to be
+ * called from the main loop.
+ *
+ * @param exporter The exporter.
+ */
+void exporterService(Exporter* exporter);
+
+/**
+ * Returns a descriptor that becomes readable when a scraper connects or sends data, for
+ * the main loop to wait on along with its other descriptors.
+ *
+ * @param exporter The exporter.
+ * @return The descriptor (an epoll set owned by the exporter).
+ */
+int exporterFd(const Exporter* exporter);
+
+/**
+ * Stops listening, removes the Unix-domain socket if any, and releases the exporter.
+ *
+ * @param exporter The exporter.
+ */
+void exporterDestroy(Exporter* exporter);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef FLUID_H
+#define FLUID_H
+
+#include <stdbool.h>
+
+/**
+ * Parameters of the mean-field (fluid) approximation of the colony.
+ * Populations are treated as continuous quantities and advanced with an ODE solver,
+ * so the cost does not depend on the number of bees.
+ */
+typedef struct {
+    double N;                 ///< Hive size (number of frames); also the initial population.
+    double T_k;               ///< Seconds between the queen's egg-laying cycles.
+    double eggsCount;         ///< Eggs laid per cycle.
+    int maxVisits;            ///< Visits after which a bee dies.
+    double T_inHive;          ///< Seconds spent inside the hive per visit.
+    double minOutside;        ///< Minimum seconds spent outside between visits.
+    double maxOutside;        ///< Maximum seconds spent outside between visits.
+    double transitsPerSecond; ///< Entrance throughput (each transit holds the hive lock for 100 ms).
+    double horizon;           ///< Simulated time in seconds.
+    double dt;                ///< Integration step in seconds.
+} FluidConfig;
+
+/**
+ * Snapshot of the populations at a point in time.
+ */
+typedef struct {
+    double t;         ///< Time in seconds.
+    double outside;   ///< Bees flying outside.
+    double queued;    ///< Bees queued at the entrances to get in.
+    double inside;    ///< Bees inside the hive.
+    double dead;      ///< Bees that completed their visits and died.
+    double birthRate; ///< Queen's current laying rate in bees per second.
+} FluidSample;
+
+/**
+ * Time-averaged results of a fluid run.
+ */
+typedef struct {
+    double meanInside;    ///< Mean occupancy over the horizon.
+    double finalAlive;    ///< Bees alive at the end of the horizon.
+    double eggsLaid;      ///< Total bees born during the horizon.
+    double rejectionRate; ///< Fraction of entry attempts refused at the capacity check.
+} FluidSummary;
+
+/**
+ * Steady state of the colony, in closed form except for the capacity limit (a bisection).
+ */
+typedef struct {
+    double birthRate;     ///< Sustained births (= deaths) per second.
+    double alive;         ///< Bees alive.
+    double inside;        ///< Bees inside the hive.
+    double utilization;   ///< inside / calculateP(N).
+    double rejectionRate; ///< Fraction of entry attempts refused because the hive was full.
+    const char* binding;  ///< Constraint limiting the birth rate ("laying", "population", "capacity", or "transits").
+} FluidEquilibrium;
+
+/**
+ * Fills a configuration with the defaults of the process simulation.
+ *
+ * @param config Configuration to initialize.
+ */
+void fluidDefaultConfig(FluidConfig* config);
+
+/**
+ * Tells whether a configuration can be solved: positive sizes, rates and steps, and a
+ * flight time range that is not empty.
+ *
+ * @param config Model parameters.
+ * @return true if fluidSolve and fluidEquilibrium accept the configuration.
+ */
+bool fluidValidConfig(const FluidConfig* config);
+
+/**
+ * fluidSolve:
+ * Integrates the fluid model from the initial state of main.c (N bees outside)
+ * with a fixed-step fourth-order Runge-Kutta scheme.
+ *
+ * @param config Model parameters.
+ * @param samples Receives one sample per simulated second (may be NULL).
+ * @param maxSamples Capacity of samples.
+ * @param summary Receives the time-averaged results (may be NULL).
+ * @return Number of samples written, or -1 if the configuration is invalid.
+ */
+int fluidSolve(const FluidConfig* config, FluidSample* samples, int maxSamples, FluidSummary* summary);
+
+/**
+ * fluidEquilibrium:
+ * Computes the steady state reached when births balance deaths, taking the queen's
+ * two laying conditions (free hive space and the N population limit) into account.
+ * Occupancy fluctuates around its mean like in the trajectory, so the hive is
+ * sometimes too full for a batch before it is full on average.
+ *
+ * @param config Model parameters (horizon and dt are ignored).
+ * @param eq Receives the steady state.
+ * @return 0 on success, or -1 if the configuration is invalid.
+ */
+int fluidEquilibrium(const FluidConfig* config, FluidEquilibrium* eq);
+
+#endif
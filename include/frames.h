@@ -0,0 +1,69 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include "common.h"
+
+/**
+ * Per-frame occupancy of the hive.
+ *
+ * The capacity calculateP(N) is laid out over HiveData.frameCount frames of about
+ * HIVE_FRAME_BEES bees each, every one with its own counter and lock on cache lines of
+ * their own. A bee takes room on a frame rather than in the hive as a whole: it tries
+ * the frame it was on last, then the neighbouring ones outwards, and is turned away only
+ * when every frame is full. Bees on different frames never contend, and a crowded frame
+ * shows up as congestion of its own.
+ *
+ * A resize attaches new frames right away. Frames that are removed are only drained:
+ * their capacity drops to 0 and they empty as their bees leave.
+ */
+
+/**
+ * Lays out the capacity of the hive for its current N. The counts of bees on the frames
+ * are kept. Bees must not be moving: used on a hive that has none running yet, or through
+ * framesResize.
+ *
+ * @param hive Shared hive state.
+ */
+void framesLayout(HiveData* hive);
+
+/**
+ * Lays the frames out again after a change of N (hive lock held), with every frame locked.
+ *
+ * @param hive Shared hive state.
+ * @param semaphores The hive locks.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int framesResize(HiveData* hive, HiveSemaphores* semaphores);
+
+/**
+ * lockFreeFrame:
+ * Finds room for a bee, starting with its home frame and moving outwards to the
+ * neighbouring ones. Frames that look full are skipped without taking their lock.
+ *
+ * @param hive Shared hive state.
+ * @param semaphores The hive locks.
+ * @param home Frame the bee tries first.
+ * @param frame Receives the frame found, locked, or -1 if every frame is full.
+ * @return 0 on success, or -1 with errno set if a frame could not be locked.
+ */
+int lockFreeFrame(HiveData* hive, HiveSemaphores* semaphores, int home, int* frame);
+
+/**
+ * Counts a bee onto a frame (frame lock held).
+ *
+ * @param hive Shared hive state.
+ * @param frame Index of the frame.
+ * @return Bees in the hive after the entry.
+ */
+int frameEnter(HiveData* hive, int frame);
+
+/**
+ * Counts a bee off its frame (frame lock held).
+ *
+ * @param hive Shared hive state.
+ * @param frame Index of the frame.
+ * @return Bees in the hive after the exit.
+ */
+int frameLeave(HiveData* hive, int frame);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef HIVELOCK_H
+#define HIVELOCK_H
+
+#include "common.h"
+#include "beetable.h"
+
+/**
+ * Initializes a process-shared robust mutex.
+ * If the process holding it dies, the next locker is told so instead of blocking forever.
+ *
+ * @param lock The mutex to initialize (in shared memory).
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int robustLockInit(pthread_mutex_t* lock);
+
+/**
+ * Locks an entrance or FIFO lock.
+ * A lock left behind by a dead owner is made consistent and the hive is flagged
+ * for repair by the next holder of the hive lock.
+ *
+ * @param lock The mutex to lock.
+ * @param semaphores The hive locks (receives the recovery flag).
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int robustLock(pthread_mutex_t* lock, HiveSemaphores* semaphores);
+
+/**
+ * Unlocks a lock taken with robustLock or lockHive.
+ *
+ * @param lock The mutex to unlock.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int robustUnlock(pthread_mutex_t* lock);
+
+/**
+ * Flags the hive for repair by the next lockHive, e.g. after a bee was found dead
+ * outside of any lock.
+ *
+ * @param semaphores The hive locks.
+ */
+void requestHiveRepair(HiveSemaphores* semaphores);
+
+/**
+ * Flags the colony as shutting down and wakes the queen. From then on no process lays,
+ * queues or forks a bee; the main process stops every process and removes the shared
+ * segments once they are all gone.
+ *
+ * @param semaphores The hive locks.
+ */
+void requestShutdown(HiveSemaphores* semaphores);
+
+/**
+ * Tells whether the colony is shutting down.
+ *
+ * @param semaphores The hive locks.
+ * @return true once requestShutdown was called by any process.
+ */
+bool shutdownRequested(const HiveSemaphores* semaphores);
+
+/**
+ * lockHive:
+ * Locks the hive lock. If a process died holding any hive lock, the HiveData
+ * counters are recomputed from the per-bee state table before returning, with
+ * every frame locked so no bee moves during the recount.
+ * Each acquisition is counted per NUMA node of the acquiring CPU, together with
+ * handoffs between holders on different nodes.
+ *
+ * @param semaphores The hive locks.
+ * @param hive Shared hive state to repair if needed.
+ * @param table Per-bee state table used as the source of truth for the repair.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int lockHive(HiveSemaphores* semaphores, HiveData* hive, BeeTable* table);
+
+/**
+ * Locks one frame. Taken after the hive lock by those that hold both.
+ * Acquisitions and handoffs between nodes are counted per frame, as for lockHive.
+ *
+ * @param semaphores The hive locks.
+ * @param frame Index of the frame.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int lockFrame(HiveSemaphores* semaphores, int frame);
+
+/**
+ * Unlocks a frame locked with lockFrame.
+ *
+ * @param semaphores The hive locks.
+ * @param frame Index of the frame.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int unlockFrame(HiveSemaphores* semaphores, int frame);
+
+/**
+ * Locks every frame in index order (hive lock held), which stops every bee transition.
+ *
+ * @param semaphores The hive locks.
+ * @return 0 on success, or -1 with errno set on failure (no frame is left locked).
+ */
+int lockAllFrames(HiveSemaphores* semaphores);
+
+/**
+ * Unlocks the frames locked with lockAllFrames.
+ *
+ * @param semaphores The hive locks.
+ */
+void unlockAllFrames(HiveSemaphores* semaphores);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef LOGFILE_H
+#define LOGFILE_H
+
+#include "common.h"
+
+/**
+ * Log file shared by every process of a simulation, optionally split into segments.
+ *
+ * Messages are appended to logConfig.filePath. Once it reaches logConfig.segmentSize bytes,
+ * the next writer closes it as segment FILE.<seq> and appends a line to the index
+ * FILE.index:
+ *
+ *     <seq> <first> <last> <bytes>
+ *
+ * where first and last are the Unix times of the segment's first message and of its
+ * rotation, so the segments of a time range are found without reading them. Rotation is
+ * serialized with flock, so every process can write and rotate. Only the newest
+ * logConfig.keepSegments segments are kept.
+ *
+ * The log compressor thread gzips closed segments to FILE.<seq>.gz. It runs in the main
+ * process, so no bee ever spends time on compression.
+ */
+
+/**
+ * Suffix of the segment index appended to the log file's path.
+ */
+#define LOG_INDEX_SUFFIX ".index"
+
+/**
+ * logFileWrite:
+ * Appends one line to the log file with a single write, rotating the file first if it is
+ * full. Safe to call from any thread and any process of the simulation.
+ *
+ * @param line The line, including its newline.
+ * @param length Length of the line.
+ */
+void logFileWrite(const char* line, size_t length);
+
+/**
+ * logCompressorStart:
+ * Starts the background thread that gzips closed segments of logConfig.filePath, beginning
+ * with those left uncompressed by an earlier run. Does nothing unless segments are enabled.
+ *
+ * @return 0 on success, or -1 on failure.
+ */
+int logCompressorStart(void);
+
+/**
+ * Compresses the segments still waiting, then stops the compressor thread.
+ */
+void logCompressorStop(void);
+
+#endif
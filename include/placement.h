@@ -0,0 +1,103 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "common.h"
+
+/**
+ * Highest CPU number plus one that a placement can name.
+ */
+#define PLACEMENT_MAX_CPUS 1024
+
+/**
+ * Node value requesting that the shared segments follow the CPUs of the bees.
+ */
+#define PLACEMENT_NODE_AUTO -2
+
+/**
+ * How bees are distributed over their CPU set.
+ */
+typedef enum {
+    BEE_PLACEMENT_NONE = 0, ///< Bees are left to the scheduler.
+    BEE_PLACEMENT_SPREAD,   ///< Each bee is pinned to one CPU, round-robin, alternating NUMA nodes.
+    BEE_PLACEMENT_PACK      ///< Bees share the CPUs of the set on the memory node, like their segments.
+} BeePlacement;
+
+/**
+ * Placement of the colony's processes and shared memory.
+ */
+typedef struct {
+    int queenCpu;                     ///< CPU the queen is pinned to, or -1.
+    int keeperCpu;                    ///< CPU the beekeeper is pinned to, or -1.
+    BeePlacement beePlacement;        ///< Distribution of bees over beeCpus.
+    int beeCpus[PLACEMENT_MAX_CPUS];  ///< CPUs available to bees, ascending (defaults to the process's affinity).
+    int beeCpuCount;                  ///< Number of entries in beeCpus.
+    int memNode;                      ///< NUMA node for the shared segments, PLACEMENT_NODE_AUTO, or -1 to leave them alone.
+    int cpuOrder[PLACEMENT_MAX_CPUS]; ///< beeCpus ordered for spreading (nodes interleaved); filled by placementResolve.
+    int cpuCount;                     ///< Number of entries in cpuOrder.
+    int packCpus[PLACEMENT_MAX_CPUS]; ///< CPUs used by packed bees; filled by placementResolve.
+    int packCount;                    ///< Number of entries in packCpus.
+} PlacementConfig;
+
+/**
+ * Fills a configuration that leaves every process and segment where the kernel puts it.
+ *
+ * @param config Configuration to initialize.
+ */
+void placementDefaultConfig(PlacementConfig* config);
+
+/**
+ * Parses a CPU list such as "0-3,8,10-11".
+ *
+ * @param list The CPU list.
+ * @param cpus Receives the CPUs in ascending order, without repeats (PLACEMENT_MAX_CPUS entries).
+ * @param count Receives the number of CPUs.
+ * @return 0 on success, or -1 if the list is malformed, empty, or names a CPU beyond PLACEMENT_MAX_CPUS.
+ */
+int parseCpuList(const char* list, int* cpus, int* count);
+
+/**
+ * Returns the NUMA node of a CPU (0 on machines without NUMA information).
+ *
+ * @param cpu The CPU.
+ * @return The node of the CPU.
+ */
+int cpuNode(int cpu);
+
+/**
+ * placementResolve:
+ * Validates the configuration, resolves PLACEMENT_NODE_AUTO to the node holding most
+ * of the bees' CPUs, and precomputes the CPU assignment of bees.
+ *
+ * @param config Configuration to resolve in place.
+ * @return 0 on success, or -1 if a CPU or node is not usable.
+ */
+int placementResolve(PlacementConfig* config);
+
+/**
+ * Pins the calling process to a single CPU.
+ *
+ * @param cpu The CPU, or -1 to do nothing.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int pinToCpu(int cpu);
+
+/**
+ * Applies the bee placement to the calling bee process.
+ *
+ * @param config Resolved placement.
+ * @param beeId ID of the bee, used to pick its CPU when spreading.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int placeBee(const PlacementConfig* config, int beeId);
+
+/**
+ * Binds a shared memory mapping to a NUMA node, migrating pages already touched.
+ *
+ * @param addr Start of the mapping (page aligned).
+ * @param length Length of the mapping in bytes.
+ * @param node The node, or -1 to do nothing.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int bindToNode(void* addr, size_t length, int node);
+
+#endif
@@ -2,18 +2,46 @@
 #define QUEEN_H
 
 #include "common.h"
+#include "beetable.h"
+#include "supervisor.h"
+#include "configpage.h"
+
+/**
+ * Gains of the adaptive egg-laying controller: births per second per bee of occupancy
+ * error, and per bee-second of accumulated error.
+ */
+#define QUEEN_KP 0.1
+#define QUEEN_KI 0.01
+
+/**
+ * Weight of the newest sample in the smoothed death rate.
+ */
+#define QUEEN_DEATH_RATE_SMOOTHING 0.3
+
+/**
+ * Shortest adaptive laying interval in seconds.
+ */
+#define QUEEN_MIN_INTERVAL 0.5
+
+/**
+ * Largest adaptive batch as a multiple of eggsCount.
+ */
+#define QUEEN_MAX_BATCH_FACTOR 4
 
 /**
  * The QueenArgs struct contains all the parameters required by the queen process.
  * The queen is responsible for laying eggs at regular intervals and adding new bees to the hive.
  */
 typedef struct {
-    int T_k;       ///< Time interval (in seconds) between each egg-laying cycle.
-    int eggsCount; ///< Number of eggs laid by the queen in one cycle.
     HiveData* hive; ///< Pointer to the shared memory structure representing the hive state.
     HiveSemaphores* semaphores; ///< Pointer to the shared semaphore structure for synchronization.
     int semid;     ///< Shared memory identifier for semaphores.
     int shmid;     ///< Shared memory identifier for hive data.
+    BeeTable* table; ///< Per-bee state table in which newborns get their slots.
+    int spawnFd;   ///< Write end of the spawn pipe; every newborn is requested from the main process as a SpawnRequest.
+    double targetUtilization; ///< Adaptive mode: occupancy setpoint as a fraction of calculateP(N); 0 lays eggsCount every T_k.
+    EventBus* events; ///< Event bus receiving a birth event per egg.
+    const ConfigPage* config; ///< Live colony parameters (T_k, eggsCount and maxBees).
 } QueenArgs;
 
 /**
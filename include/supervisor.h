@@ -0,0 +1,192 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "common.h"
+#include "beetable.h"
+#include "eventbus.h"
+
+/**
+ * Kind of a supervised process.
+ */
+typedef enum {
+    SUPERVISED_QUEEN,
+    SUPERVISED_BEEKEEPER,
+    SUPERVISED_BEE
+} SupervisedKind;
+
+/**
+ * Request for a newborn bee, written by the queen to the spawn pipe.
+ * The queen has already counted the bee and reserved its slot under the hive lock;
+ * the supervisor forks the process, so every bee is a child of the main process.
+ */
+typedef struct {
+    int id;    ///< Bee ID.
+    int slot;  ///< Slot of the bee in the per-bee state table.
+} SpawnRequest;
+
+/**
+ * Forks the process of a newborn bee for the supervisor.
+ *
+ * @param context Caller data given to supervisorAddSpawnPipe.
+ * @param id Bee ID.
+ * @param slot Slot of the bee in the per-bee state table.
+ * @return Process ID of the bee, or -1 with errno set on failure.
+ */
+typedef pid_t (*SpawnBeeFunction)(void* context, int id, int slot);
+
+/**
+ * Exit statistics gathered by the supervisor.
+ */
+typedef struct {
+    int watched;           ///< Processes registered so far.
+    int beeExits;          ///< Bees reaped.
+    int abnormalExits;     ///< Processes that were killed by a signal or exited with a failure status.
+    int reconciled;        ///< Abnormal bee deaths whose hive counters had to be repaired.
+    double beeLifetimeSum; ///< Sum of the lifetimes of reaped bees in seconds.
+    double maxBeeLifetime; ///< Longest lifetime of a reaped bee in seconds.
+} SupervisorStats;
+
+/**
+ * Opaque handle to the process supervisor.
+ */
+typedef struct Supervisor Supervisor;
+
+/**
+ * Creates a supervisor that watches processes through pidfds in an epoll set.
+ *
+ * @param hive Shared hive state, reconciled when a bee dies abnormally.
+ * @param semaphores Hive locks.
+ * @param table Per-bee state table.
+ * @param events Event bus receiving the deaths of bees that died abnormally, or NULL.
+ * @return The supervisor, or NULL with errno set on failure.
+ */
+Supervisor* supervisorCreate(HiveData* hive, HiveSemaphores* semaphores, BeeTable* table, EventBus* events);
+
+/**
+ * Starts watching a child process.
+ *
+ * @param supervisor The supervisor.
+ * @param pid Process to watch (must be a child of the calling process).
+ * @param kind Kind of the process.
+ * @param id Bee ID (ignored for the queen and the beekeeper).
+ * @param slot Slot in the per-bee state table (ignored for the queen and the beekeeper).
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int supervisorWatch(Supervisor* supervisor, pid_t pid, SupervisedKind kind, int id, int slot);
+
+/**
+ * Adds the read end of the spawn pipe. For every SpawnRequest read from it the bee is
+ * forked with spawn and watched; if the fork fails, its reservation is rolled back.
+ *
+ * @param supervisor The supervisor.
+ * @param fd Read end of the pipe (the supervisor closes it at end of file).
+ * @param spawn Function forking a newborn bee.
+ * @param context Caller data passed to spawn.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int supervisorAddSpawnPipe(Supervisor* supervisor, int fd, SpawnBeeFunction spawn, void* context);
+
+/**
+ * Adds a descriptor of the caller to the set supervisorPoll waits on: when it becomes
+ * readable, supervisorPoll returns early and leaves it to the caller to service.
+ *
+ * @param supervisor The supervisor.
+ * @param fd The descriptor.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+int supervisorAddWakeFd(Supervisor* supervisor, int fd);
+
+/**
+ * Removes a descriptor added with supervisorAddWakeFd; call it before closing the descriptor.
+ *
+ * @param supervisor The supervisor.
+ * @param fd The descriptor.
+ */
+void supervisorRemoveWakeFd(Supervisor* supervisor, int fd);
+
+/**
+ * supervisorPoll:
+ * Waits for exits and spawn requests, forks requested bees, reaps every exited process immediately,
+ * and repairs the hive counters when a bee died without releasing its slot.
+ *
+ * @param supervisor The supervisor.
+ * @param timeoutMs Maximum time to wait in milliseconds (-1 waits indefinitely).
+ * @return Number of processes still running, or -1 with errno set on failure.
+ */
+int supervisorPoll(Supervisor* supervisor, int timeoutMs);
+
+/**
+ * Prepares the supervisor for the colony's shutdown: the spawn pipe is closed, dropping
+ * the requests still in it, and every exit from now on counts as normal, so no bee is
+ * forked or reconciled while the colony is being stopped.
+ *
+ * @param supervisor The supervisor.
+ */
+void supervisorShutdown(Supervisor* supervisor);
+
+/**
+ * Tells whether the spawn pipe is still open, i.e. more bees may be requested.
+ *
+ * @param supervisor The supervisor.
+ * @return true while the queen can still request bees.
+ */
+bool supervisorExpectsSpawns(const Supervisor* supervisor);
+
+/**
+ * Returns how many processes of a kind are still running.
+ *
+ * @param supervisor The supervisor.
+ * @param kind Kind of process.
+ * @return Number of watched processes of that kind that have not been reaped.
+ */
+int supervisorRunning(const Supervisor* supervisor, SupervisedKind kind);
+
+/**
+ * Sends a signal to every running process of a kind through its pidfd, so a recycled
+ * pid is never hit.
+ *
+ * @param supervisor The supervisor.
+ * @param kind Kind of process to signal.
+ * @param sig Signal number.
+ * @return 0 on success, or -1 if any process could not be signalled.
+ */
+int supervisorSignal(Supervisor* supervisor, SupervisedKind kind, int sig);
+
+/**
+ * Sends a signal to one bee through its pidfd; the bee's exit then counts as normal.
+ *
+ * @param supervisor The supervisor.
+ * @param id Bee ID.
+ * @param slot Slot of the bee in the per-bee state table.
+ * @param sig Signal number.
+ * @return 0 on success, or -1 if the bee is not watched or could not be signalled.
+ */
+int supervisorSignalBee(Supervisor* supervisor, int id, int slot, int sig);
+
+/**
+ * Kills one bee through its pidfd as if it had crashed: its exit counts as abnormal,
+ * and its hive counters are reconciled from the per-bee state table when it is reaped.
+ *
+ * @param supervisor The supervisor.
+ * @param id Bee ID.
+ * @param slot Slot of the bee in the per-bee state table.
+ * @return 0 on success, or -1 if the bee is not watched or could not be killed.
+ */
+int supervisorKillBee(Supervisor* supervisor, int id, int slot);
+
+/**
+ * Returns the exit statistics gathered so far.
+ *
+ * @param supervisor The supervisor.
+ * @param stats Receives the statistics.
+ */
+void supervisorStats(const Supervisor* supervisor, SupervisorStats* stats);
+
+/**
+ * Closes every pidfd and releases the supervisor. Running processes are not affected.
+ *
+ * @param supervisor The supervisor.
+ */
+void supervisorDestroy(Supervisor* supervisor);
+
+#endif
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include "apiary.h"
+#include "hivelock.h"
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/**
+ * What the coordinator knows about one hive.
+ */
+typedef struct {
+    pid_t pid;
+    int fd;         // Coordinator end of the socket pair, or -1 once the hive is gone.
+    bool reported;  // A load report arrived since the last migration order involving the hive.
+    int beesAlive;
+    int N;
+    int occupancy;
+} HiveEntry;
+
+/**
+ * sendMessage:
+ * Sends one message on an apiary socket.
+ *
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int sendMessage(int fd, const ApiaryMessage* message) {
+    ssize_t sent;
+    do {
+        sent = send(fd, message, sizeof(*message), MSG_NOSIGNAL);
+    } while (sent == -1 && errno == EINTR);
+    return sent == (ssize_t)sizeof(*message) ? 0 : -1;
+}
+
+/**
+ * shareOfCpus:
+ * Computes the CPUs of hive `index` when the CPUs of the calling process are split
+ * evenly between `hives` hives (hives share CPUs when there are fewer CPUs than hives).
+ *
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int shareOfCpus(int index, int hives, cpu_set_t* share) {
+    cpu_set_t all;
+    if (sched_getaffinity(0, sizeof(all), &all) == -1) {
+        return -1;
+    }
+    int count = CPU_COUNT(&all);
+    int first = count >= hives ? index * count / hives : index % count;
+    int last = count >= hives ? (index + 1) * count / hives : first + 1;
+
+    CPU_ZERO(share);
+    for (int cpu = 0, seen = 0; cpu < CPU_SETSIZE && seen < last; cpu++) {
+        if (!CPU_ISSET(cpu, &all)) continue;
+        if (seen >= first) CPU_SET(cpu, share);
+        seen++;
+    }
+    return 0;
+}
+
+/**
+ * balance:
+ * Orders bees from the hive with the highest population ratio (beesAlive / N) to the one
+ * with the lowest, when they differ by more than APIARY_IMBALANCE. Only hives that
+ * reported since the last order take part, so an order is never based on stale loads.
+ *
+ * @param entries The hives.
+ * @param hives Number of hives.
+ * @return Number of bees ordered to move.
+ */
+static int balance(HiveEntry* entries, int hives) {
+    int source = -1, destination = -1;
+    double highest = 0.0, lowest = 0.0;
+    for (int h = 0; h < hives; h++) {
+        HiveEntry* e = &entries[h];
+        if (e->fd == -1 || !e->reported || e->N <= 0) continue;
+        double ratio = (double)e->beesAlive / e->N;
+        if (source == -1 || ratio > highest) {
+            source = h;
+            highest = ratio;
+        }
+        if (destination == -1 || ratio < lowest) {
+            destination = h;
+            lowest = ratio;
+        }
+    }
+    if (source == -1 || source == destination || highest - lowest <= APIARY_IMBALANCE) {
+        return 0;
+    }
+
+    // Moving `count` bees equalizes the two ratios
+    HiveEntry* from = &entries[source];
+    HiveEntry* to = &entries[destination];
+    int count = (int)(((long)from->beesAlive * to->N - (long)to->beesAlive * from->N) / (from->N + to->N));
+    int room = to->N - to->beesAlive;
+    if (count > room) count = room;
+    if (count > APIARY_MAX_BATCH) count = APIARY_MAX_BATCH;
+    if (count <= 0) {
+        return 0;
+    }
+
+    ApiaryMessage order = {.type = APIARY_MSG_EMIGRATE, .hive = destination, .count = count};
+    if (sendMessage(from->fd, &order) == -1) {
+        return 0;
+    }
+    logMessage(LOG_INFO, "[Apiary] Moving %d bees from hive %d (%d/%d) to hive %d (%d/%d).",
+               count, source, from->beesAlive, from->N, destination, to->beesAlive, to->N);
+    from->reported = false;
+    to->reported = false;
+    return count;
+}
+
+/**
+ * abandonHives:
+ * Stops the hives still running after the coordinator failed: each one is terminated,
+ * which takes its colony down with it, and reaped. errno is preserved.
+ *
+ * @param entries The hives.
+ * @param hives Number of entries.
+ */
+static void abandonHives(HiveEntry* entries, int hives) {
+    int saved = errno;
+    for (int h = 0; h < hives; h++) {
+        if (entries[h].fd == -1) continue;
+        kill(entries[h].pid, SIGTERM);
+        close(entries[h].fd);
+        entries[h].fd = -1;
+    }
+    for (int h = 0; h < hives; h++) {
+        while (waitpid(entries[h].pid, NULL, 0) == -1 && errno == EINTR) {
+        }
+    }
+    errno = saved;
+}
+
+int apiaryRun(int hives, bool splitCpus, ApiaryHiveFunction run, void* context) {
+    HiveEntry entries[APIARY_MAX_HIVES];
+    for (int h = 0; h < hives; h++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair) == -1) {
+            logMessage(LOG_ERROR, "[Apiary] socketpair failed: %s", strerror(errno));
+            abandonHives(entries, h);
+            return -1;
+        }
+        fflush(NULL); // Nothing the host buffered may be written again by the hive
+        pid_t pid = fork();
+        if (pid == 0) {
+            // The hive keeps its own end only
+            for (int other = 0; other < h; other++) {
+                close(entries[other].fd);
+            }
+            close(pair[0]);
+            if (splitCpus) {
+                cpu_set_t share;
+                if (shareOfCpus(h, hives, &share) == -1 || sched_setaffinity(0, sizeof(share), &share) == -1) {
+                    logMessage(LOG_WARNING, "[Apiary] Failed to restrict hive %d to its CPUs: %s", h, strerror(errno));
+                }
+            }
+            exitColonyProcess(run(context, h, pair[1]));
+        } else if (pid < 0) {
+            logMessage(LOG_ERROR, "[Apiary] Failed to fork hive process: %s", strerror(errno));
+            int saved = errno;
+            close(pair[0]);
+            close(pair[1]);
+            errno = saved;
+            abandonHives(entries, h);
+            return -1;
+        }
+        close(pair[1]);
+        entries[h] = (HiveEntry){pid, pair[0], false, 0, 0, 0};
+    }
+    logMessage(LOG_INFO, "[Apiary] Started %d hives.", hives);
+
+    // Relay reports, orders and bees until every hive has closed its socket
+    int open = hives, ordered = 0, relayed = 0, dropped = 0;
+    double nextBalance = monotonicSeconds() + APIARY_REPORT_INTERVAL;
+    while (open > 0) {
+        struct pollfd fds[APIARY_MAX_HIVES];
+        for (int h = 0; h < hives; h++) {
+            fds[h].fd = entries[h].fd; // Negative descriptors are ignored by poll
+            fds[h].events = POLLIN;
+            fds[h].revents = 0;
+        }
+        int timeoutMs = (int)((nextBalance - monotonicSeconds()) * 1000) + 1;
+        if (poll(fds, hives, timeoutMs < 0 ? 0 : timeoutMs) == -1 && errno != EINTR) {
+            logMessage(LOG_ERROR, "[Apiary] poll failed: %s", strerror(errno));
+            abandonHives(entries, hives);
+            return -1;
+        }
+
+        for (int h = 0; h < hives; h++) {
+            if (!(fds[h].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ApiaryMessage message;
+            ssize_t received = recv(entries[h].fd, &message, sizeof(message), 0);
+            if (received <= 0) {
+                if (received == -1 && errno == EINTR) continue;
+                close(entries[h].fd);
+                entries[h].fd = -1;
+                open--;
+                continue;
+            }
+            if (received != (ssize_t)sizeof(message)) continue;
+
+            if (message.type == APIARY_MSG_LOAD) {
+                entries[h].reported = true;
+                entries[h].beesAlive = message.beesAlive;
+                entries[h].N = message.N;
+                entries[h].occupancy = message.occupancy;
+            } else if (message.type == APIARY_MSG_BEE) {
+                int to = message.hive;
+                if (to >= 0 && to < hives && entries[to].fd != -1 && sendMessage(entries[to].fd, &message) == 0) {
+                    relayed++;
+                } else {
+                    logMessage(LOG_WARNING, "[Apiary] Bee %d cannot reach hive %d and is lost.", message.bee.id, to);
+                    dropped++;
+                }
+            }
+        }
+
+        if (monotonicSeconds() >= nextBalance) {
+            ordered += balance(entries, hives);
+            nextBalance = monotonicSeconds() + APIARY_REPORT_INTERVAL;
+        }
+    }
+
+    int failures = 0;
+    for (int h = 0; h < hives; h++) {
+        int status;
+        if (waitpid(entries[h].pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            logMessage(LOG_WARNING, "[Apiary] Hive %d did not exit cleanly.", h);
+            failures++;
+        }
+    }
+    logMessage(LOG_INFO, "[Apiary] Migrations ordered: %d, bees relayed: %d, lost: %d.", ordered, relayed, dropped);
+    return failures ? 1 : 0;
+}
+
+/**
+ * emigrate:
+ * Sends up to `count` bees to another hive. Only bees flying outside with time left in
+ * their pause are chosen. The hive lock and every frame lock are held throughout, as for
+ * a checkpoint, so a bee whose pause runs out meanwhile blocks on its frame before it can
+ * queue. Each one is killed and its slot given back, and its state travels as a
+ * CheckpointBee to be resumed by a new process in the destination hive.
+ *
+ * @param link The hive's link to the coordinator.
+ * @param destination Index of the destination hive.
+ * @param count Number of bees to send.
+ */
+static void emigrate(ApiaryLink* link, int destination, int count) {
+    CheckpointBee bees[APIARY_MAX_BATCH];
+    if (count > APIARY_MAX_BATCH) count = APIARY_MAX_BATCH;
+
+    if (lockHive(link->semaphores, link->hive, link->table) == -1) {
+        logMessage(LOG_ERROR, "[Hive %d] lock (hiveSem) failed: %s", link->hiveIndex, strerror(errno));
+        return;
+    }
+    if (lockAllFrames(link->semaphores) == -1) {
+        logMessage(LOG_ERROR, "[Hive %d] lock (frameSem) failed: %s", link->hiveIndex, strerror(errno));
+        robustUnlock(&link->semaphores->hiveSem);
+        return;
+    }
+    int64_t now = clockNanos(CLOCK_MONOTONIC);
+    int sent = 0;
+    // Bees about to die, or about to queue, are not sent away
+    for (uint64_t i = 0; i < link->table->capacity && sent < count; i++) {
+        BeeSlot* s = &link->table->slots[i];
+        int64_t wakeAt = __atomic_load_n(&s->wakeAt, __ATOMIC_ACQUIRE);
+        if (s->state != BEE_SLOT_OUTSIDE || s->pid == 0 || wakeAt <= now ||
+            s->visits >= READ_TUNABLE(link->config, maxVisits) || (s->flags & BEE_SLOT_NEWBORN)) {
+            continue;
+        }
+        // SIGKILL is fatal before the bee can run again, so it never touches the slot afterwards
+        if (supervisorSignalBee(link->supervisor, s->id, (int)i, SIGKILL) == -1) {
+            continue;
+        }
+        CheckpointBee* bee = &bees[sent++];
+        bee->id = s->id;
+        bee->state = BEE_SLOT_OUTSIDE;
+        bee->entrance = s->entrance;
+        bee->visits = s->visits;
+        bee->seed = __atomic_load_n(&s->seed, __ATOMIC_RELAXED);
+        bee->flags = 0;
+        bee->frame = s->frame;
+        bee->remainingNs = wakeAt > now ? wakeAt - now : 0;
+        BeeTimes times;
+        beeTableTimes(s, &times);
+        bee->queueMs = times.queueMs;
+        bee->insideMs = times.insideMs;
+        bee->outsideMs = times.outsideMs;
+        bee->rejections = s->rejections;
+        bee->cohort = s->cohort;
+        beeTableRelease(link->table, (int)i);
+        link->hive->beesAlive--;
+        link->hive->emigrations++;
+    }
+    unlockAllFrames(link->semaphores);
+    robustUnlock(&link->semaphores->hiveSem);
+
+    for (int i = 0; i < sent; i++) {
+        ApiaryMessage message = {.type = APIARY_MSG_BEE, .hive = destination, .origin = link->hiveIndex, .bee = bees[i]};
+        if (sendMessage(link->fd, &message) == -1) {
+            logMessage(LOG_WARNING, "[Hive %d] Failed to send bee %d to hive %d: %s", link->hiveIndex, bees[i].id, destination, strerror(errno));
+        }
+    }
+    if (sent > 0) {
+        logMessage(LOG_INFO, "[Hive %d] %d bees emigrated to hive %d.", link->hiveIndex, sent, destination);
+    }
+}
+
+/**
+ * immigrate:
+ * Takes in a bee from another hive and starts a process resuming it. A bee that finds
+ * no free slot is sent back to its origin once; after that it is lost.
+ *
+ * @param link The hive's link to the coordinator.
+ * @param message The BEE message.
+ */
+static void immigrate(ApiaryLink* link, const ApiaryMessage* message) {
+    if (lockHive(link->semaphores, link->hive, link->table) == -1) {
+        logMessage(LOG_ERROR, "[Hive %d] lock (hiveSem) failed: %s", link->hiveIndex, strerror(errno));
+        return;
+    }
+    int slot = checkpointRestoreBee(link->table, &message->bee);
+    if (slot != -1) {
+        link->hive->beesAlive++;
+        link->hive->immigrations++;
+    }
+    robustUnlock(&link->semaphores->hiveSem);
+
+    if (slot == -1) {
+        if (!message->bounced) {
+            ApiaryMessage back = *message;
+            back.hive = message->origin;
+            back.origin = link->hiveIndex;
+            back.bounced = 1;
+            if (sendMessage(link->fd, &back) == 0) return;
+        }
+        logMessage(LOG_WARNING, "[Hive %d] No room for bee %d from hive %d; the bee is lost.", link->hiveIndex, message->bee.id, message->origin);
+        return;
+    }
+
+    pid_t pid = link->spawn(link->spawnContext, message->bee.id, slot);
+    if (pid == -1 || supervisorWatch(link->supervisor, pid, SUPERVISED_BEE, message->bee.id, slot) == -1) {
+        logMessage(LOG_WARNING, "[Hive %d] Cannot start immigrant bee %d: %s", link->hiveIndex, message->bee.id, strerror(errno));
+        if (pid != -1) {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+        if (lockHive(link->semaphores, link->hive, link->table) == 0) {
+            beeTableRelease(link->table, slot);
+            link->hive->beesAlive--;
+            link->hive->immigrations--;
+            robustUnlock(&link->semaphores->hiveSem);
+        }
+    }
+}
+
+void apiaryService(ApiaryLink* link, double now) {
+    if (link->fd == -1) return;
+
+    if (now >= link->nextReport) {
+        ApiaryMessage report = {.type = APIARY_MSG_LOAD, .hive = link->hiveIndex, .beesAlive = link->hive->beesAlive,
+                                .N = link->hive->N, .occupancy = link->hive->currentBeesInHive};
+        sendMessage(link->fd, &report);
+        link->nextReport = now + APIARY_REPORT_INTERVAL;
+    }
+
+    ApiaryMessage message;
+    ssize_t received;
+    while ((received = recv(link->fd, &message, sizeof(message), MSG_DONTWAIT)) == (ssize_t)sizeof(message)) {
+        if (message.type == APIARY_MSG_EMIGRATE) {
+            emigrate(link, message.hive, message.count);
+        } else if (message.type == APIARY_MSG_BEE) {
+            immigrate(link, &message);
+        }
+    }
+    if (received == 0) {
+        // The coordinator is gone; the hive carries on alone
+        close(link->fd);
+        link->fd = -1;
+    }
+}
@@ -2,7 +2,10 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
-#include <semaphore.h>
+#include "hivelock.h"
+#include "frames.h"
+#include "cohorts.h"
+#include "configpage.h"
 #include <sys/prctl.h>
 #include "common.h"
 
@@ -24,9 +27,146 @@ int chooseEntrance(int beesWaiting[2], unsigned int* seed) {
     }
 }
 
+/**
+ * outsideTime:
+ * Draws the time a bee spends flying outside before it tries to enter the hive.
+ *
+ * @param tunables The bee's copy of the live parameters, holding the flight time bounds.
+ * @param seed State of the bee's random number generator.
+ * @return Time in seconds.
+ */
+static int outsideTime(const HiveTunables* tunables, unsigned int* seed) {
+    int minTime = tunables->minOutsideTime;
+    int maxTime = tunables->maxOutsideTime;
+    if (maxTime < minTime) maxTime = minTime;
+    return (rand_r(seed) % (maxTime - minTime + 1)) + minTime;
+}
+
+/**
+ * Simulates the passage through an entrance, which the bee holds meanwhile.
+ *
+ * @param milliseconds Length of the passage.
+ */
+static void passThrough(int milliseconds) {
+    struct timespec delay = {milliseconds / 1000, (long)(milliseconds % 1000) * 1000000L};
+    while (nanosleep(&delay, &delay) == -1 && errno == EINTR);
+}
+
+/**
+ * pauseBee:
+ * Sleeps through a pause of the bee's lifecycle. The end of the pause and the RNG state
+ * are recorded in the bee's slot first, so a checkpoint taken meanwhile keeps the
+ * remaining time. The bee exits instead of resuming if the colony is shutting down.
+ *
+ * @param bee The bee.
+ * @param seconds Length of the pause.
+ * @param seed RNG state of the bee after drawing the pause.
+ */
+static void pauseBee(BeeArgs* bee, double seconds, unsigned int seed) {
+    struct timespec wake;
+    clock_gettime(CLOCK_MONOTONIC, &wake);
+    int64_t wakeAt = (int64_t)wake.tv_sec * 1000000000LL + wake.tv_nsec + (int64_t)(seconds * 1e9);
+    beeTableSetPause(bee->table, bee->slot, wakeAt, seed);
+
+    wake.tv_sec = wakeAt / 1000000000LL;
+    wake.tv_nsec = wakeAt % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR &&
+           !shutdownRequested(bee->semaphores));
+
+    // A colony that is shutting down is left without queuing for any lock
+    if (shutdownRequested(bee->semaphores)) {
+        exitColonyProcess(EXIT_SUCCESS);
+    }
+}
+
+/**
+ * joinQueue:
+ * Waits in the FIFO queue of an entrance, then takes the entrance.
+ *
+ * @param bee The bee.
+ * @param entrance The entrance.
+ * @return true once both locks are held, false if the entrance is unavailable.
+ */
+static bool joinQueue(BeeArgs* bee, int entrance) {
+    if (robustLock(&bee->semaphores->fifoQueue[entrance], bee->semaphores) == -1) {
+        handleError("[Bee] lock (fifoQueue) failed", -1, -1);
+    }
+    if (robustLock(&bee->semaphores->entranceSem[entrance], bee->semaphores) == -1) {
+        // Release the FIFO queue semaphore since the entrance is unavailable
+        if (robustUnlock(&bee->semaphores->fifoQueue[entrance]) == -1) {
+            handleError("[Bee] unlock (fifoQueue) failed", -1, -1);
+        }
+        return false;
+    }
+    return true;
+}
+
+/**
+ * passEntrance:
+ * Releases the entrance and its FIFO queue after a bee went through.
+ *
+ * @param bee The bee.
+ * @param entrance The entrance.
+ */
+static void passEntrance(BeeArgs* bee, int entrance) {
+    if (robustUnlock(&bee->semaphores->entranceSem[entrance]) == -1) {
+        handleError("[Bee] unlock (entranceSem)", -1, -1);
+    }
+    if (robustUnlock(&bee->semaphores->fifoQueue[entrance]) == -1) {
+        handleError("[Bee] unlock (fifoQueue) failed", -1, -1);
+    }
+}
+
+/**
+ * lockBeeFrame:
+ * Locks a frame for a transition of the bee.
+ */
+static void lockBeeFrame(BeeArgs* bee, int frame) {
+    if (lockFrame(bee->semaphores, frame) == -1) {
+        handleError("[Bee] lock (frameSem) failed", -1, -1);
+    }
+}
+
+/**
+ * unlockBeeFrame:
+ * Unlocks a frame locked with lockBeeFrame.
+ */
+static void unlockBeeFrame(BeeArgs* bee, int frame) {
+    if (unlockFrame(bee->semaphores, frame) == -1) {
+        handleError("[Bee] unlock (frameSem) failed", -1, -1);
+    }
+}
+
+/**
+ * queueAtEntrance:
+ * Picks the entrance with the shorter queue and joins its count, under the lock of the
+ * bee's frame.
+ *
+ * @param bee The bee.
+ * @param state BEE_SLOT_QUEUED_IN or BEE_SLOT_QUEUED_OUT.
+ * @param frame Frame the bee is on, or returns to.
+ * @param seed State of the bee's random number generator.
+ * @return The chosen entrance.
+ */
+static int queueAtEntrance(BeeArgs* bee, BeeSlotState state, int frame, unsigned int* seed) {
+    lockBeeFrame(bee, frame);
+
+    // Choose an entrance based on the queue length at each entrance
+    int entrance = chooseEntrance(bee->hive->beesWaiting, seed);
+    int waiting = __atomic_add_fetch(&bee->hive->beesWaiting[entrance], 1, __ATOMIC_RELAXED);
+    beeTableUpdate(bee->table, bee->slot, state, bee->visits, entrance);
+    eventBusPublish(bee->events, HIVE_EVENT_QUEUE, bee->id, entrance, waiting,
+                    state == BEE_SLOT_QUEUED_OUT ? HIVE_EVENT_OUTBOUND : 0);
+
+    unlockBeeFrame(bee, frame);
+    return entrance;
+}
+
 /**
  * beeWorker:
  * Implements the behavior of a worker bee in the hive simulation.
+ * The lifecycle is driven by the state recorded in the bee's slot, so a bee restored
+ * from a checkpoint continues from wherever it was when the snapshot was taken.
  */
 void beeWorker(BeeArgs* arg) {
     BeeArgs* bee = arg;
@@ -38,208 +178,171 @@ void beeWorker(BeeArgs* arg) {
     bee->hive = (HiveData*)attachSharedMemory(bee->shmid);
     bee->semaphores = (HiveSemaphores*)attachSharedMemory(bee->semid);
     if (bee->hive == NULL || bee->semaphores == NULL) {
-        handleError("[Bee] attachSharedMemory", -1, bee->semid);
+        handleError("[Bee] attachSharedMemory", -1, -1);
     }
 
+    beeTableSetPid(bee->table, bee->slot, getpid());
+
     // Initialize random seed for wait time calculations
     unsigned int seed = (unsigned int)time(NULL) ^ (getpid() << 16) ^ (bee->id << 8);
 
-    // Handle bees born in the hive
-    if (bee->startInHive) {
+    BeeSlotState state;
+    int entrance = 0;
+    int frame = bee->table->slots[bee->slot].frame; // Frame the bee is on, or returns to first
+    bool newborn = bee->startInHive; // A bee born in the hive does not count its first exit as a visit
+    double pause = -1.0;             // Remaining pause of the current state; negative draws a new one
+    HiveTunables tunables;           // Copy of the live parameters, taken afresh at every step
+    configDefaults(&tunables);
+    configPageRead(bee->config, &tunables, NULL);
+
+    if (bee->resume) {
+        const BeeSlot* s = &bee->table->slots[bee->slot];
+        state = (BeeSlotState)s->state;
+        entrance = s->entrance;
+        bee->visits = s->visits;
+        newborn = (s->flags & BEE_SLOT_NEWBORN) != 0;
+        if (s->seed != 0) seed = s->seed;
+        if (s->wakeAt != 0) {
+            pause = (s->wakeAt - clockNanos(CLOCK_MONOTONIC)) / 1e9;
+            if (pause < 0) pause = 0;
+        }
+        logMessage(LOG_INFO, "[Bee %d] Resuming from checkpoint (state %d, visits %d).", bee->id, (int)state, bee->visits);
+    } else if (bee->startInHive) {
         logMessage(LOG_INFO, "[Bee %d] Starting in the hive.", bee->id);
-
+        state = BEE_SLOT_INSIDE;
         // Simulate initial time spent inside the hive
-        int timeInHive = (rand_r(&seed) % (1)) + (bee->T_inHive);
-        sleep(timeInHive);
-
-        // Lock hive access to update the number of bees in the hive
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem)", -1, bee->semid);
-        }
-
-        // Choose an entrance for exiting, based on the queue length at each entrance
-        int entrance = chooseEntrance(bee->hive->beesWaiting, &seed);
-
-        // Increment the count of bees waiting at the selected entrance
-        bee->hive->beesWaiting[entrance]++;
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-
-        // Join the FIFO queue at the chosen entrance
-        if (sem_wait(&bee->semaphores->fifoQueue[entrance]) == -1) {
-            handleError("[Bee] sem_wait (fifoQueue) failed", -1, bee->semid);
-        }
-
-        // Attempt to access the entrance
-        if (sem_wait(&bee->semaphores->entranceSem[entrance]) == -1) {
-            // Release the FIFO queue semaphore since the entrance is unavailable
-            if (sem_post(&bee->semaphores->fifoQueue[entrance]) == -1) {
-                handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-            }
-            // Explicitly handle the case without `continue` since there's no loop
-            logMessage(LOG_ERROR, "[Bee %d] Entrance %d unavailable during start, exiting hive aborted.", bee->id, entrance);
-            bee->startInHive = false; // Mark as having exited, even if aborted
-            return; // Exit the function early for this bee
-        }
-
-        // Decrement the count of waiting bees
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem)", -1, bee->semid);
-        }
-        bee->hive->beesWaiting[entrance]--;
-
-        // Exit the hive properly through the queue
-        usleep(100000);
-        bee->hive->currentBeesInHive--;
-        logMessage(LOG_INFO, "[Bee %d] Leaving through entrance %d. (Bees in hive: %d)", bee->id, entrance, bee->hive->currentBeesInHive);
-
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-
-        if (sem_post(&bee->semaphores->entranceSem[entrance]) == -1) {
-            handleError("[Bee] sem_post (entranceSem)", -1, bee->semid);
-        }
-
-        if (sem_post(&bee->semaphores->fifoQueue[entrance]) == -1) {
-            handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-        }
-
-        bee->startInHive = false; // Mark that the bee has left the hive initially
+        pause = (rand_r(&seed) % (1)) + tunables.T_inHive;
+    } else {
+        state = BEE_SLOT_OUTSIDE;
     }
 
     // Main lifecycle of the bee
-    while (bee->visits < bee->maxVisits) {
-        int sleepTimeOutside = (rand_r(&seed) % (MAX_OUTSIDE_TIME - MIN_OUTSIDE_TIME + 1)) + MIN_OUTSIDE_TIME;
-        sleep(sleepTimeOutside); 
-        // Select an entrance for entering the hive
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem) failed", -1, bee->semid);
-        }
-
-        int entrance = chooseEntrance(bee->hive->beesWaiting, &seed);
-
-        bee->hive->beesWaiting[entrance]++;
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-
-        // Enter the queue for the chosen entrance
-        if (sem_wait(&bee->semaphores->fifoQueue[entrance]) == -1) {
-            handleError("[Bee] sem_wait (fifoQueue) failed", -1, bee->semid);
-        }
-
-        if (sem_wait(&bee->semaphores->entranceSem[entrance]) == -1) {
-            if (sem_post(&bee->semaphores->fifoQueue[entrance]) == -1) {
-                handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-            }
-            continue;
+    while (1) {
+        // Lock-free; if a writer keeps the page busy, the bee goes on with its previous copy
+        configPageRead(bee->config, &tunables, NULL);
+        if (state == BEE_SLOT_OUTSIDE && bee->visits >= tunables.maxVisits) {
+            break;
         }
 
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem)", -1, bee->semid);
+        switch (state) {
+            case BEE_SLOT_OUTSIDE:
+                // Simulate time spent outside the hive, then select an entrance for entering it
+                if (pause < 0) pause = outsideTime(&tunables, &seed);
+                pauseBee(bee, pause, seed);
+                entrance = queueAtEntrance(bee, BEE_SLOT_QUEUED_IN, frame, &seed);
+                state = BEE_SLOT_QUEUED_IN;
+                break;
+
+            case BEE_SLOT_QUEUED_IN:
+                // Enter the queue for the chosen entrance
+                if (!joinQueue(bee, entrance)) {
+                    sleep(1);
+                    break;
+                }
+
+                // Attempt to enter the hive: take room on a frame, near the last one if possible
+                int room;
+                if (lockFreeFrame(bee->hive, bee->semaphores, frame, &room) == -1) {
+                    handleError("[Bee] lock (frameSem)", -1, -1);
+                }
+                if (room == -1) {
+                    lockBeeFrame(bee, frame);
+                    __atomic_sub_fetch(&bee->hive->beesWaiting[entrance], 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&bee->hive->rejections, 1, __ATOMIC_RELAXED);
+                    beeTableCountRejection(bee->table, bee->slot);
+                    beeTableUpdate(bee->table, bee->slot, BEE_SLOT_OUTSIDE, bee->visits, entrance);
+                    eventBusPublish(bee->events, HIVE_EVENT_REJECT, bee->id, entrance,
+                                    __atomic_load_n(&bee->hive->currentBeesInHive, __ATOMIC_RELAXED), 0);
+                    unlockBeeFrame(bee, frame);
+                    passEntrance(bee, entrance);
+                    // Wait for a while before retrying, on top of the usual flight
+                    state = BEE_SLOT_OUTSIDE;
+                    pause = 1 + outsideTime(&tunables, &seed);
+                    break;
+                }
+
+                // Successfully entering the hive
+                frame = room;
+                __atomic_sub_fetch(&bee->hive->beesWaiting[entrance], 1, __ATOMIC_RELAXED);
+                int inHive = frameEnter(bee->hive, frame);
+                __atomic_fetch_add(&bee->hive->entries, 1, __ATOMIC_RELAXED);
+                __atomic_fetch_add(&bee->hive->transits[entrance], 1, __ATOMIC_RELAXED);
+                beeTableSetFrame(bee->table, bee->slot, frame);
+                beeTableUpdate(bee->table, bee->slot, BEE_SLOT_INSIDE, bee->visits, entrance);
+                eventBusPublish(bee->events, HIVE_EVENT_ENTER, bee->id, entrance, inHive, 0);
+                unlockBeeFrame(bee, frame);
+                passThrough(tunables.transitMs); // The entrance stays taken, the frames do not
+                passEntrance(bee, entrance);
+                // Formatted once the locks are released
+                logMessage(LOG_INFO, "[Bee %d] Entering through entrance %d. (Bees in hive: %d)", bee->id, entrance, inHive);
+
+                // Stay in the hive for the configured time
+                state = BEE_SLOT_INSIDE;
+                pause = tunables.T_inHive;
+                break;
+
+            case BEE_SLOT_INSIDE:
+                // Exit the hive (same logic as entering)
+                if (pause < 0) pause = tunables.T_inHive;
+                pauseBee(bee, pause, seed);
+                entrance = queueAtEntrance(bee, BEE_SLOT_QUEUED_OUT, frame, &seed);
+                state = BEE_SLOT_QUEUED_OUT;
+                break;
+
+            case BEE_SLOT_QUEUED_OUT:
+                if (!joinQueue(bee, entrance)) {
+                    logMessage(LOG_ERROR, "[Bee %d] Entrance %d unavailable, retrying to leave.", bee->id, entrance);
+                    sleep(1);
+                    break;
+                }
+
+                // Successfully exiting the hive
+                passThrough(tunables.transitMs);
+                lockBeeFrame(bee, frame);
+                __atomic_sub_fetch(&bee->hive->beesWaiting[entrance], 1, __ATOMIC_RELAXED);
+                int leftInHive = frameLeave(bee->hive, frame);
+                __atomic_fetch_add(&bee->hive->transits[entrance], 1, __ATOMIC_RELAXED);
+                if (!newborn) bee->visits++;
+                beeTableUpdate(bee->table, bee->slot, BEE_SLOT_OUTSIDE, bee->visits, entrance);
+                if (newborn) {
+                    beeTableSetFlags(bee->table, bee->slot, 0);
+                    newborn = false;
+                }
+                eventBusPublish(bee->events, HIVE_EVENT_LEAVE, bee->id, entrance, leftInHive, 0);
+                unlockBeeFrame(bee, frame);
+                passEntrance(bee, entrance);
+                logMessage(LOG_INFO, "[Bee %d] Leaving through entrance %d. (Bees in hive: %d)", bee->id, entrance, leftInHive);
+
+                state = BEE_SLOT_OUTSIDE;
+                pause = -1.0;
+                break;
+
+            default:
+                handleError("[Bee] Invalid lifecycle state", -1, -1);
         }
-        bee->hive->beesWaiting[entrance]--;
-
-        // Attempt to enter the hive
-        if (bee->hive->currentBeesInHive >= calculateP(bee->hive->N)) {
-            if (sem_post(&bee->semaphores->hiveSem) == -1) {
-                handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-            }
-            if (sem_post(&bee->semaphores->entranceSem[entrance]) == -1) {
-                handleError("[Bee] sem_post (entranceSem)", -1, bee->semid);
-            }
-            if (sem_post(&bee->semaphores->fifoQueue[entrance]) == -1) {
-                handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-            }
-            sleep(1); // Wait for a while before retrying
-            continue;
-        }
-
-        // Successfully entering the hive
-        usleep(100000); // Simulate entry delay
-        bee->hive->currentBeesInHive++;
-        logMessage(LOG_INFO, "[Bee %d] Entering through entrance %d. (Bees in hive: %d)", bee->id, entrance, bee->hive->currentBeesInHive);
-
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-        if (sem_post(&bee->semaphores->entranceSem[entrance]) == -1) {
-            handleError("[Bee] sem_post (entranceSem)", -1, bee->semid);
-        }
-        if (sem_post(&bee->semaphores->fifoQueue[entrance]) == -1) {
-            handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-        }
-
-        // Stay in the hive for a random time
-        
-        sleep(T_IN_HIVE);
-
-        // Exit the hive (same logic as entering)
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem) failed", -1, bee->semid);
-        }
-
-        int leaving = chooseEntrance(bee->hive->beesWaiting, &seed);
-
-        bee->hive->beesWaiting[leaving]++;
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-
-        if (sem_wait(&bee->semaphores->fifoQueue[leaving]) == -1) {
-            handleError("[Bee] sem_wait (fifoQueue) failed", -1, bee->semid);
-        }
-
-        if (sem_wait(&bee->semaphores->entranceSem[leaving]) == -1) {
-            if (sem_post(&bee->semaphores->fifoQueue[leaving]) == -1) {
-                handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-            }
-            continue;
-        }
-
-        if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_wait (hiveSem)", -1, bee->semid);
-        }
-        bee->hive->beesWaiting[leaving]--;
-
-        // Successfully exiting the hive
-        usleep(100000);
-        bee->hive->currentBeesInHive--;
-        logMessage(LOG_INFO, "[Bee %d] Leaving through entrance %d. (Bees in hive: %d)", bee->id, leaving, bee->hive->currentBeesInHive);
-
-        if (sem_post(&bee->semaphores->hiveSem) == -1) {
-            handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
-        }
-        if (sem_post(&bee->semaphores->entranceSem[leaving]) == -1) {
-            handleError("[Bee] sem_post (entranceSem)", -1, bee->semid);
-        }
-        if (sem_post(&bee->semaphores->fifoQueue[leaving]) == -1) {
-            handleError("[Bee] sem_post (fifoQueue) failed", -1, bee->semid);
-        }
-
-        // Simulate time spent outside the hive
-        bee->visits++;
     }
 
     // Final steps when the bee "dies"
-    if (sem_wait(&bee->semaphores->hiveSem) == -1) {
-        handleError("[Bee] sem_wait (hiveSem) failed", -1, bee->semid);
+    if (lockHive(bee->semaphores, bee->hive, bee->table) == -1) {
+        handleError("[Bee] lock (hiveSem) failed", -1, -1);
     }
 
     // Decrease the number of alive bees
-    bee->hive->beesAlive--;
-    logMessage(LOG_INFO, "[Bee %d] Dying. (Remaining bees: %d)", bee->id, bee->hive->beesAlive);
-
-    if (sem_post(&bee->semaphores->hiveSem) == -1) {
-        handleError("[Bee] sem_post (hiveSem)", -1, bee->semid);
+    int remaining = --bee->hive->beesAlive;
+    __atomic_fetch_add(&bee->hive->deaths, 1, __ATOMIC_RELAXED);
+    eventBusPublish(bee->events, HIVE_EVENT_DEATH, bee->id, entrance, bee->visits, 0);
+    cohortRecord(bee->hive, &bee->table->slots[bee->slot], false);
+    beeTableRelease(bee->table, bee->slot);
+
+    if (robustUnlock(&bee->semaphores->hiveSem) == -1) {
+        handleError("[Bee] unlock (hiveSem)", -1, -1);
     }
+    logMessage(LOG_INFO, "[Bee %d] Dying. (Remaining bees: %d)", bee->id, remaining);
 
     // Detach from shared memory
     detachSharedMemory(bee->hive);
     detachSharedMemory(bee->semaphores);
 
     // Exit the bee process
-    exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+    exitColonyProcess(EXIT_SUCCESS);
+}
\ No newline at end of file
@@ -0,0 +1,1027 @@
+#define _GNU_SOURCE
+#include "beehive.h"
+#include "bee.h"
+#include "queen.h"
+#include "beekeeper.h"
+#include "beetable.h"
+#include "hivelock.h"
+#include "frames.h"
+#include "supervisor.h"
+#include "checkpoint.h"
+#include "apiary.h"
+#include "exporter.h"
+#include "eventbus.h"
+#include "configpage.h"
+#include <stdint.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+
+/**
+ * Interval (in seconds) at which beehiveStep samples hive occupancy.
+ */
+#define BEEHIVE_SAMPLE_INTERVAL 0.1
+
+/**
+ * Size requested for the pipe carrying the log messages of an instance's processes.
+ */
+#define BEEHIVE_LOG_PIPE_SIZE (1 << 20)
+
+/**
+ * Longest time (in milliseconds) beehiveStop waits for exits before draining the log pipe again.
+ */
+#define BEEHIVE_STOP_POLL_MS 100
+
+/**
+ * Time (in milliseconds) the colony's processes are given to exit after the stop signal
+ * before they are killed.
+ */
+#define BEEHIVE_DRAIN_MS 500
+
+/**
+ * Names of the BeehiveParameter values, as used in logs and scenario files.
+ */
+static const char* const PARAMETER_NAMES[BEEHIVE_PARAM_COUNT] = {
+    "N", "T_k", "eggsCount", "T_inHive", "maxVisits", "minOutsideTime", "maxOutsideTime", "transitMs", "maxBees"
+};
+
+/**
+ * Everything a bee process needs from the main process, shared by the initial bees
+ * and the newborns the supervisor forks on the queen's behalf.
+ */
+typedef struct {
+    HiveData* hive;
+    HiveSemaphores* semaphores;
+    int semid;
+    int shmid;
+    BeeTable* table;
+    const PlacementConfig* placement;
+    int logFd;        // Write end of the instance's log pipe, or -1.
+    pid_t* group;     // Process group of the colony (see joinGroup).
+    EventBus* events;
+    bool startInHive; // Newborns start inside the hive, initial bees outside.
+    bool resume;      // Bees restored from a checkpoint continue from the state in their slot.
+    const ConfigPage* config;
+} BeeSpawnContext;
+
+struct Beehive {
+    BeehiveOptions options;
+    PlacementConfig placement;     // Resolved copy of the caller's placement.
+    LogSink log;                   // Installed around every call into the instance.
+    int logPipe[2];                // Messages of the colony's processes, when log is set; else -1.
+    char logBuffer[4096];          // Partial message read from the log pipe.
+    size_t logLength;
+    int shmid;                     // HiveData segment, or -1.
+    int semid;                     // HiveSemaphores segment, or -1.
+    HiveData* hive;
+    HiveSemaphores* semaphores;
+    BeeTable* table;
+    EventBus* events;
+    ConfigPage* config;            // Live colony parameters.
+    Supervisor* supervisor;
+    pid_t group;                   // Process group of the colony's processes, or 0 before the first fork.
+    pid_t beekeeperPid;
+    BeeSpawnContext newborns;      // Forked by the supervisor on the queen's request.
+    BeeSpawnContext immigrants;    // Bees arriving from other hives of an apiary.
+    BeeSpawnContext arrivals;      // Bees added by beehiveAddBees, starting outside.
+    ApiaryLink apiary;
+    Exporter* exporter;
+    double colonyTime;             // Colony time before this run, carried over from a checkpoint.
+    double start;                  // CLOCK_MONOTONIC seconds of the start of the run.
+    double stoppedAt;              // Seconds from start to the end of the run, or -1 while it runs.
+    double nextSample;
+    long samples;
+    long occupancySum;
+    int maxOccupancy;
+    double survivalTime;
+    bool running;
+};
+
+/**
+ * Installs the instance's log destination on the calling thread and returns the previous one.
+ * Processes forked meanwhile keep it, so the whole colony logs to the same place.
+ */
+static const LogSink* enter(const Beehive* beehive) {
+    return setLogSink(beehive->log.log ? &beehive->log : NULL);
+}
+
+/**
+ * Restores the log destination saved by enter.
+ */
+static void leave(const LogSink* previous) {
+    setLogSink(previous);
+}
+
+/**
+ * reportError:
+ * Logs a failure of the instance with the current errno and passes it to the error callback.
+ *
+ * @param beehive The colony.
+ * @param message What failed.
+ */
+static void reportError(const Beehive* beehive, const char* message) {
+    int errnum = errno;
+    logMessage(LOG_ERROR, "%s: %s", message, strerror(errnum));
+    if (beehive->options.error) {
+        beehive->options.error(beehive->options.errorUser, message, errnum);
+    }
+    errno = errnum;
+}
+
+/**
+ * Writes a message of a colony process to the log pipe as one record: the level, the text
+ * and a newline. Records are shorter than PIPE_BUF, so those of different processes never
+ * interleave; when the pipe is full the message is dropped rather than stalling the colony.
+ */
+static void logToPipe(void* user, LogLevel level, const char* message) {
+    char record[1100];
+    int length = snprintf(record, sizeof(record), "%c%s", '0' + (int)level, message);
+    if (length >= (int)sizeof(record) - 1) length = (int)sizeof(record) - 2;
+    for (int i = 1; i < length; i++) {
+        if (record[i] == '\n') record[i] = ' ';
+    }
+    record[length++] = '\n';
+    ssize_t written = write((int)(intptr_t)user, record, (size_t)length);
+    (void)written;
+}
+
+/**
+ * becomeChild:
+ * Prepares a freshly forked colony process. It keeps only the given descriptors,
+ * renumbered from 3, followed by the log pipe. Every other descriptor of the calling
+ * process is closed, including those of other colonies embedded in it; with a log pipe,
+ * the standard output and error go to /dev/null. The default signal
+ * dispositions are restored, and the log goes to the instance's log pipe. The process is
+ * killed if the thread that forked it dies, so no colony process outlives its host.
+ *
+ * @param host Process ID of the host, taken before the fork.
+ * @param logFd Write end of the log pipe, or -1.
+ * @param keep Descriptors to keep (they become 3, 4, ...).
+ * @param count Number of descriptors in keep.
+ */
+static void becomeChild(pid_t host, int logFd, const int* keep, int count) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != host) {
+        _exit(EXIT_FAILURE); // The host died before the death signal was armed
+    }
+
+    int fds[4];
+    int total = 0;
+    for (int i = 0; i < count; i++) fds[total++] = keep[i];
+    if (logFd != -1) fds[total++] = logFd;
+
+    // Move the descriptors above their targets first, so renumbering never overwrites one
+    for (int i = 0; i < total; i++) {
+        fds[i] = fcntl(fds[i], F_DUPFD, 3 + total);
+    }
+    for (int i = 0; i < total; i++) {
+        dup2(fds[i], 3 + i);
+    }
+    close_range(3 + total, ~0U, 0);
+
+    // With a log pipe nothing of the colony belongs on the host's output, not even a
+    // stdio buffer some other thread of the host filled after the flush before the fork
+    if (logFd != -1) {
+        int devNull = open("/dev/null", O_RDWR);
+        if (devNull != -1) {
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+            close(devNull);
+        }
+    }
+
+    // The embedding process may have changed these dispositions
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+
+    static LogSink childLog;
+    if (logFd != -1) {
+        childLog = (LogSink){logToPipe, (void*)(intptr_t)(3 + count)};
+        setLogSink(&childLog);
+    } else {
+        setLogSink(NULL);
+    }
+}
+
+/**
+ * drainLog:
+ * Passes every complete message waiting in the log pipe to the instance's log function.
+ *
+ * @param beehive The colony.
+ */
+static void drainLog(Beehive* beehive) {
+    if (beehive->logPipe[0] == -1) return;
+    while (1) {
+        ssize_t got = read(beehive->logPipe[0], beehive->logBuffer + beehive->logLength,
+                           sizeof(beehive->logBuffer) - 1 - beehive->logLength);
+        if (got <= 0) break;
+        beehive->logLength += (size_t)got;
+
+        char* record = beehive->logBuffer;
+        char* end = beehive->logBuffer + beehive->logLength;
+        char* newline;
+        while ((newline = memchr(record, '\n', (size_t)(end - record))) != NULL) {
+            *newline = '\0';
+            LogLevel level = (LogLevel)(record[0] - '0');
+            beehive->log.log(beehive->log.user, level, record + 1);
+            record = newline + 1;
+        }
+        beehive->logLength = (size_t)(end - record);
+        memmove(beehive->logBuffer, record, beehive->logLength);
+    }
+}
+
+/**
+ * joinGroup:
+ * Moves a freshly forked process into the colony's process group, so a single signal
+ * reaches every process of the colony. The first process founds the group, and so does
+ * one forked after every member is gone. Only the parent moves it: colony processes never
+ * exec, and the group is only signalled from the thread that forks them.
+ *
+ * @param group Process group of the colony, or 0 before the first fork.
+ * @param pid The new process.
+ */
+static void joinGroup(pid_t* group, pid_t pid) {
+    if (*group == 0 || setpgid(pid, *group) == -1) {
+        setpgid(pid, pid);
+        *group = pid;
+    }
+}
+
+/**
+ * forkBee:
+ * Forks a bee process. The child drops every descriptor inherited from the main
+ * process, so the supervisor's pidfds and epoll set stay private to it.
+ * Matches SpawnBeeFunction so the supervisor can fork newborns with it.
+ *
+ * @param context The BeeSpawnContext.
+ * @param id Bee ID.
+ * @param slot Slot of the bee in the per-bee state table.
+ * @return Process ID of the bee, or -1 with errno set on failure.
+ */
+static pid_t forkBee(void* context, int id, int slot) {
+    const BeeSpawnContext* ctx = context;
+    pid_t host = getpid();
+    fflush(NULL); // The child must not inherit output the host has yet to write
+    pid_t pid = fork();
+    if (pid == 0) {
+        becomeChild(host, ctx->logFd, NULL, 0);
+        if (placeBee(ctx->placement, id) == -1) {
+            logMessage(LOG_WARNING, "[Bee %d] Failed to apply CPU placement: %s", id, strerror(errno));
+        }
+        BeeArgs beeArgs = {id, 0, ctx->hive, ctx->semaphores, ctx->startInHive,
+                           ctx->semid, ctx->shmid, ctx->table, slot, ctx->resume, ctx->events, ctx->config};
+        beeWorker(&beeArgs);
+        exitColonyProcess(EXIT_SUCCESS);
+    } else if (pid > 0) {
+        joinGroup(ctx->group, pid);
+    }
+    return pid;
+}
+
+/**
+ * startBee:
+ * Forks an initial or restored bee and starts watching it. A bee that cannot be watched
+ * is killed at once, so the instance never leaves a child it does not reap.
+ *
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int startBee(Beehive* beehive, const BeeSpawnContext* context, int id, int slot) {
+    pid_t pid = forkBee((void*)context, id, slot);
+    if (pid == -1) {
+        return -1;
+    }
+    if (supervisorWatch(beehive->supervisor, pid, SUPERVISED_BEE, id, slot) == -1) {
+        int saved = errno;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * startProcess:
+ * Starts watching the queen or the beekeeper; if that fails the process is killed and reaped.
+ *
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int startProcess(Beehive* beehive, pid_t pid, SupervisedKind kind) {
+    if (supervisorWatch(beehive->supervisor, pid, kind, -1, -1) == -1) {
+        int saved = errno;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * terminate:
+ * Stops every process of the colony. The colony is flagged as shutting down first, so no
+ * process lays, queues or forks a bee any more, and the supervisor drops the pending spawn
+ * requests. One signal to the colony's process group then reaches every process wherever
+ * it waits; those still running after BEEHIVE_DRAIN_MS are killed.
+ *
+ * @param beehive The colony.
+ * @param sig Signal sent to the colony's process group.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int terminate(Beehive* beehive, int sig) {
+    Supervisor* supervisor = beehive->supervisor;
+    if (beehive->semaphores) {
+        requestShutdown(beehive->semaphores);
+    }
+    supervisorShutdown(supervisor);
+
+    // While a member is not reaped, the group's ID cannot be reused by another process
+    int running = supervisorPoll(supervisor, 0);
+    if (running > 0 && beehive->group > 0 && killpg(beehive->group, sig) == -1) {
+        logMessage(LOG_WARNING, "[MAIN] Failed to signal the colony's process group: %s", strerror(errno));
+    }
+
+    double deadline = monotonicSeconds() + BEEHIVE_DRAIN_MS / 1000.0;
+    while (running > 0) {
+        int timeoutMs = (int)((deadline - monotonicSeconds()) * 1000) + 1;
+        if (timeoutMs <= 0) break;
+        if (timeoutMs > BEEHIVE_STOP_POLL_MS) timeoutMs = BEEHIVE_STOP_POLL_MS;
+        running = supervisorPoll(supervisor, timeoutMs);
+        drainLog(beehive);
+    }
+    if (running > 0) {
+        // Through the pidfds, so a process that left the group is not missed either
+        logMessage(LOG_WARNING, "[MAIN] %d colony processes still running after %d ms; killing them.", running, BEEHIVE_DRAIN_MS);
+        supervisorSignal(supervisor, SUPERVISED_QUEEN, SIGKILL);
+        supervisorSignal(supervisor, SUPERVISED_BEEKEEPER, SIGKILL);
+        supervisorSignal(supervisor, SUPERVISED_BEE, SIGKILL);
+        while (running > 0) {
+            running = supervisorPoll(supervisor, BEEHIVE_STOP_POLL_MS);
+            drainLog(beehive);
+        }
+    }
+    return running == -1 ? -1 : 0;
+}
+
+/**
+ * release:
+ * Frees whatever part of an instance has been set up; running processes must be gone.
+ */
+static void release(Beehive* beehive) {
+    if (beehive->exporter) {
+        if (beehive->supervisor) supervisorRemoveWakeFd(beehive->supervisor, exporterFd(beehive->exporter));
+        exporterDestroy(beehive->exporter);
+    }
+    if (beehive->apiary.fd != -1) close(beehive->apiary.fd);
+    if (beehive->supervisor) supervisorDestroy(beehive->supervisor);
+    if (beehive->logPipe[0] != -1) {
+        drainLog(beehive);
+        close(beehive->logPipe[0]);
+        close(beehive->logPipe[1]);
+    }
+    if (beehive->table) beeTableDestroy(beehive->table);
+    if (beehive->events) eventBusDestroy(beehive->events);
+    if (beehive->config) configPageDestroy(beehive->config);
+    if (beehive->hive) detachSharedMemory(beehive->hive);
+    if (beehive->semaphores) detachSharedMemory(beehive->semaphores);
+    if (beehive->shmid != -1 && beehive->semid != -1) {
+        cleanupResources(beehive->shmid, beehive->semid);
+    } else if (beehive->shmid != -1) {
+        shmctl(beehive->shmid, IPC_RMID, NULL);
+    }
+    free(beehive);
+}
+
+/**
+ * abandonCreate:
+ * Reports a failure of beehiveCreate and tears down everything started so far.
+ *
+ * @return NULL, for the caller to return.
+ */
+static Beehive* abandonCreate(Beehive* beehive, const LogSink* previous, const char* message) {
+    reportError(beehive, message);
+    int saved = errno;
+    if (beehive->supervisor) {
+        terminate(beehive, SIGKILL);
+    }
+    release(beehive);
+    leave(previous);
+    errno = saved;
+    return NULL;
+}
+
+void beehiveDefaultOptions(BeehiveOptions* options) {
+    memset(options, 0, sizeof(*options));
+    options->maxVisits = MAX_BEE_VISITS;
+    options->T_inHive = T_IN_HIVE;
+    options->apiaryHive = -1;
+    options->apiaryFd = -1;
+}
+
+Beehive* beehiveCreate(const BeehiveOptions* options) {
+    Beehive* beehive = calloc(1, sizeof(Beehive));
+    if (!beehive) {
+        if (options->error) options->error(options->errorUser, "[MAIN] Failed to allocate the colony", errno);
+        return NULL;
+    }
+    beehive->options = *options;
+    beehive->log = options->log;
+    beehive->shmid = -1;
+    beehive->semid = -1;
+    beehive->apiary.fd = -1;
+    beehive->logPipe[0] = beehive->logPipe[1] = -1;
+    if (options->placement) {
+        beehive->placement = *options->placement;
+    } else {
+        placementDefaultConfig(&beehive->placement);
+    }
+    const LogSink* previous = enter(beehive);
+    int N = options->N;
+
+    // Messages of the colony's processes come back through a pipe, so the log function only
+    // ever runs in the calling process
+    if (options->log.log) {
+        if (pipe2(beehive->logPipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+            beehive->logPipe[0] = beehive->logPipe[1] = -1;
+            return abandonCreate(beehive, previous, "[MAIN] Failed to create the log pipe");
+        }
+        fcntl(beehive->logPipe[1], F_SETPIPE_SZ, BEEHIVE_LOG_PIPE_SIZE);
+    }
+    int logFd = beehive->logPipe[1];
+    int capacity = options->capacity;
+
+    // A restored colony brings its own hive size and bees
+    const Checkpoint* checkpoint = NULL;
+    if (options->restorePath) {
+        checkpoint = checkpointMap(options->restorePath);
+        if (!checkpoint) {
+            errno = EINVAL;
+            return abandonCreate(beehive, previous, "[MAIN] Cannot restore the checkpoint");
+        }
+        N = checkpoint->hive.N;
+        if (capacity != 0 && capacity < (int)checkpoint->beeCount) {
+            checkpointUnmap(checkpoint);
+            errno = ENOSPC;
+            return abandonCreate(beehive, previous, "[MAIN] The checkpoint holds more bees than the capacity");
+        }
+        if (capacity == 0 && checkpoint->hive.tableCapacity > N) {
+            capacity = checkpoint->hive.tableCapacity;
+        }
+    }
+
+    // Size the per-bee state table; it bounds the number of bees alive at once
+    if (capacity == 0) {
+        capacity = N > BEE_TABLE_DEFAULT_CAPACITY ? N : BEE_TABLE_DEFAULT_CAPACITY;
+    }
+
+    // The live parameters: defaults, then the options, then the configuration file
+    HiveTunables tunables;
+    configDefaults(&tunables);
+    tunables.T_k = options->T_k;
+    tunables.eggsCount = options->eggsCount;
+    tunables.T_inHive = options->T_inHive;
+    tunables.maxVisits = options->maxVisits;
+    tunables.maxBees = capacity;
+    if (options->configPath) {
+        char reason[512];
+        if (configLoad(options->configPath, &tunables, reason, sizeof(reason)) == -1) {
+            if (checkpoint) checkpointUnmap(checkpoint);
+            logMessage(LOG_ERROR, "[MAIN] %s", reason);
+            errno = EINVAL;
+            return abandonCreate(beehive, previous, "[MAIN] Cannot load the configuration file");
+        }
+    }
+
+    // Without an explicit capacity, the table is sized for the file's maxBees
+    if (options->capacity == 0 && tunables.maxBees > capacity) {
+        capacity = tunables.maxBees;
+    }
+    if (tunables.maxBees > capacity) {
+        logMessage(LOG_WARNING, "[MAIN] maxBees (%d) exceeds the capacity (%d). Setting maxBees to %d.", tunables.maxBees, capacity, capacity);
+        tunables.maxBees = capacity;
+    }
+    const char* invalid = configCheck(&tunables, capacity);
+    if (invalid) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        logMessage(LOG_ERROR, "[MAIN] Invalid colony parameters: %s", invalid);
+        errno = EINVAL;
+        return abandonCreate(beehive, previous, "[MAIN] Invalid colony parameters");
+    }
+    if (N > capacity) {
+        logMessage(LOG_WARNING, "[MAIN] Initial hive size (%d) exceeds the capacity (%d). Setting N to %d.", N, capacity, capacity);
+        N = capacity;
+    }
+    beehive->options.N = N;
+    beehive->options.capacity = capacity;
+
+    PlacementConfig* placement = &beehive->placement;
+    if (placementResolve(placement) == -1) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        errno = EINVAL;
+        return abandonCreate(beehive, previous, "[MAIN] Invalid placement options");
+    }
+
+    // Initialize HiveData and HiveSemaphores using modular functions
+    beehive->hive = initHiveData(N, &beehive->shmid);
+    beehive->semaphores = beehive->hive ? initHiveSemaphores(&beehive->semid) : NULL;
+    if (!beehive->hive || !beehive->semaphores) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the shared hive state");
+    }
+    HiveData* hive = beehive->hive;
+    HiveSemaphores* semaphores = beehive->semaphores;
+    int shmid = beehive->shmid, semid = beehive->semid;
+    hive->tableCapacity = capacity;
+    if (checkpoint) {
+        checkpointRestoreHive(checkpoint, hive);
+    }
+    // Every hive of an apiary numbers its bees from its own range
+    int firstBeeID = options->apiaryHive > 0 ? options->apiaryHive * APIARY_ID_STRIDE : 0;
+    hive->nextBeeID += firstBeeID;
+
+    beehive->table = beeTableCreate((size_t)capacity, options->hugePages);
+    if (!beehive->table) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the per-bee state table");
+    }
+    BeeTable* table = beehive->table;
+    logMessage(LOG_INFO, "[MAIN] Per-bee state table: %s (%d slots, %zu bytes%s)", table->path, capacity,
+               table->mappedBytes, table->hugePages ? ", huge pages" : "");
+
+    beehive->events = eventBusCreate(options->eventCapacity);
+    if (!beehive->events) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the event bus");
+    }
+    EventBus* events = beehive->events;
+    logMessage(LOG_INFO, "[MAIN] Event bus: %s (%llu events)", events->path, (unsigned long long)events->capacity);
+
+    beehive->config = configPageCreate(&tunables, capacity);
+    if (!beehive->config) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the configuration page");
+    }
+    ConfigPage* config = beehive->config;
+    logMessage(LOG_INFO, "[MAIN] Configuration page: %s (T_k %d, eggsCount %d, T_inHive %d, maxVisits %d, outside %d-%d s, transit %d ms, maxBees %d)",
+               config->path, tunables.T_k, tunables.eggsCount, tunables.T_inHive, tunables.maxVisits,
+               tunables.minOutsideTime, tunables.maxOutsideTime, tunables.transitMs, tunables.maxBees);
+
+    // Keep the hive counters and locks on the node their users run on
+    if (placement->memNode >= 0) {
+        if (bindToNode(hive, sizeof(HiveData), placement->memNode) == -1 ||
+            bindToNode(semaphores, sizeof(HiveSemaphores), placement->memNode) == -1 ||
+            bindToNode(table, table->mappedBytes, placement->memNode) == -1 ||
+            bindToNode(config, sizeof(ConfigPage), placement->memNode) == -1) {
+            logMessage(LOG_WARNING, "[MAIN] Failed to bind shared segments to NUMA node %d: %s", placement->memNode, strerror(errno));
+        } else {
+            logMessage(LOG_INFO, "[MAIN] Shared segments bound to NUMA node %d.", placement->memNode);
+        }
+    }
+
+    // The supervisor forks and reaps every bee; the queen requests newborns through a pipe
+    int spawnPipe[2];
+    if (pipe2(spawnPipe, O_CLOEXEC) == -1) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the spawn pipe");
+    }
+
+    // Spawn the queen process before the supervisor exists; it keeps nothing but its end of the pipe
+    pid_t host = getpid();
+    fflush(NULL);
+    pid_t queenPid = fork();
+    if (queenPid == 0) {
+        becomeChild(host, logFd, &spawnPipe[1], 1);
+        if (pinToCpu(placement->queenCpu) == -1) {
+            logMessage(LOG_WARNING, "[Queen] Failed to pin to CPU %d: %s", placement->queenCpu, strerror(errno));
+        }
+        QueenArgs queenArgs = {hive, semaphores, semid, shmid, table, 3, options->targetUtilization, events, config};
+        queenWorker(&queenArgs);
+        exitColonyProcess(EXIT_SUCCESS);
+    } else if (queenPid < 0) {
+        int saved = errno;
+        close(spawnPipe[0]);
+        close(spawnPipe[1]);
+        if (checkpoint) checkpointUnmap(checkpoint);
+        errno = saved;
+        return abandonCreate(beehive, previous, "[MAIN] Failed to fork queen process");
+    }
+    close(spawnPipe[1]);
+    joinGroup(&beehive->group, queenPid);
+
+    beehive->newborns = (BeeSpawnContext){hive, semaphores, semid, shmid, table, placement, logFd, &beehive->group, events, true, false, config};
+    beehive->supervisor = supervisorCreate(hive, semaphores, table, events);
+    if (!beehive->supervisor || supervisorAddSpawnPipe(beehive->supervisor, spawnPipe[0], forkBee, &beehive->newborns) == -1) {
+        int saved = errno;
+        close(spawnPipe[0]);
+        kill(queenPid, SIGKILL);
+        waitpid(queenPid, NULL, 0);
+        if (checkpoint) checkpointUnmap(checkpoint);
+        errno = saved;
+        return abandonCreate(beehive, previous, "[MAIN] Failed to create the process supervisor");
+    }
+    if (startProcess(beehive, queenPid, SUPERVISED_QUEEN) == -1) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to supervise the queen process");
+    }
+
+    // Spawn the beekeeper process
+    fflush(NULL);
+    pid_t beekeeperPid = fork();
+    if (beekeeperPid == 0) {
+        becomeChild(host, logFd, NULL, 0);
+        if (pinToCpu(placement->keeperCpu) == -1) {
+            logMessage(LOG_WARNING, "[Beekeeper] Failed to pin to CPU %d: %s", placement->keeperCpu, strerror(errno));
+        }
+        BeekeeperArgs keeperArgs = {hive, semaphores, semid, shmid, table, events};
+        beekeeperWorker(&keeperArgs);
+        exitColonyProcess(EXIT_SUCCESS);
+    } else if (beekeeperPid < 0) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to fork beekeeper process");
+    }
+    joinGroup(&beehive->group, beekeeperPid);
+    if (startProcess(beehive, beekeeperPid, SUPERVISED_BEEKEEPER) == -1) {
+        if (checkpoint) checkpointUnmap(checkpoint);
+        return abandonCreate(beehive, previous, "[MAIN] Failed to supervise the beekeeper process");
+    }
+    beehive->beekeeperPid = beekeeperPid;
+
+    // Spawn initial bee processes, or resume those of the checkpoint
+    BeeSpawnContext initialBees = beehive->newborns;
+    initialBees.startInHive = false;
+    if (checkpoint) {
+        initialBees.resume = true;
+        for (uint32_t i = 0; i < checkpoint->beeCount; i++) {
+            const CheckpointBee* saved = &checkpoint->bees[i];
+            int slot = checkpointRestoreBee(table, saved);
+            if (slot == -1) {
+                checkpointUnmap(checkpoint);
+                errno = ENOSPC;
+                return abandonCreate(beehive, previous, "[MAIN] The per-bee state table is too small for the checkpoint");
+            }
+            if (startBee(beehive, &initialBees, saved->id, slot) == -1) {
+                checkpointUnmap(checkpoint);
+                return abandonCreate(beehive, previous, "[MAIN] Failed to start bee process");
+            }
+        }
+        logMessage(LOG_INFO, "[MAIN] Restored %u bees from %s (N = %d, %.1f s of colony time).",
+                   checkpoint->beeCount, options->restorePath, N, checkpoint->elapsed);
+        beehive->colonyTime = checkpoint->elapsed;
+        checkpointUnmap(checkpoint);
+    } else {
+        for (int i = firstBeeID; i < firstBeeID + N; i++) {
+            int slot = beeTableAcquire(table, i, BEE_SLOT_OUTSIDE);
+            if (startBee(beehive, &initialBees, i, slot) == -1) {
+                return abandonCreate(beehive, previous, "[MAIN] Failed to start bee process");
+            }
+        }
+    }
+
+    // Immigrants resume from the state they brought along, like restored bees
+    beehive->immigrants = initialBees;
+    beehive->immigrants.resume = true;
+    beehive->arrivals = beehive->newborns;
+    beehive->arrivals.startInHive = false;
+    beehive->apiary = (ApiaryLink){options->apiaryHive, options->apiaryFd, hive, semaphores, table, beehive->supervisor,
+                                   forkBee, &beehive->immigrants, 0.0, config};
+
+    // Scrapes are answered from beehiveStep, straight from the shared counters; a scraper
+    // wakes the supervisor's wait like an exiting bee does
+    if (options->metricsAddress) {
+        beehive->exporter = exporterCreate(options->metricsAddress, hive);
+        if (!beehive->exporter) {
+            logMessage(LOG_WARNING, "[MAIN] Cannot serve metrics on %s: %s", options->metricsAddress, strerror(errno));
+        } else if (supervisorAddWakeFd(beehive->supervisor, exporterFd(beehive->exporter)) == -1) {
+            logMessage(LOG_WARNING, "[MAIN] Scrapes wait for the next sample: %s", strerror(errno));
+        }
+    }
+
+    beehive->start = monotonicSeconds();
+    beehive->nextSample = beehive->start;
+    beehive->stoppedAt = -1.0;
+    beehive->survivalTime = -1.0;
+    beehive->running = true;
+    leave(previous);
+    return beehive;
+}
+
+int beehiveStep(Beehive* beehive, int timeoutMs) {
+    if (!beehive->running) {
+        return 0;
+    }
+    const LogSink* previous = enter(beehive);
+    HiveData* hive = beehive->hive;
+    double now = monotonicSeconds();
+    if (now >= beehive->nextSample) {
+        int occupancy = hive->currentBeesInHive;
+        beehive->samples++;
+        beehive->occupancySum += occupancy;
+        if (occupancy > beehive->maxOccupancy) beehive->maxOccupancy = occupancy;
+        if (beehive->survivalTime < 0 && hive->beesAlive <= 0) beehive->survivalTime = now - beehive->start;
+        // A caller that comes back late gets one sample, not a burst of catch-up samples
+        beehive->nextSample += BEEHIVE_SAMPLE_INTERVAL;
+        if (beehive->nextSample <= now) beehive->nextSample = now + BEEHIVE_SAMPLE_INTERVAL;
+    }
+
+    if (beehive->apiary.fd != -1) {
+        apiaryService(&beehive->apiary, now);
+    }
+    if (beehive->exporter) {
+        exporterService(beehive->exporter);
+    }
+
+    // Wake up in time for the next sample
+    int untilSample = (int)((beehive->nextSample - now) * 1000) + 1;
+    if (untilSample < 0) untilSample = 0;
+    if (timeoutMs < 0 || timeoutMs > untilSample) timeoutMs = untilSample;
+    int running = supervisorPoll(beehive->supervisor, timeoutMs);
+    drainLog(beehive);
+    int result = 1;
+    if (running == -1) {
+        reportError(beehive, "[MAIN] Failed to wait for colony processes");
+        result = -1;
+    } else if (running == 0 && !supervisorExpectsSpawns(beehive->supervisor)) {
+        // No more child processes
+        beehive->running = false;
+        beehive->stoppedAt = monotonicSeconds() - beehive->start;
+        result = 0;
+    } else if (shutdownRequested(beehive->semaphores)) {
+        // The beekeeper was told to stop the simulation; beehiveStop stops the processes
+        logMessage(LOG_INFO, "[MAIN] Shutdown requested. Stopping the colony.");
+        beehive->running = false;
+        beehive->stoppedAt = monotonicSeconds() - beehive->start;
+        result = 0;
+    }
+    leave(previous);
+    return result;
+}
+
+int beehiveCheckpoint(Beehive* beehive, const char* path) {
+    const LogSink* previous = enter(beehive);
+    double elapsed = beehive->colonyTime + monotonicSeconds() - beehive->start;
+    int result = checkpointWrite(path, beehive->hive, beehive->semaphores, beehive->table, elapsed);
+    if (result == -1) {
+        reportError(beehive, "[MAIN] Failed to write checkpoint");
+    }
+    leave(previous);
+    return result;
+}
+
+const char* beehiveParameterName(BeehiveParameter parameter) {
+    return parameter >= 0 && parameter < BEEHIVE_PARAM_COUNT ? PARAMETER_NAMES[parameter] : NULL;
+}
+
+int beehiveSet(Beehive* beehive, BeehiveParameter parameter, int value) {
+    const LogSink* previous = enter(beehive);
+    HiveData* hive = beehive->hive;
+    if (parameter < 0 || parameter >= BEEHIVE_PARAM_COUNT ||
+        (parameter == BEEHIVE_PARAM_N && (value < 1 || value > hive->tableCapacity))) {
+        errno = EINVAL;
+        reportError(beehive, "[MAIN] Invalid value for a colony parameter");
+        leave(previous);
+        return -1;
+    }
+
+    if (parameter == BEEHIVE_PARAM_N) {
+        // A resize goes through the hive lock, like the beekeeper's
+        if (lockHive(beehive->semaphores, hive, beehive->table) == -1) {
+            reportError(beehive, "[MAIN] Failed to lock the hive");
+            leave(previous);
+            return -1;
+        }
+        int previousN = hive->N;
+        hive->N = value;
+        if (framesResize(hive, beehive->semaphores) == -1) {
+            hive->N = previousN;
+            robustUnlock(&beehive->semaphores->hiveSem);
+            reportError(beehive, "[MAIN] Failed to lock the frames");
+            leave(previous);
+            return -1;
+        }
+        hive->resizeEpoch++;
+        eventBusPublish(beehive->events, HIVE_EVENT_RESIZE, -1, 0, value, 0);
+        robustUnlock(&beehive->semaphores->hiveSem);
+    } else {
+        // The other parameters live in the configuration page, which tools may write meanwhile
+        uint64_t written = 0;
+        for (int attempt = 0; attempt < CONFIG_PAGE_READ_ATTEMPTS && written == 0; attempt++) {
+            HiveTunables tunables;
+            uint64_t version;
+            if (!configPageRead(beehive->config, &tunables, &version)) {
+                errno = EBUSY;
+                continue;
+            }
+            configSet(&tunables, PARAMETER_NAMES[parameter], value);
+            const char* invalid = configCheck(&tunables, beehive->config->capacity);
+            if (invalid) {
+                logMessage(LOG_ERROR, "[MAIN] Cannot set %s to %d: %s", PARAMETER_NAMES[parameter], value, invalid);
+                errno = EINVAL;
+                break;
+            }
+            written = configPageWrite(beehive->config, &tunables, version);
+            if (written == 0 && errno != EAGAIN) break;
+        }
+        if (written == 0) {
+            reportError(beehive, "[MAIN] Failed to set a colony parameter");
+            leave(previous);
+            return -1;
+        }
+    }
+    logMessage(LOG_INFO, "[MAIN] Set %s to %d.", PARAMETER_NAMES[parameter], value);
+
+    // Let an adaptive queen plan with the new values right away
+    if (parameter == BEEHIVE_PARAM_N || parameter == BEEHIVE_PARAM_T_K || parameter == BEEHIVE_PARAM_EGGS_COUNT) {
+        sem_post(&beehive->semaphores->queenWake);
+    }
+    leave(previous);
+    return 0;
+}
+
+int beehiveAddBees(Beehive* beehive, int count) {
+    if (count <= 0 || shutdownRequested(beehive->semaphores)) {
+        return 0;
+    }
+    const LogSink* previous = enter(beehive);
+    HiveData* hive = beehive->hive;
+    int* slots = malloc((size_t)count * sizeof(int));
+    if (!slots) {
+        reportError(beehive, "[MAIN] Failed to allocate the new bees");
+        leave(previous);
+        return 0;
+    }
+
+    // The whole burst is counted under one hold of the hive lock
+    if (lockHive(beehive->semaphores, hive, beehive->table) == -1) {
+        reportError(beehive, "[MAIN] Failed to lock the hive");
+        free(slots);
+        leave(previous);
+        return 0;
+    }
+    int room = READ_TUNABLE(beehive->config, maxBees) - hive->beesAlive;
+    if (count > room) {
+        logMessage(LOG_WARNING, "[MAIN] The colony is at its limit of %d bees. Adding %d of %d bees.",
+                   READ_TUNABLE(beehive->config, maxBees), room > 0 ? room : 0, count);
+        count = room > 0 ? room : 0;
+    }
+    int firstID = hive->nextBeeID;
+    int reserved = 0;
+    while (reserved < count && (slots[reserved] = beeTableAcquire(beehive->table, firstID + reserved, BEE_SLOT_OUTSIDE)) != -1) {
+        reserved++;
+    }
+    for (int i = 0; i < reserved; i++) {
+        beeTableSetCohort(beehive->table, slots[i], BEE_COHORT_ADDED);
+        eventBusPublish(beehive->events, HIVE_EVENT_BIRTH, firstID + i, 0, ++hive->beesAlive, HIVE_EVENT_ADDED);
+    }
+    hive->nextBeeID += reserved;
+    robustUnlock(&beehive->semaphores->hiveSem);
+    if (reserved < count) {
+        logMessage(LOG_WARNING, "[MAIN] Bee table is full (capacity: %d). Adding %d of %d bees.", hive->tableCapacity, reserved, count);
+    }
+
+    // The processes are forked outside the hive lock
+    int added = 0;
+    while (added < reserved && startBee(beehive, &beehive->arrivals, firstID + added, slots[added]) == 0) {
+        added++;
+    }
+    if (added < reserved) {
+        reportError(beehive, "[MAIN] Failed to start bee process");
+        if (lockHive(beehive->semaphores, hive, beehive->table) == 0) {
+            for (int i = added; i < reserved; i++) {
+                eventBusPublish(beehive->events, HIVE_EVENT_DEATH, firstID + i, 0, 0, HIVE_EVENT_ABNORMAL);
+                beeTableRelease(beehive->table, slots[i]);
+            }
+            hive->beesAlive -= reserved - added;
+            robustUnlock(&beehive->semaphores->hiveSem);
+        }
+    }
+    free(slots);
+    if (added > 0) {
+        logMessage(LOG_INFO, "[MAIN] Added %d bees outside the hive.", added);
+    }
+    leave(previous);
+    return added;
+}
+
+int beehiveKillBees(Beehive* beehive, double fraction, unsigned int* seed) {
+    if (fraction < 0 || fraction > 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    const LogSink* previous = enter(beehive);
+    BeeTable* table = beehive->table;
+
+    // Bees whose process runs; the ones still being forked are left alone
+    int candidates = 0;
+    for (uint64_t i = 0; i < table->capacity; i++) {
+        const BeeSlot* s = &table->slots[i];
+        if (__atomic_load_n(&s->state, __ATOMIC_ACQUIRE) != BEE_SLOT_FREE && s->pid != 0) candidates++;
+    }
+
+    // Selection sampling picks exactly the requested share, each bee with the same chance
+    int target = (int)(fraction * candidates + 0.5);
+    int killed = 0;
+    int seen = 0;
+    for (uint64_t i = 0; i < table->capacity && killed < target && seen < candidates; i++) {
+        const BeeSlot* s = &table->slots[i];
+        if (__atomic_load_n(&s->state, __ATOMIC_ACQUIRE) == BEE_SLOT_FREE || s->pid == 0) continue;
+        if (rand_r(seed) % (unsigned)(candidates - seen) < (unsigned)(target - killed) &&
+            supervisorKillBee(beehive->supervisor, s->id, (int)i) == 0) {
+            killed++;
+        }
+        seen++;
+    }
+    logMessage(LOG_INFO, "[MAIN] Killed %d of %d bees.", killed, candidates);
+    leave(previous);
+    return killed;
+}
+
+void beehiveQuery(const Beehive* beehive, BeehiveStatus* status) {
+    const HiveData* hive = beehive->hive;
+    memset(status, 0, sizeof(*status));
+    status->occupancy = __atomic_load_n(&hive->currentBeesInHive, __ATOMIC_RELAXED);
+    status->N = __atomic_load_n(&hive->N, __ATOMIC_RELAXED);
+    status->capacity = status->N > 0 ? calculateP(status->N) : 0;
+    status->beesAlive = __atomic_load_n(&hive->beesAlive, __ATOMIC_RELAXED);
+    for (int e = 0; e < 2; e++) {
+        status->queued[e] = __atomic_load_n(&hive->beesWaiting[e], __ATOMIC_RELAXED);
+        status->transits[e] = __atomic_load_n(&hive->transits[e], __ATOMIC_RELAXED);
+    }
+    status->entries = __atomic_load_n(&hive->entries, __ATOMIC_RELAXED);
+    status->rejections = __atomic_load_n(&hive->rejections, __ATOMIC_RELAXED);
+    status->deaths = __atomic_load_n(&hive->deaths, __ATOMIC_RELAXED);
+    status->emigrations = __atomic_load_n(&hive->emigrations, __ATOMIC_RELAXED);
+    status->immigrations = __atomic_load_n(&hive->immigrations, __ATOMIC_RELAXED);
+    status->eggsLaid = __atomic_load_n(&hive->eggsLaid, __ATOMIC_RELAXED);
+    status->eggsSkipped = __atomic_load_n(&hive->eggsSkipped, __ATOMIC_RELAXED);
+    status->lockRecoveries = __atomic_load_n(&beehive->semaphores->ownerDeaths, __ATOMIC_RELAXED);
+    // Bees move under the frame locks, so their traffic is added to the hive lock's
+    for (int node = 0; node < HIVE_MAX_NODES; node++) {
+        status->lockAcquisitions[node] = __atomic_load_n(&hive->lockAcquisitions[node], __ATOMIC_RELAXED);
+    }
+    status->crossNodeHandoffs = __atomic_load_n(&hive->crossNodeHandoffs, __ATOMIC_RELAXED);
+    for (int f = 0; f < HIVE_MAX_FRAMES; f++) {
+        const HiveFrameLock* frameLock = &beehive->semaphores->frameSem[f];
+        for (int node = 0; node < HIVE_MAX_NODES; node++) {
+            status->lockAcquisitions[node] += __atomic_load_n(&frameLock->acquisitions[node], __ATOMIC_RELAXED);
+        }
+        status->crossNodeHandoffs += __atomic_load_n(&frameLock->crossNodeHandoffs, __ATOMIC_RELAXED);
+    }
+    // Folded under the hive lock; a query while bees die may see one of them half-folded
+    memcpy(status->cohorts, hive->cohorts, sizeof(status->cohorts));
+    uint64_t version = 0;
+    configPageRead(beehive->config, &status->tunables, &version);
+    status->configVersion = (unsigned long)version;
+
+    status->elapsed = beehive->stoppedAt >= 0 ? beehive->stoppedAt : monotonicSeconds() - beehive->start;
+    status->meanOccupancy = beehive->samples ? (double)beehive->occupancySum / beehive->samples : 0.0;
+    status->maxOccupancy = beehive->maxOccupancy;
+    status->survivalTime = beehive->survivalTime;
+
+    SupervisorStats exits;
+    supervisorStats(beehive->supervisor, &exits);
+    status->beeExits = exits.beeExits;
+    status->abnormalExits = exits.abnormalExits;
+    status->meanBeeLifetime = exits.beeExits ? exits.beeLifetimeSum / exits.beeExits : 0.0;
+    status->maxBeeLifetime = exits.maxBeeLifetime;
+    status->beekeeperPid = beehive->beekeeperPid;
+    status->running = beehive->running;
+}
+
+const EventBus* beehiveEvents(const Beehive* beehive) {
+    return beehive->events;
+}
+
+int beehiveStop(Beehive* beehive) {
+    const LogSink* previous = enter(beehive);
+    if (beehive->stoppedAt < 0) {
+        beehive->stoppedAt = monotonicSeconds() - beehive->start;
+    }
+    // Leave the apiary first: bees still on their way here are lost with the colony
+    if (beehive->apiary.fd != -1) {
+        close(beehive->apiary.fd);
+        beehive->apiary.fd = -1;
+    }
+    if (beehive->exporter) {
+        supervisorRemoveWakeFd(beehive->supervisor, exporterFd(beehive->exporter));
+        exporterDestroy(beehive->exporter);
+        beehive->exporter = NULL;
+    }
+
+    int result = terminate(beehive, SIGTERM);
+    if (result == -1) {
+        reportError(beehive, "[MAIN] Failed to wait for the colony processes");
+    }
+    beehive->running = false;
+    leave(previous);
+    return result;
+}
+
+void beehiveDestroy(Beehive* beehive) {
+    if (beehive->running || supervisorRunning(beehive->supervisor, SUPERVISED_BEE) > 0) {
+        beehiveStop(beehive);
+    }
+    const LogSink* previous = enter(beehive);
+    release(beehive);
+    leave(previous);
+}
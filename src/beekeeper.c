@@ -2,7 +2,8 @@
 #include <string.h>
 #include <signal.h>
 #include "common.h"
-#include <semaphore.h>
+#include "hivelock.h"
+#include "frames.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/prctl.h>
@@ -45,20 +46,30 @@ void handleSignalAddFrames(int signum) {
     HiveData* hive = getHiveDataAndSemaphores(&semaphores);
     if (hive == NULL) return;
 
-    if (sem_wait(&semaphores->hiveSem) == -1) {
-        handleError("[Beekeeper] sem_wait (hiveSem)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+    if (lockHive(semaphores, hive, gBeekeeperArgs->table) == -1) {
+        handleError("[Beekeeper] lock (hiveSem)", -1, -1);
     }
 
-    if (hive->N * 2 > MAX_BEES) {
-        hive->N = MAX_BEES;
-        logMessage(LOG_WARNING, "[Beekeeper - Signal] Hive size capped at MAXBEES = %d", MAX_BEES);
+    if (hive->N * 2 > hive->tableCapacity) {
+        hive->N = hive->tableCapacity;
+        logMessage(LOG_WARNING, "[Beekeeper - Signal] Hive size capped at table capacity = %d", hive->tableCapacity);
     } else {
         hive->N *= 2;
         logMessage(LOG_INFO, "[Beekeeper - Signal] Added frames. New N = %d", hive->N);
     }
+    if (framesResize(hive, semaphores) == -1) {
+        handleError("[Beekeeper] lock (frameSem)", -1, -1);
+    }
+    hive->resizeEpoch++;
+    eventBusPublish(gBeekeeperArgs->events, HIVE_EVENT_RESIZE, -1, 0, hive->N, 0);
+
+    if (robustUnlock(&semaphores->hiveSem) == -1) {
+        handleError("[Beekeeper] unlock (hiveSem)", -1, -1);
+    }
 
-    if (sem_post(&semaphores->hiveSem) == -1) {
-        handleError("[Beekeeper] sem_post (hiveSem)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+    // Let an adaptive queen react to the new capacity right away
+    if (sem_post(&semaphores->queenWake) == -1) {
+        logMessage(LOG_WARNING, "[Beekeeper] Failed to wake the queen: %s", strerror(errno));
     }
 }
 
@@ -76,45 +87,45 @@ void handleSignalRemoveFrames(int signum) {
     HiveData* hive = getHiveDataAndSemaphores(&semaphores);
     if (hive == NULL) return;
 
-    if (sem_wait(&semaphores->hiveSem) == -1) {
-        handleError("[Beekeeper] sem_wait (hiveSem)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+    if (lockHive(semaphores, hive, gBeekeeperArgs->table) == -1) {
+        handleError("[Beekeeper] lock (hiveSem)", -1, -1);
     }
 
     hive->N /= 2; // Halve the hive size
     logMessage(LOG_INFO, "[Beekeeper - Signal] Removed frames. New N = %d", hive->N);
+    if (framesResize(hive, semaphores) == -1) {
+        handleError("[Beekeeper] lock (frameSem)", -1, -1);
+    }
+    hive->resizeEpoch++;
+    eventBusPublish(gBeekeeperArgs->events, HIVE_EVENT_RESIZE, -1, 0, hive->N, 0);
+
+    if (robustUnlock(&semaphores->hiveSem) == -1) {
+        handleError("[Beekeeper] unlock (hiveSem)", -1, -1);
+    }
 
-    if (sem_post(&semaphores->hiveSem) == -1) {
-        handleError("[Beekeeper] sem_post (hiveSem)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+    // Let an adaptive queen react to the new capacity right away
+    if (sem_post(&semaphores->queenWake) == -1) {
+        logMessage(LOG_WARNING, "[Beekeeper] Failed to wake the queen: %s", strerror(errno));
     }
 }
 
 /**
- * Cleanup function to release resources and terminate the beekeeper process.
- * Triggered by SIGINT (e.g., Ctrl+C).
- * Includes error handling for resource cleanup operations.
+ * Signal handler to stop the simulation.
+ * Flags the colony as shutting down when SIGINT (e.g., Ctrl+C) is received. The main process
+ * then stops every process and removes the shared segments once they are all gone, so none
+ * is removed while a bee may still use it.
  *
  * @param signum Signal number (unused).
  */
-void cleanup(int signum) {
+void handleSignalShutdown(int signum) {
     (void)signum; // Unused parameter
 
     HiveSemaphores* semaphores;
     HiveData* hive = getHiveDataAndSemaphores(&semaphores);
     if (hive == NULL) return;
 
-    // Attempt to release shared memory and semaphores; log warnings on failure
-    if (shmctl(gBeekeeperArgs->shmid, IPC_RMID, NULL) == -1) {
-        logMessage(LOG_WARNING, "[Beekeeper] Failed to remove shared memory for HiveData.");
-    }
-
-    if (shmctl(gBeekeeperArgs->semid, IPC_RMID, NULL) == -1) {
-        logMessage(LOG_WARNING, "[Beekeeper] Failed to remove shared memory for semaphores.");
-    }
-
-    detachSharedMemory(semaphores);
-    detachSharedMemory(hive);
-    logMessage(LOG_INFO, "[Beekeeper] Cleanup complete. Exiting process.");
-    exit(EXIT_SUCCESS);
+    requestShutdown(semaphores);
+    logMessage(LOG_INFO, "[Beekeeper - Signal] Shutdown requested.");
 }
 
 /**
@@ -126,7 +137,7 @@ void cleanup(int signum) {
  * 1. Attaches to shared memory for hive data and semaphores.
  * 2. Sets up signal handlers for dynamic hive management (SIGUSR1, SIGUSR2, SIGINT).
  * 3. Waits in an infinite loop to handle incoming signals.
- * 4. Cleans up shared resources upon termination.
+ * 4. Exits once the colony shuts down.
  *
  * @param arg Pointer to BeekeeperArgs containing shared memory and semaphore details.
  */
@@ -138,36 +149,36 @@ void beekeeperWorker(BeekeeperArgs* arg) {
     gBeekeeperArgs->hive = (HiveData*)attachSharedMemory(gBeekeeperArgs->shmid);
     gBeekeeperArgs->semaphores = (HiveSemaphores*)attachSharedMemory(gBeekeeperArgs->semid);
     if (gBeekeeperArgs->hive == NULL || gBeekeeperArgs->semaphores == NULL) {
-        handleError("[Beekeeper] attachSharedMemory", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+        handleError("[Beekeeper] attachSharedMemory", -1, -1);
     }
 
     // Register signal handlers
     struct sigaction sa1 = {0};
     sa1.sa_handler = handleSignalAddFrames;
     if (sigaction(SIGUSR1, &sa1, NULL) == -1) {
-        handleError("[Beekeeper] sigaction(SIGUSR1)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+        handleError("[Beekeeper] sigaction(SIGUSR1)", -1, -1);
     }
 
     struct sigaction sa2 = {0};
     sa2.sa_handler = handleSignalRemoveFrames;
     if (sigaction(SIGUSR2, &sa2, NULL) == -1) {
-        handleError("[Beekeeper] sigaction(SIGUSR2)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+        handleError("[Beekeeper] sigaction(SIGUSR2)", -1, -1);
     }
 
     struct sigaction sa3 = {0};
-    sa3.sa_handler = cleanup;
+    sa3.sa_handler = handleSignalShutdown;
     if (sigaction(SIGINT, &sa3, NULL) == -1) {
-        handleError("[Beekeeper] sigaction(SIGINT)", gBeekeeperArgs->shmid, gBeekeeperArgs->semid);
+        handleError("[Beekeeper] sigaction(SIGINT)", -1, -1);
     }
 
     logMessage(LOG_INFO, "[Beekeeper] Process started and waiting for signals.");
 
-    // Infinite loop to keep the beekeeper process running
-    while (1) {
+    // Keep the beekeeper process running until the colony shuts down
+    while (!shutdownRequested(gBeekeeperArgs->semaphores)) {
         sleep(1); // Sleep to reduce CPU usage
     }
 
     detachSharedMemory(gBeekeeperArgs->hive);
     detachSharedMemory(gBeekeeperArgs->semaphores);
-    exit(EXIT_SUCCESS);
+    exitColonyProcess(EXIT_SUCCESS);
 }
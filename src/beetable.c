@@ -0,0 +1,304 @@
+#include "beetable.h"
+#include <sys/mman.h>
+
+/**
+ * Size of the huge pages used when the table is placed on hugetlbfs.
+ */
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+/**
+ * findHugetlbfs:
+ * Looks up the mount point of a hugetlbfs file system in /proc/mounts.
+ *
+ * @param mountPoint Receives the mount point.
+ * @param size Capacity of mountPoint.
+ * @return true if a hugetlbfs mount was found.
+ */
+static bool findHugetlbfs(char* mountPoint, size_t size) {
+    FILE* mounts = fopen("/proc/mounts", "r");
+    if (!mounts) return false;
+
+    char device[256], dir[256], type[64];
+    bool found = false;
+    while (fscanf(mounts, "%255s %255s %63s %*[^\n]", device, dir, type) == 3) {
+        if (strcmp(type, "hugetlbfs") == 0) {
+            snprintf(mountPoint, size, "%s", dir);
+            found = true;
+            break;
+        }
+    }
+    fclose(mounts);
+    return found;
+}
+
+/**
+ * mapTable:
+ * Sizes and maps the backing object of a new table.
+ *
+ * @param fd Descriptor of the shared memory object or hugetlbfs file.
+ * @param bytes Size of the mapping.
+ * @return The mapping, or NULL on failure.
+ */
+static BeeTable* mapTable(int fd, size_t bytes) {
+    if (ftruncate(fd, (off_t)bytes) == -1) {
+        return NULL;
+    }
+    void* table = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return table == MAP_FAILED ? NULL : table;
+}
+
+/**
+ * Names a new table: the first one of a process is beehive_bees_<pid>, later ones (other
+ * colonies embedded in the same process) get a sequence number appended.
+ */
+static void tableName(char* path, size_t size, const char* directory) {
+    static unsigned int created = 0;
+    unsigned int sequence = __atomic_fetch_add(&created, 1, __ATOMIC_RELAXED);
+    if (sequence == 0) {
+        snprintf(path, size, "%s/beehive_bees_%d", directory, (int)getpid());
+    } else {
+        snprintf(path, size, "%s/beehive_bees_%d_%u", directory, (int)getpid(), sequence);
+    }
+}
+
+BeeTable* beeTableCreate(size_t capacity, bool hugePages) {
+    if (capacity == 0 || capacity > UINT32_MAX - 1) {
+        logMessage(LOG_ERROR, "[BeeTable] Invalid capacity %zu.", capacity);
+        return NULL;
+    }
+
+    size_t bytes = sizeof(BeeTable) + capacity * sizeof(BeeSlot);
+    BeeTable* table = NULL;
+    char path[128];
+
+    if (hugePages) {
+        char mountPoint[96];
+        if (findHugetlbfs(mountPoint, sizeof(mountPoint))) {
+            size_t hugeBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            tableName(path, sizeof(path), mountPoint);
+            int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd != -1) {
+                table = mapTable(fd, hugeBytes);
+                close(fd);
+                if (table) {
+                    bytes = hugeBytes;
+                } else {
+                    unlink(path);
+                }
+            }
+        }
+        if (!table) {
+            logMessage(LOG_WARNING, "[BeeTable] No usable hugetlbfs mount; using transparent huge pages instead.");
+        }
+    }
+
+    if (!table) {
+        hugePages = false;
+        tableName(path, sizeof(path), "");
+        int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd == -1) {
+            logMessage(LOG_ERROR, "[BeeTable] shm_open(%s) failed: %s", path, strerror(errno));
+            return NULL;
+        }
+        table = mapTable(fd, bytes);
+        close(fd);
+        if (!table) {
+            logMessage(LOG_ERROR, "[BeeTable] Failed to map %zu bytes: %s", bytes, strerror(errno));
+            shm_unlink(path);
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        madvise(table, bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    // Fresh objects are zero-filled: every slot is BEE_SLOT_FREE; chain them into the free list
+    table->capacity = capacity;
+    table->mappedBytes = bytes;
+    table->hugePages = hugePages;
+    snprintf(table->path, sizeof(table->path), "%s", path);
+    for (size_t i = 0; i < capacity; i++) {
+        table->slots[i].next = (i + 1 < capacity) ? (uint32_t)(i + 2) : 0;
+    }
+    table->freeHead = 1;
+    return table;
+}
+
+const BeeTable* beeTableAttach(const char* path) {
+    bool onHugetlbfs = path[0] == '/' && strchr(path + 1, '/') != NULL;
+    int fd = onHugetlbfs ? open(path, O_RDONLY) : shm_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(BeeTable)) {
+        close(fd);
+        return NULL;
+    }
+    void* table = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return table == MAP_FAILED ? NULL : table;
+}
+
+void beeTableDetach(const BeeTable* table) {
+    munmap((void*)table, table->mappedBytes);
+}
+
+void beeTableDestroy(BeeTable* table) {
+    char path[sizeof(table->path)];
+    bool hugePages = table->hugePages;
+    snprintf(path, sizeof(path), "%s", table->path);
+
+    munmap(table, table->mappedBytes);
+    if ((hugePages ? unlink(path) : shm_unlink(path)) == -1 && errno != ENOENT) {
+        logMessage(LOG_WARNING, "[BeeTable] Failed to remove %s: %s", path, strerror(errno));
+    }
+}
+
+int beeTableAcquire(BeeTable* table, int id, BeeSlotState state) {
+    uint64_t head = __atomic_load_n(&table->freeHead, __ATOMIC_ACQUIRE);
+    uint32_t index;
+    do {
+        index = (uint32_t)head;
+        if (index == 0) {
+            return -1;
+        }
+        uint64_t next = __atomic_load_n(&table->slots[index - 1].next, __ATOMIC_RELAXED);
+        // The tag in the upper half changes on every pop, which defeats ABA
+        uint64_t replacement = ((head >> 32) + 1) << 32 | next;
+        if (__atomic_compare_exchange_n(&table->freeHead, &head, replacement, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    } while (1);
+
+    int slot = (int)index - 1;
+    BeeSlot* s = &table->slots[slot];
+    int64_t now = clockNanos(CLOCK_REALTIME);
+    s->id = id;
+    s->visits = 0;
+    s->entrance = 0;
+    s->pid = 0;
+    s->seed = 0;
+    s->flags = 0;
+    s->frame = (uint16_t)(id % HIVE_MAX_FRAMES); // Spreads the bees over the frames they return to
+    s->wakeAt = 0;
+    s->queueMs = 0;
+    s->insideMs = 0;
+    s->outsideMs = 0;
+    s->rejections = 0;
+    s->cohort = BEE_COHORT_INITIAL;
+    s->bornAt = now;
+    s->changedAt = now;
+    __atomic_store_n(&s->state, (uint8_t)state, __ATOMIC_RELEASE);
+
+    int used = __atomic_add_fetch(&table->used, 1, __ATOMIC_RELAXED);
+    int high = __atomic_load_n(&table->highWater, __ATOMIC_RELAXED);
+    while (used > high && !__atomic_compare_exchange_n(&table->highWater, &high, used, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return slot;
+}
+
+void beeTableRelease(BeeTable* table, int slot) {
+    BeeSlot* s = &table->slots[slot];
+    __atomic_store_n(&s->state, (uint8_t)BEE_SLOT_FREE, __ATOMIC_RELEASE);
+    __atomic_store_n(&s->changedAt, clockNanos(CLOCK_REALTIME), __ATOMIC_RELAXED);
+
+    uint64_t head = __atomic_load_n(&table->freeHead, __ATOMIC_ACQUIRE);
+    uint64_t replacement;
+    do {
+        __atomic_store_n(&s->next, (uint32_t)head, __ATOMIC_RELAXED);
+        replacement = ((head >> 32) + 1) << 32 | (uint32_t)(slot + 1);
+    } while (!__atomic_compare_exchange_n(&table->freeHead, &head, replacement, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    __atomic_sub_fetch(&table->used, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * stateTime:
+ * Returns the accumulator of the time spent in a lifecycle state, or NULL for a free slot.
+ */
+static uint32_t* stateTime(BeeSlot* s, uint8_t state) {
+    switch (state) {
+        case BEE_SLOT_OUTSIDE: return &s->outsideMs;
+        case BEE_SLOT_INSIDE: return &s->insideMs;
+        case BEE_SLOT_QUEUED_IN:
+        case BEE_SLOT_QUEUED_OUT: return &s->queueMs;
+        default: return NULL;
+    }
+}
+
+/**
+ * Converts a duration in nanoseconds to whole milliseconds (rounded, never negative).
+ */
+static uint32_t toMillis(int64_t ns) {
+    return ns > 0 ? (uint32_t)((ns + 500000) / 1000000) : 0;
+}
+
+void beeTableUpdate(BeeTable* table, int slot, BeeSlotState state, int visits, int entrance) {
+    BeeSlot* s = &table->slots[slot];
+    int64_t now = clockNanos(CLOCK_REALTIME);
+    // Only the owner writes the slot: the previous state and its start are its own
+    uint32_t* spent = stateTime(s, s->state);
+    if (spent) {
+        __atomic_store_n(spent, *spent + toMillis(now - s->changedAt), __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->visits, (uint16_t)visits, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->entrance, (uint8_t)entrance, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->changedAt, now, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->wakeAt, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->state, (uint8_t)state, __ATOMIC_RELEASE);
+}
+
+void beeTableSetPause(BeeTable* table, int slot, int64_t wakeAt, uint32_t seed) {
+    BeeSlot* s = &table->slots[slot];
+    __atomic_store_n(&s->seed, seed, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->wakeAt, wakeAt, __ATOMIC_RELEASE);
+}
+
+void beeTableSetFlags(BeeTable* table, int slot, uint32_t flags) {
+    __atomic_store_n(&table->slots[slot].flags, (uint16_t)flags, __ATOMIC_RELAXED);
+}
+
+void beeTableSetCohort(BeeTable* table, int slot, BeeCohort cohort) {
+    __atomic_store_n(&table->slots[slot].cohort, (uint8_t)cohort, __ATOMIC_RELAXED);
+}
+
+void beeTableCountRejection(BeeTable* table, int slot) {
+    BeeSlot* s = &table->slots[slot];
+    if (s->rejections < UINT16_MAX) {
+        __atomic_store_n(&s->rejections, (uint16_t)(s->rejections + 1), __ATOMIC_RELAXED);
+    }
+}
+
+void beeTableSetHistory(BeeTable* table, int slot, const BeeTimes* times, int rejections) {
+    BeeSlot* s = &table->slots[slot];
+    __atomic_store_n(&s->queueMs, times->queueMs, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->insideMs, times->insideMs, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->outsideMs, times->outsideMs, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->rejections, (uint16_t)(rejections < UINT16_MAX ? rejections : UINT16_MAX), __ATOMIC_RELAXED);
+}
+
+void beeTableTimes(const BeeSlot* slot, BeeTimes* times) {
+    times->queueMs = __atomic_load_n(&slot->queueMs, __ATOMIC_RELAXED);
+    times->insideMs = __atomic_load_n(&slot->insideMs, __ATOMIC_RELAXED);
+    times->outsideMs = __atomic_load_n(&slot->outsideMs, __ATOMIC_RELAXED);
+
+    uint32_t current = toMillis(clockNanos(CLOCK_REALTIME) - __atomic_load_n(&slot->changedAt, __ATOMIC_RELAXED));
+    switch (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE)) {
+        case BEE_SLOT_OUTSIDE: times->outsideMs += current; break;
+        case BEE_SLOT_INSIDE: times->insideMs += current; break;
+        case BEE_SLOT_QUEUED_IN:
+        case BEE_SLOT_QUEUED_OUT: times->queueMs += current; break;
+        default: break;
+    }
+}
+
+void beeTableSetFrame(BeeTable* table, int slot, int frame) {
+    __atomic_store_n(&table->slots[slot].frame, (uint16_t)frame, __ATOMIC_RELAXED);
+}
+
+void beeTableSetPid(BeeTable* table, int slot, pid_t pid) {
+    __atomic_store_n(&table->slots[slot].pid, pid, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,189 @@
+#include "checkpoint.h"
+#include "hivelock.h"
+#include <sys/mman.h>
+
+/**
+ * Returns the size of a checkpoint holding a number of bees.
+ */
+static size_t checkpointSize(uint32_t beeCount) {
+    return sizeof(Checkpoint) + (size_t)beeCount * sizeof(CheckpointBee);
+}
+
+/**
+ * writeFully:
+ * Writes a buffer to a descriptor, continuing after short writes.
+ *
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+static int writeFully(int fd, const void* buffer, size_t length) {
+    const char* p = buffer;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+int checkpointWrite(const char* path, HiveData* hive, HiveSemaphores* semaphores, BeeTable* table, double elapsed) {
+    // HiveData keeps its frames on cache lines of their own
+    size_t bytes = checkpointSize((uint32_t)table->capacity);
+    Checkpoint* checkpoint = aligned_alloc(_Alignof(Checkpoint), (bytes + _Alignof(Checkpoint) - 1) & ~(_Alignof(Checkpoint) - 1));
+    if (!checkpoint) {
+        return -1;
+    }
+    memset(checkpoint, 0, bytes);
+    memcpy(checkpoint->magic, CHECKPOINT_MAGIC, sizeof(checkpoint->magic));
+    checkpoint->version = CHECKPOINT_VERSION;
+    checkpoint->hiveSize = sizeof(HiveData);
+    checkpoint->beeSize = sizeof(CheckpointBee);
+    checkpoint->elapsed = elapsed;
+
+    // Quiesce: no bee, queen or beekeeper changes state while the hive lock is held
+    if (lockHive(semaphores, hive, table) == -1) {
+        int saved = errno;
+        free(checkpoint);
+        errno = saved;
+        return -1;
+    }
+    if (lockAllFrames(semaphores) == -1) {
+        int saved = errno;
+        robustUnlock(&semaphores->hiveSem);
+        free(checkpoint);
+        errno = saved;
+        return -1;
+    }
+    double pauseStart = clockNanos(CLOCK_MONOTONIC) / 1e9;
+    checkpoint->takenAt = clockNanos(CLOCK_REALTIME);
+    checkpoint->hive = *hive;
+    int64_t now = clockNanos(CLOCK_MONOTONIC);
+    uint32_t count = 0;
+    for (uint64_t i = 0; i < table->capacity; i++) {
+        const BeeSlot* s = &table->slots[i];
+        uint8_t state = __atomic_load_n(&s->state, __ATOMIC_ACQUIRE);
+        if (state == BEE_SLOT_FREE) continue;
+
+        // Pauses start outside the lock; the release store of wakeAt publishes the matching seed
+        int64_t wakeAt = __atomic_load_n(&s->wakeAt, __ATOMIC_ACQUIRE);
+        CheckpointBee* bee = &checkpoint->bees[count++];
+        bee->id = s->id;
+        bee->state = state;
+        bee->entrance = s->entrance;
+        bee->visits = s->visits;
+        bee->seed = __atomic_load_n(&s->seed, __ATOMIC_RELAXED);
+        bee->flags = __atomic_load_n(&s->flags, __ATOMIC_RELAXED);
+        bee->frame = __atomic_load_n(&s->frame, __ATOMIC_RELAXED);
+        bee->remainingNs = wakeAt == 0 ? -1 : (wakeAt > now ? wakeAt - now : 0);
+        BeeTimes times;
+        beeTableTimes(s, &times);
+        bee->queueMs = times.queueMs;
+        bee->insideMs = times.insideMs;
+        bee->outsideMs = times.outsideMs;
+        bee->rejections = __atomic_load_n(&s->rejections, __ATOMIC_RELAXED);
+        bee->cohort = __atomic_load_n(&s->cohort, __ATOMIC_RELAXED);
+    }
+    checkpoint->beeCount = count;
+    double paused = clockNanos(CLOCK_MONOTONIC) / 1e9 - pauseStart;
+    unlockAllFrames(semaphores);
+    if (robustUnlock(&semaphores->hiveSem) == -1) {
+        int saved = errno;
+        free(checkpoint);
+        errno = saved;
+        return -1;
+    }
+
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    int fd = open(tmpPath, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd == -1) {
+        int saved = errno;
+        free(checkpoint);
+        errno = saved;
+        return -1;
+    }
+    int result = writeFully(fd, checkpoint, checkpointSize(count));
+    int saved = errno;
+    if (close(fd) == -1 && result == 0) {
+        result = -1;
+        saved = errno;
+    }
+    if (result == 0 && rename(tmpPath, path) == -1) {
+        result = -1;
+        saved = errno;
+    }
+    if (result == -1) {
+        unlink(tmpPath);
+    } else {
+        logMessage(LOG_INFO, "[Checkpoint] Wrote %u bees to %s (colony paused for %.2f ms).", count, path, paused * 1000);
+    }
+    free(checkpoint);
+    errno = saved;
+    return result;
+}
+
+const Checkpoint* checkpointMap(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        logMessage(LOG_ERROR, "[Checkpoint] Cannot open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(Checkpoint)) {
+        logMessage(LOG_ERROR, "[Checkpoint] %s is too short to be a checkpoint.", path);
+        close(fd);
+        return NULL;
+    }
+    const Checkpoint* checkpoint = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (checkpoint == MAP_FAILED) {
+        logMessage(LOG_ERROR, "[Checkpoint] Cannot map %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    if (memcmp(checkpoint->magic, CHECKPOINT_MAGIC, sizeof(checkpoint->magic)) != 0 ||
+        checkpoint->version != CHECKPOINT_VERSION || checkpoint->hiveSize != sizeof(HiveData) ||
+        checkpoint->beeSize != sizeof(CheckpointBee) || checkpointSize(checkpoint->beeCount) != (size_t)st.st_size) {
+        logMessage(LOG_ERROR, "[Checkpoint] %s is not a checkpoint of this version.", path);
+        munmap((void*)checkpoint, (size_t)st.st_size);
+        return NULL;
+    }
+    return checkpoint;
+}
+
+void checkpointUnmap(const Checkpoint* checkpoint) {
+    munmap((void*)checkpoint, checkpointSize(checkpoint->beeCount));
+}
+
+void checkpointRestoreHive(const Checkpoint* checkpoint, HiveData* hive) {
+    const HiveData* saved = &checkpoint->hive;
+    hive->N = saved->N;
+    hive->currentBeesInHive = saved->currentBeesInHive;
+    hive->beesAlive = saved->beesAlive;
+    hive->beesWaiting[0] = saved->beesWaiting[0];
+    hive->beesWaiting[1] = saved->beesWaiting[1];
+    hive->resizeEpoch = saved->resizeEpoch;
+    hive->nextBeeID = saved->nextBeeID;
+    hive->frameCount = saved->frameCount;
+    memcpy(hive->frames, saved->frames, sizeof(hive->frames));
+    memcpy(hive->cohorts, saved->cohorts, sizeof(hive->cohorts));
+}
+
+int checkpointRestoreBee(BeeTable* table, const CheckpointBee* bee) {
+    int slot = beeTableAcquire(table, bee->id, (BeeSlotState)bee->state);
+    if (slot == -1) {
+        return -1;
+    }
+    beeTableUpdate(table, slot, (BeeSlotState)bee->state, bee->visits, bee->entrance);
+    beeTableSetFlags(table, slot, bee->flags);
+    beeTableSetFrame(table, slot, bee->frame % HIVE_MAX_FRAMES);
+    BeeTimes times = {bee->queueMs, bee->insideMs, bee->outsideMs};
+    beeTableSetHistory(table, slot, &times, bee->rejections);
+    beeTableSetCohort(table, slot, bee->cohort < BEE_COHORTS ? (BeeCohort)bee->cohort : BEE_COHORT_INITIAL);
+    int64_t wakeAt = bee->remainingNs < 0 ? 0 : clockNanos(CLOCK_MONOTONIC) + bee->remainingNs;
+    beeTableSetPause(table, slot, wakeAt, bee->seed);
+    return slot;
+}
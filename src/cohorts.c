@@ -0,0 +1,54 @@
+#include "cohorts.h"
+#include <math.h>
+
+/**
+ * runningStatAdd:
+ * Adds a sample to a statistic holding `count` samples already (Welford's update).
+ */
+static void runningStatAdd(RunningStat* stat, long count, double value) {
+    if (count == 0) {
+        stat->min = value;
+        stat->max = value;
+    } else {
+        if (value < stat->min) stat->min = value;
+        if (value > stat->max) stat->max = value;
+    }
+    double delta = value - stat->mean;
+    stat->mean += delta / (count + 1);
+    stat->m2 += delta * (value - stat->mean);
+}
+
+void cohortRecord(HiveData* hive, const BeeSlot* slot, bool abnormal) {
+    int cohort = slot->cohort < BEE_COHORTS ? slot->cohort : BEE_COHORT_INITIAL;
+    CohortStats* stats = &hive->cohorts[cohort];
+
+    BeeTimes times;
+    beeTableTimes(slot, &times);
+    // The times of a bee that migrated go back to its birth in another hive, so bornAt alone would not do
+    double queued = times.queueMs / 1000.0;
+    double inside = times.insideMs / 1000.0;
+    double outside = times.outsideMs / 1000.0;
+
+    long count = stats->deaths;
+    runningStatAdd(&stats->visits, count, slot->visits);
+    runningStatAdd(&stats->rejections, count, slot->rejections);
+    runningStatAdd(&stats->queueTime, count, queued);
+    runningStatAdd(&stats->insideTime, count, inside);
+    runningStatAdd(&stats->outsideTime, count, outside);
+    runningStatAdd(&stats->lifetime, count, queued + inside + outside);
+    stats->deaths = count + 1;
+    if (abnormal) stats->abnormal++;
+}
+
+double runningStatStddev(const RunningStat* stat, long count) {
+    return count > 1 ? sqrt(stat->m2 / count) : 0.0;
+}
+
+const char* cohortName(int cohort) {
+    switch (cohort) {
+        case BEE_COHORT_INITIAL: return "initial";
+        case BEE_COHORT_QUEEN: return "queen";
+        case BEE_COHORT_ADDED: return "added";
+        default: return "unknown";
+    }
+}
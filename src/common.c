@@ -1,33 +1,70 @@
 #include "common.h"
-
-// Global shared memory identifiers, initialized to invalid values (-1)
-int shmid = -1;  ///< Shared memory identifier for HiveData.
-int semid = -1;  ///< Shared memory identifier for HiveSemaphores.
+#include "hivelock.h"
+#include "logfile.h"
+#include "frames.h"
 
 // Default logging configuration
 LogConfig logConfig = {
     .logToConsole = true,    ///< Enable logging to the console.
     .logToFile = true,       ///< Enable logging to a file.
     .consoleLogLevel = LOG_DEBUG, ///< Log all levels to the console.
-    .fileLogLevel = LOG_DEBUG     ///< Log all levels to the file.
+    .fileLogLevel = LOG_DEBUG,    ///< Log all levels to the file.
+    .filePath = "beehive.log",    ///< Log file in the working directory.
+    .segmentSize = 0,             ///< Never rotate.
+    .keepSegments = 0             ///< Keep every segment.
 };
 
+// Log destination of the calling thread; NULL logs according to logConfig
+static __thread const LogSink* logSink = NULL;
+
+const LogSink* setLogSink(const LogSink* sink) {
+    const LogSink* previous = logSink;
+    logSink = sink;
+    return previous;
+}
+
 
 
 HiveData* initHiveData(int N, int* shmid) {
     *shmid = shmget(IPC_PRIVATE, sizeof(HiveData), IPC_CREAT | 0666);
     if (*shmid == -1) {
-        handleError("[INIT] Failed to create shared memory for HiveData", -1, -1);
+        logMessage(LOG_ERROR, "[INIT] Failed to create shared memory for HiveData: %s", strerror(errno));
+        return NULL;
     }
 
-    HiveData* hive = (HiveData*)attachSharedMemory(*shmid);
-    if (hive == NULL) {
-        handleError("[INIT] Failed to attach shared memory for HiveData", *shmid, -1);
+    HiveData* hive = (HiveData*)shmat(*shmid, NULL, 0);
+    if (hive == (void*)-1) {
+        int saved = errno;
+        logMessage(LOG_ERROR, "[INIT] Failed to attach shared memory for HiveData: %s", strerror(saved));
+        shmctl(*shmid, IPC_RMID, NULL);
+        *shmid = -1;
+        errno = saved;
+        return NULL;
     }
 
     hive->currentBeesInHive = 0;
     hive->N = N;
     hive->beesAlive = N;
+    hive->beesWaiting[0] = 0;
+    hive->beesWaiting[1] = 0;
+    hive->entries = 0;
+    hive->rejections = 0;
+    hive->tableCapacity = MAX_BEES;
+    memset(hive->lockAcquisitions, 0, sizeof(hive->lockAcquisitions));
+    hive->crossNodeHandoffs = 0;
+    hive->lastLockNode = -1;
+    hive->deaths = 0;
+    hive->resizeEpoch = 0;
+    hive->nextBeeID = N; // The initial bees take IDs 0..N-1
+    hive->emigrations = 0;
+    hive->immigrations = 0;
+    hive->eggsLaid = 0;
+    hive->eggsSkipped = 0;
+    hive->transits[0] = 0;
+    hive->transits[1] = 0;
+    memset(hive->cohorts, 0, sizeof(hive->cohorts));
+    memset(hive->frames, 0, sizeof(hive->frames));
+    framesLayout(hive);
     return hive;
 }
 
@@ -47,6 +84,16 @@ int calculateP(int N) {
     return (N / 2) - 1;
 }
 
+int64_t clockNanos(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+double monotonicSeconds(void) {
+    return clockNanos(CLOCK_MONOTONIC) / 1e9;
+}
+
 /**
  * logMessage:
  * Logs a formatted message to the console and/or file, depending on the global log configuration.
@@ -56,6 +103,13 @@ int calculateP(int N) {
  * @param format The formatted string, followed by optional arguments.
  */
 void logMessage(LogLevel level, const char* format, ...) {
+    // Nothing is formatted for a message that no destination takes
+    if (!(logSink && logSink->log) &&
+        !(logConfig.logToConsole && level >= logConfig.consoleLogLevel) &&
+        !(logConfig.logToFile && level >= logConfig.fileLogLevel)) {
+        return;
+    }
+
     va_list args;
     va_start(args, format);
 
@@ -88,6 +142,13 @@ void logMessage(LogLevel level, const char* format, ...) {
     char buffer[1024];
     vsnprintf(buffer, sizeof(buffer), format, args);
 
+    // An embedded colony logs to its own sink
+    if (logSink && logSink->log) {
+        logSink->log(logSink->user, level, buffer);
+        va_end(args);
+        return;
+    }
+
     // Log to console if enabled and level meets the threshold
     if (logConfig.logToConsole && level >= logConfig.consoleLogLevel) {
         printf("%s[%s] %s%s\n", color, levelStr, buffer, RESET);
@@ -95,25 +156,24 @@ void logMessage(LogLevel level, const char* format, ...) {
 
     // Log to file if enabled and level meets the threshold
     if (logConfig.logToFile && level >= logConfig.fileLogLevel) {
-        FILE* logFile = fopen("beehive.log", "a");
-        if (!logFile) {
-            // If the log file cannot be opened, print an error to stderr
-            perror("[logMessage] Failed to open log file");
+        // Get the current time and format the timestamp
+        char line[1200];
+        int length;
+        time_t now = time(NULL);
+        struct tm t;
+        if (localtime_r(&now, &t)) {
+            length = snprintf(line, sizeof(line), "[%02d-%02d-%04d %02d:%02d:%02d] [%s] %s\n",
+                              t.tm_mday, t.tm_mon + 1, t.tm_year + 1900,
+                              t.tm_hour, t.tm_min, t.tm_sec, levelStr, buffer);
         } else {
-            // Get the current time and format the timestamp
-            time_t now = time(NULL);
-            struct tm* t = localtime(&now);
-            if (t) {
-                // Write the log message with a timestamp
-                fprintf(logFile, "[%02d-%02d-%04d %02d:%02d:%02d] [%s] %s\n",
-                        t->tm_mday, t->tm_mon + 1, t->tm_year + 1900,
-                        t->tm_hour, t->tm_min, t->tm_sec, levelStr, buffer);
-            } else {
-                // If time retrieval fails, log without a timestamp
-                fprintf(logFile, "[Time unavailable] [%s] %s\n", levelStr, buffer);
-            }
-            fclose(logFile); // Close the log file
+            // If time retrieval fails, log without a timestamp
+            length = snprintf(line, sizeof(line), "[Time unavailable] [%s] %s\n", levelStr, buffer);
+        }
+        if (length >= (int)sizeof(line)) {
+            length = (int)sizeof(line) - 1;
+            line[length - 1] = '\n';
         }
+        logFileWrite(line, (size_t)length);
     }
 
     va_end(args);
@@ -122,7 +182,7 @@ void logMessage(LogLevel level, const char* format, ...) {
 /**
  * attachSharedMemory:
  * Attaches to a shared memory segment and returns a pointer to it.
- * If the attachment fails, logs an error and exits the program.
+ * If the attachment fails, logs an error and exits the colony process.
  * 
  * @param shmid The shared memory identifier.
  * @return A pointer to the shared memory segment.
@@ -130,7 +190,7 @@ void logMessage(LogLevel level, const char* format, ...) {
 void* attachSharedMemory(int shmid) {
     void* sharedMemory = shmat(shmid, NULL, 0);
     if (sharedMemory == (void*)-1) {
-        handleError("[attachSharedMemory] shmat failed", shmid, -1);
+        handleError("[attachSharedMemory] shmat failed", -1, -1);
     }
     return sharedMemory;
 }
@@ -144,34 +204,65 @@ void* attachSharedMemory(int shmid) {
  */
 void detachSharedMemory(void* sharedMemory) {
     if (shmdt(sharedMemory) == -1) {
-        handleError("[detachSharedMemory] shmdt failed", -1, -1);
+        logMessage(LOG_ERROR, "[detachSharedMemory] shmdt failed: %s", strerror(errno));
     }
 }
 
+/**
+ * failSemaphores:
+ * Logs a failure of initHiveSemaphores and removes the segment.
+ *
+ * @return NULL, for the caller to return.
+ */
+static HiveSemaphores* failSemaphores(const char* message, HiveSemaphores* semaphores, int* semid) {
+    int saved = errno;
+    logMessage(LOG_ERROR, "%s: %s", message, strerror(saved));
+    if (semaphores) shmdt(semaphores);
+    shmctl(*semid, IPC_RMID, NULL);
+    *semid = -1;
+    errno = saved;
+    return NULL;
+}
+
 HiveSemaphores* initHiveSemaphores(int* semid) {
     *semid = shmget(IPC_PRIVATE, sizeof(HiveSemaphores), IPC_CREAT | 0666);
     if (*semid == -1) {
-        handleError("[INIT] Failed to create shared memory for HiveSemaphores", -1, -1);
+        logMessage(LOG_ERROR, "[INIT] Failed to create shared memory for HiveSemaphores: %s", strerror(errno));
+        return NULL;
     }
 
-    HiveSemaphores* semaphores = (HiveSemaphores*)attachSharedMemory(*semid);
-    if (semaphores == NULL) {
-        handleError("[INIT] Failed to attach shared memory for HiveSemaphores", -1, *semid);
+    HiveSemaphores* semaphores = (HiveSemaphores*)shmat(*semid, NULL, 0);
+    if (semaphores == (void*)-1) {
+        return failSemaphores("[INIT] Failed to attach shared memory for HiveSemaphores", NULL, semid);
     }
 
-    // Initialize semaphores
-    if (sem_init(&semaphores->hiveSem, 1, 1) == -1) {
-        handleError("[INIT] Failed to initialize hiveSem", -1, *semid);
+    // Initialize robust locks
+    if (robustLockInit(&semaphores->hiveSem) == -1) {
+        return failSemaphores("[INIT] Failed to initialize hiveSem", semaphores, semid);
     }
 
     for (int i = 0; i < 2; i++) {
-        if (sem_init(&semaphores->entranceSem[i], 1, 1) == -1) {
-            handleError("[INIT] Failed to initialize entranceSem", -1, *semid);
+        if (robustLockInit(&semaphores->entranceSem[i]) == -1) {
+            return failSemaphores("[INIT] Failed to initialize entranceSem", semaphores, semid);
         }
-        if (sem_init(&semaphores->fifoQueue[i], 1, 1) == -1) {
-            handleError("[INIT] Failed to initialize fifoQueue", -1, *semid);
+        if (robustLockInit(&semaphores->fifoQueue[i]) == -1) {
+            return failSemaphores("[INIT] Failed to initialize fifoQueue", semaphores, semid);
         }
     }
+    for (int f = 0; f < HIVE_MAX_FRAMES; f++) {
+        if (robustLockInit(&semaphores->frameSem[f].lock) == -1) {
+            return failSemaphores("[INIT] Failed to initialize frameSem", semaphores, semid);
+        }
+        semaphores->frameSem[f].lastNode = -1;
+        semaphores->frameSem[f].crossNodeHandoffs = 0;
+        memset(semaphores->frameSem[f].acquisitions, 0, sizeof(semaphores->frameSem[f].acquisitions));
+    }
+    semaphores->repairPending = 0;
+    semaphores->shutdown = 0;
+    semaphores->ownerDeaths = 0;
+    if (sem_init(&semaphores->queenWake, 1, 0) == -1) {
+        return failSemaphores("[INIT] Failed to initialize queenWake", semaphores, semid);
+    }
     return semaphores;
 }
 
@@ -190,7 +281,7 @@ void cleanupResources(int shmid, int semid) {
 /**
  * handleError:
  * Handles critical errors by logging the message, printing the system error message,
- * releasing shared resources, and terminating the program.
+ * releasing shared resources, and terminating the colony process.
  * 
  * @param message A descriptive error message.
  * @param shmid The shared memory identifier to release (if valid).
@@ -219,6 +310,11 @@ void handleError(const char* message, int shmid, int semid) {
         }
     }
 
-    exit(EXIT_FAILURE);
+    exitColonyProcess(EXIT_FAILURE);
  
 }
+
+void exitColonyProcess(int status) {
+    fflush(stdout);
+    _exit(status);
+}
@@ -0,0 +1,252 @@
+#include "configpage.h"
+#include "hivelock.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+/**
+ * The parameters by name, as used in configuration files, beehiveSet and beehive-config.
+ */
+static const struct {
+    const char* name;
+    size_t offset;
+} FIELDS[] = {
+    {"T_k", offsetof(HiveTunables, T_k)},
+    {"eggsCount", offsetof(HiveTunables, eggsCount)},
+    {"T_inHive", offsetof(HiveTunables, T_inHive)},
+    {"maxVisits", offsetof(HiveTunables, maxVisits)},
+    {"minOutsideTime", offsetof(HiveTunables, minOutsideTime)},
+    {"maxOutsideTime", offsetof(HiveTunables, maxOutsideTime)},
+    {"transitMs", offsetof(HiveTunables, transitMs)},
+    {"maxBees", offsetof(HiveTunables, maxBees)},
+};
+
+#define FIELD_COUNT (int)(sizeof(FIELDS) / sizeof(FIELDS[0]))
+
+/**
+ * Returns the field of a parameter (every parameter is an int).
+ */
+static int* field(HiveTunables* values, int index) {
+    return (int*)((char*)values + FIELDS[index].offset);
+}
+
+void configDefaults(HiveTunables* values) {
+    *values = (HiveTunables){1, 1, T_IN_HIVE, MAX_BEE_VISITS, MIN_OUTSIDE_TIME, MAX_OUTSIDE_TIME,
+                             TRANSIT_TIME_MS, MAX_BEES};
+}
+
+int configSet(HiveTunables* values, const char* name, int value) {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        if (strcmp(FIELDS[i].name, name) == 0) {
+            *field(values, i) = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* configName(int index) {
+    return index >= 0 && index < FIELD_COUNT ? FIELDS[index].name : NULL;
+}
+
+int configValue(const HiveTunables* values, int index) {
+    return *field((HiveTunables*)values, index);
+}
+
+const char* configCheck(const HiveTunables* values, int capacity) {
+    if (values->T_k < 1) return "T_k must be at least 1";
+    if (values->eggsCount < 1) return "eggsCount must be at least 1";
+    if (values->T_inHive < 0) return "T_inHive must not be negative";
+    if (values->maxVisits < 1) return "maxVisits must be at least 1";
+    if (values->minOutsideTime < 0) return "minOutsideTime must not be negative";
+    if (values->maxOutsideTime < values->minOutsideTime) return "maxOutsideTime must be at least minOutsideTime";
+    if (values->transitMs < 0 || values->transitMs > 60000) return "transitMs must be between 0 and 60000";
+    if (values->maxBees < 1 || values->maxBees > capacity) return "maxBees must be between 1 and the bee table capacity";
+    return NULL;
+}
+
+int configLoad(const char* path, HiveTunables* values, char* error, size_t errorSize) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        snprintf(error, errorSize, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    char line[256];
+    int number = 0;
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), file)) {
+        number++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char* text = line;
+        while (isspace((unsigned char)*text)) text++;
+        if (*text == '\0') continue;
+
+        char name[64];
+        int value;
+        char extra;
+        if (sscanf(text, "%63[A-Za-z_] = %d %c", name, &value, &extra) != 2) {
+            snprintf(error, errorSize, "%s:%d: expected \"name = integer\"", path, number);
+            result = -1;
+        } else if (configSet(values, name, value) == -1) {
+            snprintf(error, errorSize, "%s:%d: unknown parameter \"%s\"", path, number, name);
+            result = -1;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+/**
+ * Names a new page: beehive_config_<pid>, with a sequence number appended for the later
+ * colonies of the same process.
+ */
+static void pageName(char* path, size_t size) {
+    static unsigned int created = 0;
+    unsigned int sequence = __atomic_fetch_add(&created, 1, __ATOMIC_RELAXED);
+    if (sequence == 0) {
+        snprintf(path, size, "/beehive_config_%d", (int)getpid());
+    } else {
+        snprintf(path, size, "/beehive_config_%d_%u", (int)getpid(), sequence);
+    }
+}
+
+ConfigPage* configPageCreate(const HiveTunables* values, int capacity) {
+    char path[128];
+    pageName(path, sizeof(path));
+    int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        logMessage(LOG_ERROR, "[Config] shm_open(%s) failed: %s", path, strerror(errno));
+        return NULL;
+    }
+    ConfigPage* page = NULL;
+    if (ftruncate(fd, (off_t)sizeof(ConfigPage)) == 0) {
+        page = mmap(NULL, sizeof(ConfigPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (page == NULL || page == MAP_FAILED) {
+        logMessage(LOG_ERROR, "[Config] Failed to map %zu bytes: %s", sizeof(ConfigPage), strerror(errno));
+        shm_unlink(path);
+        return NULL;
+    }
+    if (robustLockInit(&page->writeLock) == -1) {
+        logMessage(LOG_ERROR, "[Config] Failed to initialize the write lock: %s", strerror(errno));
+        munmap(page, sizeof(ConfigPage));
+        shm_unlink(path);
+        return NULL;
+    }
+
+    page->layout = CONFIG_PAGE_LAYOUT;
+    page->capacity = capacity;
+    snprintf(page->path, sizeof(page->path), "%s", path);
+    page->values = *values;
+    __atomic_store_n(&page->sequence, 2, __ATOMIC_RELEASE); // Version 1
+    return page;
+}
+
+ConfigPage* configPageAttach(const char* path) {
+    int fd = shm_open(path, O_RDWR, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size != sizeof(ConfigPage)) {
+        close(fd);
+        errno = EPROTO;
+        return NULL;
+    }
+    ConfigPage* page = mmap(NULL, sizeof(ConfigPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        return NULL;
+    }
+    if (page->layout != CONFIG_PAGE_LAYOUT) {
+        munmap(page, sizeof(ConfigPage));
+        errno = EPROTO;
+        return NULL;
+    }
+    return page;
+}
+
+void configPageDetach(ConfigPage* page) {
+    munmap(page, sizeof(ConfigPage));
+}
+
+void configPageDestroy(ConfigPage* page) {
+    char path[sizeof(page->path)];
+    snprintf(path, sizeof(path), "%s", page->path);
+    pthread_mutex_destroy(&page->writeLock);
+    munmap(page, sizeof(ConfigPage));
+    if (shm_unlink(path) == -1 && errno != ENOENT) {
+        logMessage(LOG_WARNING, "[Config] Failed to remove %s: %s", path, strerror(errno));
+    }
+}
+
+bool configPageRead(const ConfigPage* page, HiveTunables* values, uint64_t* version) {
+    for (int attempt = 0; attempt < CONFIG_PAGE_READ_ATTEMPTS; attempt++) {
+        uint64_t before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+        // Field by field with relaxed loads: a copy torn by a writer is never used
+        HiveTunables copy;
+        for (int i = 0; i < FIELD_COUNT; i++) {
+            *field(&copy, i) = __atomic_load_n(field((HiveTunables*)&page->values, i), __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == before) {
+            *values = copy;
+            if (version) *version = before / 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * publish:
+ * Stores new values under the sequence lock (write lock held).
+ */
+static uint64_t publish(ConfigPage* page, const HiveTunables* values) {
+    uint64_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED) | 1;
+    __atomic_store_n(&page->sequence, sequence, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        __atomic_store_n(field(&page->values, i), configValue(values, i), __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&page->sequence, sequence + 1, __ATOMIC_RELEASE);
+    return (sequence + 1) / 2;
+}
+
+uint64_t configPageWrite(ConfigPage* page, const HiveTunables* values, uint64_t version) {
+    if (configCheck(values, page->capacity) != NULL) {
+        errno = EINVAL;
+        return 0;
+    }
+    int rc = pthread_mutex_lock(&page->writeLock);
+    if (rc == EOWNERDEAD) {
+        // A writer died; if it was halfway through, readers have been keeping their old copies
+        pthread_mutex_consistent(&page->writeLock);
+        if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) & 1) {
+            logMessage(LOG_WARNING, "[Config] A writer died while updating %s; the update is replaced.", page->path);
+            uint64_t written = publish(page, values);
+            pthread_mutex_unlock(&page->writeLock);
+            return written;
+        }
+    } else if (rc != 0) {
+        errno = rc;
+        return 0;
+    }
+
+    uint64_t current = __atomic_load_n(&page->sequence, __ATOMIC_RELAXED) / 2;
+    uint64_t written = 0;
+    if (current != version) {
+        errno = EAGAIN;
+    } else {
+        written = publish(page, values);
+    }
+    pthread_mutex_unlock(&page->writeLock);
+    return written;
+}
@@ -0,0 +1,377 @@
+#include "ensemble.h"
+#include "common.h"
+
+/**
+ * Vector types used by the bee kernel. GCC lowers them to AVX2 registers when the
+ * AVX2 clone of the kernel is selected and to pairs of SSE2 registers otherwise.
+ */
+typedef int32_t vint __attribute__((vector_size(ENSEMBLE_LANES * sizeof(int32_t))));
+typedef uint32_t vuint __attribute__((vector_size(ENSEMBLE_LANES * sizeof(uint32_t))));
+
+/**
+ * Compile the kernel for AVX2 and for the baseline ISA and pick one at load time.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define ENSEMBLE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define ENSEMBLE_KERNEL
+#endif
+
+/**
+ * Byte alignment of the structure-of-arrays buffers (one AVX2 register).
+ */
+#define ENSEMBLE_ALIGN 32
+
+/**
+ * Per-lane counters of one replica group, kept in vector registers while
+ * the kernel walks over the group's bees.
+ */
+typedef struct {
+    vint occupancy;  // Bees inside the hive.
+    vint alive;      // Bees alive.
+    vint waiting[2]; // Bees queued at each entrance.
+    vint entries;    // Successful entries.
+    vint rejections; // Refused entry attempts.
+} LaneCounters;
+
+/**
+ * Structure-of-arrays state of all replicas. Bee b of replica group g occupies
+ * lanes [(g * bees + b) * ENSEMBLE_LANES, ... + ENSEMBLE_LANES) of every bee array.
+ */
+struct Ensemble {
+    EnsembleConfig config;
+    int groups;            // Number of replica groups (replicas rounded up to ENSEMBLE_LANES).
+    int bees;              // Bee slots per replica.
+    int capacity;          // calculateP(N), the hive capacity.
+    int32_t* state;        // EnsembleBeeState of every bee.
+    int32_t* timer;        // Remaining steps outside or inside the hive.
+    int32_t* visits;       // Completed visits (-1 while a newborn waits for its first exit).
+    int32_t* entrance;     // Entrance the bee is queued at.
+    uint32_t* rng;         // xorshift32 state of every bee.
+    LaneCounters* counters;      // Per-group lane counters.
+    int32_t* eggsLaid;           // Per-replica eggs laid.
+    int32_t* maxOccupancy;       // Per-replica occupancy maximum.
+    int32_t* survivalTime;       // Per-replica extinction step.
+    int64_t* occupancySum;       // Per-replica sum of occupancy over steps.
+    EnsembleReplicaStats* results;
+    long* histogram;             // Occupancy distribution over all replicas and steps.
+    int bins;
+};
+
+/**
+ * Returns a vector with every lane set to value. Macros rather than functions so
+ * that no vector crosses a call boundary (whose ABI depends on the selected ISA).
+ */
+#define splat(value) ((vint){0} + (int32_t)(value))
+
+/**
+ * Lane-wise select: returns a where mask is set (-1) and b elsewhere.
+ */
+#define blend(mask, a, b) (((a) & (mask)) | ((b) & ~(mask)))
+
+/**
+ * Scalar xorshift32 used to seed the per-bee generators.
+ */
+static uint32_t xorshift32(uint32_t* x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+/**
+ * Draws a flight time in [minOutside, maxOutside] from a 32-bit random value.
+ */
+static int32_t scalarFlight(const EnsembleConfig* c, uint32_t x) {
+    return (int32_t)(((x >> 16) * (uint32_t)(c->maxOutside - c->minOutside + 1)) >> 16) + c->minOutside;
+}
+
+/**
+ * stepBees:
+ * Advances every bee of one replica group by one step. Each vector lane is a
+ * different replica, so the sequential capacity check of beeWorker (bees see
+ * the occupancy left by the bees processed before them) holds within every lane
+ * while ENSEMBLE_LANES replicas progress at once.
+ *
+ * Rules reproduced from beeWorker:
+ * - Outside and inside timers count down; on expiry the bee queues at the entrance
+ *   chosen like chooseEntrance (random if queues differ by at most one, else the shorter).
+ * - A bee queued to enter is refused when the hive holds calculateP(N) bees; it then
+ *   waits one extra second and flies out again.
+ * - Entering and leaving consume one of the step's transits (the hive lock is held
+ *   for 100 ms per transit). The walk over the bees starts at a different bee every
+ *   step so that no bee is permanently first in line for the transits.
+ * - Leaving completes a visit; after maxVisits visits the bee dies.
+ */
+ENSEMBLE_KERNEL
+static void stepBees(const EnsembleConfig* c, int capacity, int bees, int first,
+                     int32_t* restrict state, int32_t* restrict timer, int32_t* restrict visits,
+                     int32_t* restrict entrance, uint32_t* restrict rng, LaneCounters* lanes) {
+    const vint outsideRange = splat(c->maxOutside - c->minOutside + 1);
+    const vint minOutside = splat(c->minOutside);
+    const vint tInHive = splat(c->T_inHive);
+    const vint maxVisits = splat(c->maxVisits);
+    const vint cap = splat(capacity);
+
+    vint occ = lanes->occupancy;
+    vint alive = lanes->alive;
+    vint w0 = lanes->waiting[0];
+    vint w1 = lanes->waiting[1];
+    vint entries = lanes->entries;
+    vint rejections = lanes->rejections;
+    vint budget = splat(c->transitsPerStep);
+
+    for (int i = 0, b = first; i < bees; i++, b = (b + 1 == bees) ? 0 : b + 1) {
+        size_t at = (size_t)b * ENSEMBLE_LANES;
+        vint st, tm, vis, ent;
+        vuint x;
+        __builtin_memcpy(&st, state + at, sizeof(st));
+        __builtin_memcpy(&tm, timer + at, sizeof(tm));
+        __builtin_memcpy(&vis, visits + at, sizeof(vis));
+        __builtin_memcpy(&ent, entrance + at, sizeof(ent));
+        __builtin_memcpy(&x, rng + at, sizeof(x));
+
+        // Vectorized xorshift32: one draw per bee and step
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        vint coin = (vint)(x & 1);
+        vint flight = (vint)(((x >> 16) * (vuint)outsideRange) >> 16) + minOutside;
+
+        // Entrance choice as in chooseEntrance
+        vint diff = w0 - w1;
+        vint absDiff = blend(diff < 0, -diff, diff);
+        vint choice = blend(absDiff <= 1, coin, (w0 >= w1) & 1);
+
+        // Timers run while flying or resting; on expiry the bee joins a queue
+        vint isOut = st == ENSEMBLE_OUTSIDE;
+        vint isIn = st == ENSEMBLE_INSIDE;
+        tm = tm + (isOut | isIn);
+        vint expired = (isOut | isIn) & (tm <= 0);
+        ent = blend(expired, choice, ent);
+        w0 = w0 - (expired & (ent == 0));
+        w1 = w1 - (expired & (ent != 0));
+        st = blend(expired & isOut, splat(ENSEMBLE_QUEUED_IN), st);
+        st = blend(expired & isIn, splat(ENSEMBLE_QUEUED_OUT), st);
+
+        // Queued bees go through the entrance while transits remain in this step
+        vint qIn = st == ENSEMBLE_QUEUED_IN;
+        vint qOut = st == ENSEMBLE_QUEUED_OUT;
+        vint hasBudget = budget > 0;
+        vint rejected = qIn & (occ >= cap);
+        vint enters = qIn & ~rejected & hasBudget;
+        vint leaves = qOut & hasBudget;
+        budget = budget + (enters | leaves);
+
+        vint dequeued = rejected | enters | leaves;
+        w0 = w0 + (dequeued & (ent == 0));
+        w1 = w1 + (dequeued & (ent != 0));
+        occ = occ - enters + leaves;
+        entries = entries - enters;
+        rejections = rejections - rejected;
+
+        st = blend(enters, splat(ENSEMBLE_INSIDE), st);
+        tm = blend(enters, tInHive, tm);
+
+        st = blend(rejected, splat(ENSEMBLE_OUTSIDE), st);
+        tm = blend(rejected, flight + 1, tm);
+
+        vis = vis - leaves;
+        vint dies = leaves & (vis >= maxVisits);
+        st = blend(leaves, blend(dies, splat(ENSEMBLE_DEAD), splat(ENSEMBLE_OUTSIDE)), st);
+        tm = blend(leaves, flight, tm);
+        alive = alive + dies;
+
+        __builtin_memcpy(state + at, &st, sizeof(st));
+        __builtin_memcpy(timer + at, &tm, sizeof(tm));
+        __builtin_memcpy(visits + at, &vis, sizeof(vis));
+        __builtin_memcpy(entrance + at, &ent, sizeof(ent));
+        __builtin_memcpy(rng + at, &x, sizeof(x));
+    }
+
+    lanes->occupancy = occ;
+    lanes->alive = alive;
+    lanes->waiting[0] = w0;
+    lanes->waiting[1] = w1;
+    lanes->entries = entries;
+    lanes->rejections = rejections;
+}
+
+/**
+ * layEggs:
+ * Applies the queen's egg-laying rule of queenWorker to every lane of a group:
+ * eggs are laid only if eggsCount fit into the free hive space and the colony
+ * stays within N bees. Newborns start inside the hive in free (dead) slots.
+ * Runs once every T_k steps, so the scalar slot search is off the hot path.
+ */
+static void layEggs(Ensemble* e, int g) {
+    const EnsembleConfig* c = &e->config;
+    LaneCounters* lanes = &e->counters[g];
+    size_t base = (size_t)g * e->bees * ENSEMBLE_LANES;
+
+    for (int l = 0; l < ENSEMBLE_LANES; l++) {
+        int freeSpace = e->capacity - lanes->occupancy[l];
+        if (freeSpace < c->eggsCount || lanes->alive[l] + c->eggsCount > c->N) {
+            continue;
+        }
+
+        int laid = 0;
+        for (int b = 0; b < e->bees && laid < c->eggsCount; b++) {
+            size_t at = base + (size_t)b * ENSEMBLE_LANES + l;
+            if (e->state[at] != ENSEMBLE_DEAD) continue;
+            e->state[at] = ENSEMBLE_INSIDE;
+            e->timer[at] = c->T_inHive;
+            e->visits[at] = -1;
+            laid++;
+        }
+        lanes->occupancy[l] += laid;
+        lanes->alive[l] += laid;
+        e->eggsLaid[g * ENSEMBLE_LANES + l] += laid;
+    }
+}
+
+void ensembleDefaultConfig(EnsembleConfig* config) {
+    config->N = 10;
+    config->T_k = 5;
+    config->eggsCount = 2;
+    config->maxVisits = MAX_BEE_VISITS;
+    config->T_inHive = T_IN_HIVE;
+    config->minOutside = MIN_OUTSIDE_TIME;
+    config->maxOutside = MAX_OUTSIDE_TIME;
+    config->transitsPerStep = 10;
+    config->replicas = 1024;
+    config->steps = 600;
+    config->seed = (uint32_t)time(NULL);
+}
+
+/**
+ * Allocates a zeroed buffer aligned for vector loads.
+ */
+static void* alignedCalloc(size_t count, size_t size) {
+    size_t bytes = (count * size + ENSEMBLE_ALIGN - 1) / ENSEMBLE_ALIGN * ENSEMBLE_ALIGN;
+    void* p = aligned_alloc(ENSEMBLE_ALIGN, bytes);
+    if (p) memset(p, 0, bytes);
+    return p;
+}
+
+Ensemble* ensembleCreate(const EnsembleConfig* config) {
+    if (config->N <= 0 || config->T_k <= 0 || config->eggsCount <= 0 || config->maxVisits <= 0 ||
+        config->T_inHive < 0 || config->minOutside < 0 || config->maxOutside < config->minOutside ||
+        config->transitsPerStep <= 0 || config->replicas <= 0 || config->steps < 0) {
+        return NULL;
+    }
+
+    Ensemble* e = calloc(1, sizeof(Ensemble));
+    if (!e) return NULL;
+    e->config = *config;
+    e->groups = (config->replicas + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+    e->bees = config->N;
+    e->capacity = calculateP(config->N);
+    e->bins = (e->capacity > 0 ? e->capacity : 0) + 1;
+
+    size_t lanes = (size_t)e->groups * ENSEMBLE_LANES;
+    size_t slots = lanes * e->bees;
+    e->state = alignedCalloc(slots, sizeof(int32_t));
+    e->timer = alignedCalloc(slots, sizeof(int32_t));
+    e->visits = alignedCalloc(slots, sizeof(int32_t));
+    e->entrance = alignedCalloc(slots, sizeof(int32_t));
+    e->rng = alignedCalloc(slots, sizeof(uint32_t));
+    e->counters = alignedCalloc(e->groups, sizeof(LaneCounters));
+    e->eggsLaid = calloc(lanes, sizeof(int32_t));
+    e->maxOccupancy = calloc(lanes, sizeof(int32_t));
+    e->survivalTime = calloc(lanes, sizeof(int32_t));
+    e->occupancySum = calloc(lanes, sizeof(int64_t));
+    e->results = calloc(config->replicas, sizeof(EnsembleReplicaStats));
+    e->histogram = calloc(e->bins, sizeof(long));
+    if (!e->state || !e->timer || !e->visits || !e->entrance || !e->rng || !e->counters ||
+        !e->eggsLaid || !e->maxOccupancy || !e->survivalTime || !e->occupancySum ||
+        !e->results || !e->histogram) {
+        ensembleDestroy(e);
+        return NULL;
+    }
+
+    // Every replica starts like main.c: N bees outside, each with its own random stream
+    uint32_t seed = config->seed ? config->seed : 0x9e3779b9u;
+    for (size_t i = 0; i < slots; i++) {
+        uint32_t x = seed ^ (uint32_t)(i * 0x9e3779b9u);
+        if (x == 0) x = 0x6d2b79f5u;
+        xorshift32(&x);
+        e->rng[i] = xorshift32(&x);
+        e->state[i] = ENSEMBLE_OUTSIDE;
+        e->timer[i] = scalarFlight(config, xorshift32(&x));
+    }
+    for (int g = 0; g < e->groups; g++) {
+        e->counters[g].alive = splat(config->N);
+    }
+    for (size_t l = 0; l < lanes; l++) {
+        e->survivalTime[l] = -1;
+    }
+    return e;
+}
+
+void ensembleRun(Ensemble* e) {
+    const EnsembleConfig* c = &e->config;
+    size_t groupSlots = (size_t)e->bees * ENSEMBLE_LANES;
+
+    // Groups are independent, so each one runs the whole horizon while its bees stay in cache
+    for (int g = 0; g < e->groups; g++) {
+        size_t base = (size_t)g * groupSlots;
+        LaneCounters* lanes = &e->counters[g];
+        for (int t = 0; t < c->steps; t++) {
+            int first = (int)(((uint64_t)t * 2654435761u) % (uint64_t)e->bees);
+            stepBees(c, e->capacity, e->bees, first, e->state + base, e->timer + base, e->visits + base,
+                     e->entrance + base, e->rng + base, lanes);
+
+            if ((t + 1) % c->T_k == 0) {
+                layEggs(e, g);
+            }
+
+            for (int l = 0; l < ENSEMBLE_LANES; l++) {
+                int r = g * ENSEMBLE_LANES + l;
+                int occ = lanes->occupancy[l];
+                e->occupancySum[r] += occ;
+                if (occ > e->maxOccupancy[r]) e->maxOccupancy[r] = occ;
+                if (e->survivalTime[r] < 0 && lanes->alive[l] <= 0) e->survivalTime[r] = t + 1;
+                if (r < c->replicas) e->histogram[occ < e->bins ? occ : e->bins - 1]++;
+            }
+        }
+    }
+
+    for (int r = 0; r < c->replicas; r++) {
+        int g = r / ENSEMBLE_LANES, l = r % ENSEMBLE_LANES;
+        EnsembleReplicaStats* s = &e->results[r];
+        s->meanOccupancy = c->steps ? (double)e->occupancySum[r] / c->steps : 0.0;
+        s->maxOccupancy = e->maxOccupancy[r];
+        s->entries = e->counters[g].entries[l];
+        s->rejections = e->counters[g].rejections[l];
+        s->eggsLaid = e->eggsLaid[r];
+        s->survivalTime = e->survivalTime[r];
+        s->finalAlive = e->counters[g].alive[l];
+    }
+}
+
+const EnsembleReplicaStats* ensembleResults(const Ensemble* e) {
+    return e->results;
+}
+
+const long* ensembleOccupancyHistogram(const Ensemble* e, int* bins) {
+    *bins = e->bins;
+    return e->histogram;
+}
+
+void ensembleDestroy(Ensemble* e) {
+    if (!e) return;
+    free(e->state);
+    free(e->timer);
+    free(e->visits);
+    free(e->entrance);
+    free(e->rng);
+    free(e->counters);
+    free(e->eggsLaid);
+    free(e->maxOccupancy);
+    free(e->survivalTime);
+    free(e->occupancySum);
+    free(e->results);
+    free(e->histogram);
+    free(e);
+}
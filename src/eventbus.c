@@ -0,0 +1,152 @@
+#include "eventbus.h"
+#include <sys/mman.h>
+
+/**
+ * Display names of the HiveEventType values.
+ */
+static const char* const EVENT_NAMES[HIVE_EVENT_TYPES] = {
+    NULL, "queue", "enter", "leave", "reject", "birth", "death", "resize"
+};
+
+/**
+ * Names a new bus: beehive_events_<pid>, with a sequence number appended for the later
+ * colonies of the same process.
+ */
+static void busName(char* path, size_t size) {
+    static unsigned int created = 0;
+    unsigned int sequence = __atomic_fetch_add(&created, 1, __ATOMIC_RELAXED);
+    if (sequence == 0) {
+        snprintf(path, size, "/beehive_events_%d", (int)getpid());
+    } else {
+        snprintf(path, size, "/beehive_events_%d_%u", (int)getpid(), sequence);
+    }
+}
+
+EventBus* eventBusCreate(size_t capacity) {
+    if (capacity == 0) {
+        capacity = EVENT_BUS_DEFAULT_CAPACITY;
+    }
+    // Positions map to events with a mask
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+
+    char path[128];
+    busName(path, sizeof(path));
+    size_t bytes = sizeof(EventBus) + rounded * sizeof(HiveEvent);
+    int fd = shm_open(path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        logMessage(LOG_ERROR, "[EventBus] shm_open(%s) failed: %s", path, strerror(errno));
+        return NULL;
+    }
+    EventBus* bus = NULL;
+    if (ftruncate(fd, (off_t)bytes) == 0) {
+        bus = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (bus == NULL || bus == MAP_FAILED) {
+        logMessage(LOG_ERROR, "[EventBus] Failed to map %zu bytes: %s", bytes, strerror(errno));
+        shm_unlink(path);
+        return NULL;
+    }
+
+    // Fresh objects are zero-filled: no event is published yet
+    bus->capacity = rounded;
+    bus->mappedBytes = bytes;
+    snprintf(bus->path, sizeof(bus->path), "%s", path);
+    return bus;
+}
+
+const EventBus* eventBusAttach(const char* path) {
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(EventBus)) {
+        close(fd);
+        return NULL;
+    }
+    void* bus = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return bus == MAP_FAILED ? NULL : bus;
+}
+
+void eventBusDetach(const EventBus* bus) {
+    munmap((void*)bus, bus->mappedBytes);
+}
+
+void eventBusDestroy(EventBus* bus) {
+    char path[sizeof(bus->path)];
+    snprintf(path, sizeof(path), "%s", bus->path);
+    munmap(bus, bus->mappedBytes);
+    if (shm_unlink(path) == -1 && errno != ENOENT) {
+        logMessage(LOG_WARNING, "[EventBus] Failed to remove %s: %s", path, strerror(errno));
+    }
+}
+
+void eventBusPublish(EventBus* bus, HiveEventType type, int bee, int entrance, int value, unsigned int flags) {
+    if (!bus) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    uint64_t position = __atomic_fetch_add(&bus->head, 1, __ATOMIC_RELAXED);
+    HiveEvent* event = &bus->events[position & (bus->capacity - 1)];
+
+    // Readers that see the old sequence after this store know the event is being rewritten
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event->time = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    event->bee = bee;
+    event->value = value;
+    event->type = (uint8_t)type;
+    event->entrance = (uint8_t)entrance;
+    event->flags = (uint16_t)flags;
+    __atomic_store_n(&event->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+void eventBusSubscribe(const EventBus* bus, EventCursor* cursor, bool fromOldest) {
+    uint64_t head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+    cursor->cursor = head;
+    if (fromOldest) {
+        cursor->cursor = head > bus->capacity ? head - bus->capacity : 0;
+    }
+    cursor->lost = 0;
+}
+
+bool eventBusNext(const EventBus* bus, EventCursor* cursor, HiveEvent* event) {
+    uint64_t head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+    while (cursor->cursor < head) {
+        // Positions more than a lap behind the head have been reserved again
+        if (head - cursor->cursor > bus->capacity) {
+            cursor->lost += head - bus->capacity - cursor->cursor;
+            cursor->cursor = head - bus->capacity;
+        }
+
+        const HiveEvent* slot = &bus->events[cursor->cursor & (bus->capacity - 1)];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == cursor->cursor + 1) {
+            *event = *slot;
+            // The copy is only valid if no writer of the next lap started on the event meanwhile
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+                cursor->cursor++;
+                return true;
+            }
+        } else if (sequence <= cursor->cursor) {
+            // Reserved but not published yet; a writer that died in between is given up on
+            if (head - cursor->cursor <= EVENT_BUS_STALL_LIMIT) {
+                return false;
+            }
+            cursor->lost++;
+            cursor->cursor++;
+        }
+        head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+    }
+    return false;
+}
+
+const char* eventTypeName(int type) {
+    return type > 0 && type < HIVE_EVENT_TYPES ? EVENT_NAMES[type] : NULL;
+}
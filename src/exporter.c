@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include "exporter.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/**
+ * A connection whose request has not been answered yet.
+ */
+typedef struct {
+    int fd;             // Connected socket (non-blocking), or -1 for a free entry.
+    double deadline;    // CLOCK_MONOTONIC seconds by which the request must be complete.
+    size_t length;      // Bytes of the request received so far.
+    char request[1024];
+} Client;
+
+struct Exporter {
+    int fd;                    // Listening socket.
+    int epfd;                  // Epoll set of the listening socket and the clients.
+    const HiveData* hive;      // Shared hive state.
+    char path[108];            // Path of the Unix-domain socket, or empty for TCP.
+    Client clients[EXPORTER_MAX_CLIENTS];
+    int clientCount;
+    bool accepting;            // The listening socket is in the epoll set (not while every entry is taken).
+};
+
+/**
+ * Reads a counter of the shared hive state. Counters on the hot path are updated with
+ * relaxed atomics, so the exporter never takes the hive lock.
+ */
+#define READ_COUNTER(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+Exporter* exporterCreate(const char* address, const HiveData* hive) {
+    Exporter* exporter = calloc(1, sizeof(Exporter));
+    if (!exporter) {
+        return NULL;
+    }
+    exporter->hive = hive;
+    exporter->epfd = -1;
+
+    bool isPort = *address != '\0';
+    for (const char* p = address; *p; p++) {
+        if (!isdigit((unsigned char)*p)) isPort = false;
+    }
+
+    int fd;
+    if (isPort) {
+        struct sockaddr_in addr = {0};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(address));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1 ||
+            bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            goto fail;
+        }
+    } else {
+        struct sockaddr_un addr = {0};
+        addr.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            free(exporter);
+            return NULL;
+        }
+        strcpy(addr.sun_path, address);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            goto fail;
+        }
+        // A socket left over by an earlier run is replaced; any other file is an error
+        struct stat st;
+        if (lstat(address, &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                errno = EEXIST;
+                goto fail;
+            }
+            unlink(address);
+        }
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            goto fail;
+        }
+        strcpy(exporter->path, address);
+    }
+    if (listen(fd, 16) == -1) {
+        goto fail;
+    }
+    exporter->epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (exporter->epfd == -1 || epoll_ctl(exporter->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        goto fail;
+    }
+    exporter->fd = fd;
+    exporter->accepting = true;
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+        exporter->clients[i].fd = -1;
+    }
+    logMessage(LOG_INFO, "[Exporter] Serving hive metrics on %s%s.", isPort ? "127.0.0.1:" : "", address);
+    return exporter;
+
+fail:;
+    int saved = errno;
+    if (fd != -1) close(fd);
+    if (exporter->epfd != -1) close(exporter->epfd);
+    if (exporter->path[0]) unlink(exporter->path);
+    free(exporter);
+    errno = saved;
+    return NULL;
+}
+
+/**
+ * formatMetrics:
+ * Renders the hive metrics in the Prometheus text exposition format.
+ *
+ * @param hive Shared hive state.
+ * @param buffer Destination.
+ * @param size Size of the destination.
+ * @return Length of the text (truncated to size - 1).
+ */
+static int formatMetrics(const HiveData* hive, char* buffer, size_t size) {
+    int N = READ_COUNTER(hive->N);
+    int len = snprintf(buffer, size,
+        "# HELP beehive_occupancy Bees inside the hive.\n"
+        "# TYPE beehive_occupancy gauge\n"
+        "beehive_occupancy %d\n"
+        "# HELP beehive_size Hive size N, the queen's population limit.\n"
+        "# TYPE beehive_size gauge\n"
+        "beehive_size %d\n"
+        "# HELP beehive_capacity Bees the hive can hold at once, calculateP(N).\n"
+        "# TYPE beehive_capacity gauge\n"
+        "beehive_capacity %d\n"
+        "# HELP beehive_queue_length Bees queued at an entrance.\n"
+        "# TYPE beehive_queue_length gauge\n"
+        "beehive_queue_length{entrance=\"0\"} %d\n"
+        "beehive_queue_length{entrance=\"1\"} %d\n"
+        "# HELP beehive_bees_alive Living bees.\n"
+        "# TYPE beehive_bees_alive gauge\n"
+        "beehive_bees_alive %d\n"
+        "# HELP beehive_eggs_laid_total Eggs laid by the queen.\n"
+        "# TYPE beehive_eggs_laid_total counter\n"
+        "beehive_eggs_laid_total %lu\n"
+        "# HELP beehive_eggs_skipped_total Eggs the queen did not lay for lack of space.\n"
+        "# TYPE beehive_eggs_skipped_total counter\n"
+        "beehive_eggs_skipped_total %lu\n"
+        "# HELP beehive_transits_total Passages through an entrance, in either direction.\n"
+        "# TYPE beehive_transits_total counter\n"
+        "beehive_transits_total{entrance=\"0\"} %lu\n"
+        "beehive_transits_total{entrance=\"1\"} %lu\n"
+        "# HELP beehive_entries_total Successful entries into the hive.\n"
+        "# TYPE beehive_entries_total counter\n"
+        "beehive_entries_total %d\n"
+        "# HELP beehive_rejections_total Entry attempts refused because the hive was full.\n"
+        "# TYPE beehive_rejections_total counter\n"
+        "beehive_rejections_total %d\n"
+        "# HELP beehive_deaths_total Bees that died.\n"
+        "# TYPE beehive_deaths_total counter\n"
+        "beehive_deaths_total %d\n",
+        READ_COUNTER(hive->currentBeesInHive), N, N > 0 ? calculateP(N) : 0,
+        READ_COUNTER(hive->beesWaiting[0]), READ_COUNTER(hive->beesWaiting[1]),
+        READ_COUNTER(hive->beesAlive), READ_COUNTER(hive->eggsLaid), READ_COUNTER(hive->eggsSkipped),
+        READ_COUNTER(hive->transits[0]), READ_COUNTER(hive->transits[1]),
+        READ_COUNTER(hive->entries), READ_COUNTER(hive->rejections), READ_COUNTER(hive->deaths));
+
+    // Attached frames, and removed ones until they are drained
+    int frameCount = READ_COUNTER(hive->frameCount);
+    for (int section = 0; section < 2 && len < (int)size; section++) {
+        len += snprintf(buffer + len, size - (size_t)len, section == 0 ?
+                        "# HELP beehive_frame_occupancy Bees on a frame of the hive.\n# TYPE beehive_frame_occupancy gauge\n" :
+                        "# HELP beehive_frame_capacity Bees a frame takes (0 while it drains).\n# TYPE beehive_frame_capacity gauge\n");
+        for (int f = 0; f < HIVE_MAX_FRAMES && len < (int)size; f++) {
+            int bees = READ_COUNTER(hive->frames[f].bees);
+            if (f >= frameCount && bees == 0) continue;
+            len += snprintf(buffer + len, size - (size_t)len, "beehive_frame_%s{frame=\"%d\"} %d\n",
+                            section == 0 ? "occupancy" : "capacity", f,
+                            section == 0 ? bees : READ_COUNTER(hive->frames[f].capacity));
+        }
+    }
+    return len < (int)size ? len : (int)size - 1;
+}
+
+/**
+ * answerScrape:
+ * Answers a complete request: the metrics for GET /metrics (or /), 404 for any other path.
+ *
+ * @param exporter The exporter.
+ * @param client The connection.
+ */
+static void answerScrape(Exporter* exporter, const Client* client) {
+    char body[16384];
+    int bodyLength = 0;
+    const char* status = "404 Not Found";
+    if (strncmp(client->request, "GET /metrics ", 13) == 0 || strncmp(client->request, "GET / ", 6) == 0) {
+        status = "200 OK";
+        bodyLength = formatMetrics(exporter->hive, body, sizeof(body));
+    }
+
+    char response[sizeof(body) + 256];
+    int responseLength = snprintf(response, sizeof(response),
+                                  "HTTP/1.0 %s\r\n"
+                                  "Content-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %d\r\n"
+                                  "Connection: close\r\n\r\n"
+                                  "%.*s",
+                                  status, bodyLength, bodyLength, body);
+    // The response fits in the socket buffer of a fresh connection
+    send(client->fd, response, (size_t)responseLength, MSG_NOSIGNAL);
+}
+
+/**
+ * Adds the listening socket to the epoll set or takes it out. It stays readable while
+ * connections wait in the backlog, so it is left out while no entry is free to accept them:
+ * otherwise every wait on the set would return at once until a connection is dropped.
+ */
+static void watchListener(Exporter* exporter, bool accepting) {
+    if (exporter->accepting == accepting) return;
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(exporter->epfd, accepting ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, exporter->fd, &ev) == 0) {
+        exporter->accepting = accepting;
+    }
+}
+
+/**
+ * Closes a connection and frees its entry.
+ */
+static void dropClient(Exporter* exporter, Client* client) {
+    epoll_ctl(exporter->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    exporter->clientCount--;
+}
+
+/**
+ * readRequest:
+ * Reads what has arrived of a request without waiting for more.
+ *
+ * @param client The connection.
+ * @return true once the request is complete (or can grow no further), false while more is expected.
+ */
+static bool readRequest(Client* client) {
+    while (client->length < sizeof(client->request) - 1) {
+        ssize_t got = recv(client->fd, client->request + client->length, sizeof(client->request) - 1 - client->length, 0);
+        if (got == -1 && errno == EINTR) continue;
+        if (got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+        if (got <= 0) return true; // End of file or error: answer what there is
+        client->length += (size_t)got;
+        client->request[client->length] = '\0';
+        if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")) return true;
+    }
+    return true;
+}
+
+void exporterService(Exporter* exporter) {
+    double now = monotonicSeconds();
+
+    // New connections, as many as there are free entries; the rest wait in the backlog
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS && exporter->clientCount < EXPORTER_MAX_CLIENTS; i++) {
+        Client* client = &exporter->clients[i];
+        if (client->fd != -1) continue;
+        int fd = accept4(exporter->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) break;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = client};
+        if (epoll_ctl(exporter->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            close(fd);
+            continue;
+        }
+        *client = (Client){fd, now + EXPORTER_REQUEST_TIMEOUT_MS / 1000.0, 0, {0}};
+        exporter->clientCount++;
+    }
+
+    // Every request gets one deadline, however its bytes trickle in
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+        Client* client = &exporter->clients[i];
+        if (client->fd == -1) continue;
+        if (readRequest(client)) {
+            answerScrape(exporter, client);
+            dropClient(exporter, client);
+        } else if (now >= client->deadline) {
+            dropClient(exporter, client);
+        }
+    }
+    watchListener(exporter, exporter->clientCount < EXPORTER_MAX_CLIENTS);
+}
+
+int exporterFd(const Exporter* exporter) {
+    return exporter->epfd;
+}
+
+void exporterDestroy(Exporter* exporter) {
+    for (int i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+        if (exporter->clients[i].fd != -1) close(exporter->clients[i].fd);
+    }
+    close(exporter->epfd);
+    close(exporter->fd);
+    if (exporter->path[0]) {
+        unlink(exporter->path);
+    }
+    free(exporter);
+}
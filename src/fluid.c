@@ -0,0 +1,359 @@
+#include "fluid.h"
+#include "common.h"
+#include <math.h>
+
+/**
+ * Number of Erlang stages used for the time spent outside and inside. A single
+ * exponential stage would let bees leave the hive long before T_inHive; with several
+ * stages the residence times are concentrated around their means like in beeWorker.
+ */
+#define FLUID_STAGES 4
+
+/**
+ * Layout of the state vector integrated by the solver (S = FLUID_STAGES, V = maxVisits):
+ * [0, S]                          newborns inside the hive, then queued for their first exit
+ * visit block k at S+1 + k(2S+2): S outside stages, queue to enter, S inside stages, queue to leave
+ * [S+1 + V(2S+2)]                 dead
+ * followed by accumulators: eggs laid, rejected attempts, all attempts
+ */
+#define BLOCK (2 * FLUID_STAGES + 2)
+#define FIRST_BLOCK (FLUID_STAGES + 1)
+#define IDX_NEWBORN(s) (s)
+#define IDX_NEWBORN_EXIT FLUID_STAGES
+#define IDX_OUT(k, s) (FIRST_BLOCK + (k) * BLOCK + (s))
+#define IDX_QUEUE(k) (FIRST_BLOCK + (k) * BLOCK + FLUID_STAGES)
+#define IDX_IN(k, s) (FIRST_BLOCK + (k) * BLOCK + FLUID_STAGES + 1 + (s))
+#define IDX_EXIT(k) (FIRST_BLOCK + (k) * BLOCK + 2 * FLUID_STAGES + 1)
+#define IDX_DEAD(V) (FIRST_BLOCK + (V) * BLOCK)
+#define IDX_EGGS(V) (IDX_DEAD(V) + 1)
+#define IDX_REJECTED(V) (IDX_DEAD(V) + 2)
+#define IDX_ATTEMPTS(V) (IDX_DEAD(V) + 3)
+#define STATE_SIZE(V) (IDX_DEAD(V) + 4)
+
+/**
+ * Clamps x to [0, 1]. Used as a smooth (one bee wide) version of the
+ * threshold tests performed by beeWorker and queenWorker.
+ */
+static double unitClamp(double x) {
+    return x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x);
+}
+
+/**
+ * erlangLoss:
+ * Treats the hive as an Erlang loss system: P places offered a load of `offered` bees
+ * (arrival rate times stay), every arrival that finds all places taken being refused.
+ * The occupancy then follows a Poisson distribution truncated at P, so the hive is full
+ * part of the time even when it is not full on average, which is what refuses bees in
+ * beeWorker. The sum runs backwards from P over the terms p(P - j) / p(P) and stops once
+ * they no longer matter, which takes about sqrt(P) terms when the hive is nearly full
+ * and only a few otherwise.
+ *
+ * @param P Places in the hive, calculateP(N).
+ * @param offered Offered load in bees.
+ * @param room Free places asked for.
+ * @param full Receives the probability that every place is taken (Erlang B).
+ * @param crowded Receives the probability that fewer than `room` places are free.
+ */
+static void erlangLoss(int P, double offered, int room, double* full, double* crowded) {
+    if (P <= 0) {
+        *full = *crowded = 1.0;
+        return;
+    }
+    if (offered <= 0.0) {
+        *full = 0.0;
+        *crowded = room > P ? 1.0 : 0.0;
+        return;
+    }
+    double term = 1.0, sum = 1.0, head = room > 0 ? 1.0 : 0.0;
+    for (int j = 1; j <= P; j++) {
+        term *= (P - j + 1) / offered;
+        sum += term;
+        if (j < room) head += term;
+        if (sum > 1e200) {
+            term *= 1e-200;
+            sum *= 1e-200;
+            head *= 1e-200;
+        }
+        // Done once the remaining terms, or both probabilities, are negligible
+        if (j >= room && (term < 1e-12 * sum || head < 1e-12 * sum)) break;
+    }
+    *full = 1.0 / sum;
+    *crowded = head / sum;
+}
+
+/**
+ * occupancyLoss:
+ * Finds the Erlang loss of a hive holding `inside` bees on average while `attempts` bees
+ * per second try to get in: the offered load is what is carried plus what is refused,
+ * inside + attempts * T_inHive * full, solved by fixed-point iteration from inside.
+ */
+static void occupancyLoss(const FluidConfig* c, int P, double inside, double attempts, double* full, double* crowded) {
+    double offered = inside;
+    for (int i = 0; i < 8; i++) {
+        erlangLoss(P, offered, (int)c->eggsCount, full, crowded);
+        double next = inside + attempts * c->T_inHive * *full;
+        if (fabs(next - offered) < 1e-9) break;
+        offered = next;
+    }
+}
+
+/**
+ * Mean time a bee spends outside between visits.
+ */
+static double meanOutside(const FluidConfig* c) {
+    return 0.5 * (c->minOutside + c->maxOutside);
+}
+
+/**
+ * Sums the populations of the colony: bees inside the hive (including those queued
+ * to leave), outside, and queued to enter.
+ */
+static void totals(const FluidConfig* c, const double* y, double* inside, double* outside, double* queued) {
+    *inside = *outside = *queued = 0.0;
+    for (int s = 0; s <= FLUID_STAGES; s++) *inside += y[IDX_NEWBORN(s)];
+    for (int k = 0; k < c->maxVisits; k++) {
+        *queued += y[IDX_QUEUE(k)];
+        *inside += y[IDX_EXIT(k)];
+        for (int s = 0; s < FLUID_STAGES; s++) {
+            *outside += y[IDX_OUT(k, s)];
+            *inside += y[IDX_IN(k, s)];
+        }
+    }
+}
+
+/**
+ * derivatives:
+ * Evaluates the right-hand side of the fluid model.
+ *
+ * - Bees pass through the outside stages in meanOutside seconds on average and queue.
+ * - Queued bees are served at the entrance throughput; the fraction that finds the hive
+ *   full (the Erlang loss of erlangLoss) is refused and flies out again (the
+ *   calculateP(N) check).
+ * - Bees pass through the inside stages in T_inHive seconds and queue to leave;
+ *   leaving after the last visit is death.
+ * - Entries and exits share transitsPerSecond, as every transit holds the hive lock;
+ *   when it saturates, each queued bee gets an equal share of the transits.
+ * - The queen lays eggsCount / T_k bees per second while a whole batch fits into the
+ *   free space, again as a probability of the Erlang loss system, and the colony stays
+ *   within N bees.
+ *
+ * @param c Model parameters.
+ * @param y Current state.
+ * @param dy Receives the time derivative of the state.
+ * @param birthRate Receives the queen's laying rate (may be NULL).
+ */
+static void derivatives(const FluidConfig* c, const double* y, double* dy, double* birthRate) {
+    const int V = c->maxVisits;
+    const int S = FLUID_STAGES;
+    const int P = calculateP((int)c->N);
+    const double rOut = S / meanOutside(c);
+    const double rIn = S / c->T_inHive;
+    const double G = c->transitsPerSecond;
+
+    double inside, outside, queued;
+    totals(c, y, &inside, &outside, &queued);
+    double alive = inside + outside + queued;
+
+    double leaving = y[IDX_NEWBORN_EXIT];
+    for (int k = 0; k < V; k++) leaving += y[IDX_EXIT(k)];
+    double wantExit = leaving * G;
+    // Bees reach the front of the queues as fast as the transits allow; those that find
+    // the hive full are refused there without using a transit
+    double reach = (queued * G + wantExit > G) ? G / (queued * G + wantExit) : 1.0;
+    double full, crowded;
+    occupancyLoss(c, P, inside, queued * G * reach, &full, &crowded);
+    double space = 1.0 - full;
+    double wantEnter = queued * G * space;
+    double share = (wantEnter + wantExit > G) ? G / (wantEnter + wantExit) : 1.0;
+
+    double b = c->eggsCount / c->T_k * (1.0 - crowded) * unitClamp(c->N - alive - c->eggsCount + 1.0);
+    if (birthRate) *birthRate = b;
+
+    // Newborns rest inside, then leave without completing a visit
+    dy[IDX_NEWBORN(0)] = b - y[IDX_NEWBORN(0)] * rIn;
+    for (int s = 1; s < S; s++) {
+        dy[IDX_NEWBORN(s)] = (y[IDX_NEWBORN(s - 1)] - y[IDX_NEWBORN(s)]) * rIn;
+    }
+    double exitPrev = y[IDX_NEWBORN_EXIT] * G * share;
+    dy[IDX_NEWBORN_EXIT] = y[IDX_NEWBORN(S - 1)] * rIn - exitPrev;
+
+    double rejectedTotal = 0.0, attemptsTotal = 0.0;
+    for (int k = 0; k < V; k++) {
+        double served = y[IDX_QUEUE(k)] * G * space * share;
+        double rejected = y[IDX_QUEUE(k)] * G * full * share;
+
+        dy[IDX_OUT(k, 0)] = exitPrev + rejected - y[IDX_OUT(k, 0)] * rOut;
+        for (int s = 1; s < S; s++) {
+            dy[IDX_OUT(k, s)] = (y[IDX_OUT(k, s - 1)] - y[IDX_OUT(k, s)]) * rOut;
+        }
+        dy[IDX_QUEUE(k)] = y[IDX_OUT(k, S - 1)] * rOut - served - rejected;
+
+        dy[IDX_IN(k, 0)] = served - y[IDX_IN(k, 0)] * rIn;
+        for (int s = 1; s < S; s++) {
+            dy[IDX_IN(k, s)] = (y[IDX_IN(k, s - 1)] - y[IDX_IN(k, s)]) * rIn;
+        }
+        double exiting = y[IDX_EXIT(k)] * G * share;
+        dy[IDX_EXIT(k)] = y[IDX_IN(k, S - 1)] * rIn - exiting;
+
+        rejectedTotal += rejected;
+        attemptsTotal += served + rejected;
+        exitPrev = exiting;
+    }
+    dy[IDX_DEAD(V)] = exitPrev;
+    dy[IDX_EGGS(V)] = b;
+    dy[IDX_REJECTED(V)] = rejectedTotal;
+    dy[IDX_ATTEMPTS(V)] = attemptsTotal;
+}
+
+/**
+ * Fills a sample from the state vector. scratch receives the derivatives
+ * evaluated to obtain the current birth rate.
+ */
+static void sampleState(const FluidConfig* c, const double* y, double* scratch, double t, FluidSample* s) {
+    s->t = t;
+    totals(c, y, &s->inside, &s->outside, &s->queued);
+    s->dead = y[IDX_DEAD(c->maxVisits)];
+    derivatives(c, y, scratch, &s->birthRate);
+}
+
+void fluidDefaultConfig(FluidConfig* config) {
+    config->N = 10;
+    config->T_k = 5;
+    config->eggsCount = 2;
+    config->maxVisits = MAX_BEE_VISITS;
+    config->T_inHive = T_IN_HIVE;
+    config->minOutside = MIN_OUTSIDE_TIME;
+    config->maxOutside = MAX_OUTSIDE_TIME;
+    config->transitsPerSecond = 10.0;
+    config->horizon = 600.0;
+    config->dt = 0.05;
+}
+
+bool fluidValidConfig(const FluidConfig* c) {
+    return c->N > 0 && c->T_k > 0 && c->eggsCount > 0 && c->maxVisits > 0 && c->T_inHive > 0 &&
+           c->minOutside >= 0 && c->maxOutside >= c->minOutside && meanOutside(c) > 0 &&
+           c->transitsPerSecond > 0 && c->horizon >= 0 && c->dt > 0;
+}
+
+int fluidSolve(const FluidConfig* c, FluidSample* samples, int maxSamples, FluidSummary* summary) {
+    if (!fluidValidConfig(c)) {
+        return -1;
+    }
+
+    const int V = c->maxVisits;
+    const int n = STATE_SIZE(V);
+    double* work = calloc(6 * n, sizeof(double));
+    if (!work) return -1;
+    double *y = work, *k1 = work + n, *k2 = work + 2 * n, *k3 = work + 3 * n, *k4 = work + 4 * n, *tmp = work + 5 * n;
+
+    // Initial state of main.c: N bees outside, spread over their flight times
+    for (int s = 0; s < FLUID_STAGES; s++) y[IDX_OUT(0, s)] = c->N / FLUID_STAGES;
+
+    int written = 0;
+    double insideIntegral = 0.0;
+    double prevInside = 0.0;
+    long steps = (long)(c->horizon / c->dt + 0.5);
+    long perSample = (long)(1.0 / c->dt + 0.5);
+    if (perSample < 1) perSample = 1;
+
+    for (long i = 0; i <= steps; i++) {
+        double t = i * c->dt;
+        if (samples && written < maxSamples && i % perSample == 0) {
+            sampleState(c, y, tmp, t, &samples[written++]);
+        }
+        if (i == steps) break;
+
+        double h = c->dt;
+        derivatives(c, y, k1, NULL);
+        for (int j = 0; j < n; j++) tmp[j] = y[j] + 0.5 * h * k1[j];
+        derivatives(c, tmp, k2, NULL);
+        for (int j = 0; j < n; j++) tmp[j] = y[j] + 0.5 * h * k2[j];
+        derivatives(c, tmp, k3, NULL);
+        for (int j = 0; j < n; j++) tmp[j] = y[j] + h * k3[j];
+        derivatives(c, tmp, k4, NULL);
+        for (int j = 0; j < n; j++) {
+            y[j] += h / 6.0 * (k1[j] + 2.0 * k2[j] + 2.0 * k3[j] + k4[j]);
+            if (y[j] < 0.0) y[j] = 0.0;
+        }
+
+        double inside, outside, queued;
+        totals(c, y, &inside, &outside, &queued);
+        insideIntegral += 0.5 * h * (prevInside + inside);
+        prevInside = inside;
+    }
+
+    if (summary) {
+        double inside, outside, queued;
+        totals(c, y, &inside, &outside, &queued);
+        summary->meanInside = c->horizon > 0 ? insideIntegral / c->horizon : 0.0;
+        summary->finalAlive = inside + outside + queued;
+        summary->eggsLaid = y[IDX_EGGS(V)];
+        summary->rejectionRate = y[IDX_ATTEMPTS(V)] > 0 ? y[IDX_REJECTED(V)] / y[IDX_ATTEMPTS(V)] : 0.0;
+    }
+
+    free(work);
+    return written;
+}
+
+/**
+ * Steady-state chance that the queen finds room for a batch when the colony has
+ * `birthRate` births per second, with the hive as an Erlang loss system. Also gives the
+ * fraction of entry attempts refused.
+ */
+static double layingChance(const FluidConfig* c, int P, double birthRate, double* refused) {
+    double full, crowded;
+    occupancyLoss(c, P, birthRate * c->T_inHive * (c->maxVisits + 1), birthRate * c->maxVisits, &full, &crowded);
+    if (refused) *refused = full;
+    return 1.0 - crowded;
+}
+
+int fluidEquilibrium(const FluidConfig* c, FluidEquilibrium* eq) {
+    if (!fluidValidConfig(c)) {
+        return -1;
+    }
+    const int V = c->maxVisits;
+    const int P = calculateP((int)c->N);
+
+    // Little's law: a bee lives one newborn stay plus V visits, and is inside V + 1 times
+    double lifetime = c->T_inHive + V * (meanOutside(c) + c->T_inHive);
+    double insidePerBirth = c->T_inHive * (V + 1);
+
+    double byLaying = c->eggsCount / c->T_k;
+    double byPopulation = (c->N - c->eggsCount) / lifetime;
+    double byTransits = c->transitsPerSecond / (2 * V + 1);
+
+    eq->birthRate = byLaying;
+    eq->binding = "laying";
+    if (byPopulation < eq->birthRate) {
+        eq->birthRate = byPopulation;
+        eq->binding = "population";
+    }
+    if (byTransits < eq->birthRate) {
+        eq->birthRate = byTransits;
+        eq->binding = "transits";
+    }
+    if (eq->birthRate < 0) eq->birthRate = 0;
+
+    // The queen skips cycles while the hive is too crowded for a batch: the rate at which
+    // the laying she manages balances the births is found by bisection
+    if (byLaying * layingChance(c, P, eq->birthRate, NULL) < eq->birthRate) {
+        double low = 0.0, high = eq->birthRate;
+        for (int i = 0; i < 60; i++) {
+            double mid = 0.5 * (low + high);
+            if (byLaying * layingChance(c, P, mid, NULL) < mid) high = mid;
+            else low = mid;
+        }
+        eq->birthRate = low;
+        eq->binding = "capacity";
+    }
+    layingChance(c, P, eq->birthRate, &eq->rejectionRate);
+
+    eq->alive = eq->birthRate * lifetime;
+    eq->inside = eq->birthRate * insidePerBirth;
+    if (eq->birthRate == byTransits) {
+        // Saturated entrances: queues absorb bees until the population limit stops the queen
+        eq->alive = c->N - c->eggsCount;
+    }
+    eq->utilization = P > 0 ? eq->inside / P : 0.0;
+    return 0;
+}
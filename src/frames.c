@@ -0,0 +1,78 @@
+#include "frames.h"
+#include "hivelock.h"
+
+void framesLayout(HiveData* hive) {
+    int capacity = hive->N > 0 ? calculateP(hive->N) : 0;
+    if (capacity < 0) capacity = 0;
+
+    int count = (capacity + HIVE_FRAME_BEES - 1) / HIVE_FRAME_BEES;
+    if (count < 1) count = 1;
+    if (count > HIVE_MAX_FRAMES) count = HIVE_MAX_FRAMES;
+
+    // The capacities add up to calculateP(N) exactly
+    for (int f = 0; f < HIVE_MAX_FRAMES; f++) {
+        int share = f < count ? capacity / count + (f < capacity % count) : 0;
+        __atomic_store_n(&hive->frames[f].capacity, share, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&hive->frameCount, count, __ATOMIC_RELAXED);
+}
+
+int framesResize(HiveData* hive, HiveSemaphores* semaphores) {
+    if (lockAllFrames(semaphores) == -1) {
+        return -1;
+    }
+    int before = hive->frameCount;
+    framesLayout(hive);
+    int after = hive->frameCount;
+    unlockAllFrames(semaphores);
+
+    if (after > before) {
+        logMessage(LOG_INFO, "[Frames] Attached %d frames (%d in the hive).", after - before, after);
+    } else if (after < before) {
+        logMessage(LOG_INFO, "[Frames] Draining %d frames (%d in the hive).", before - after, after);
+    }
+    return 0;
+}
+
+/**
+ * frameHasRoom:
+ * Tells whether a frame takes one more bee (relaxed reads; exact under the frame lock).
+ */
+static bool frameHasRoom(const HiveData* hive, int frame) {
+    return __atomic_load_n(&hive->frames[frame].bees, __ATOMIC_RELAXED) <
+           __atomic_load_n(&hive->frames[frame].capacity, __ATOMIC_RELAXED);
+}
+
+int lockFreeFrame(HiveData* hive, HiveSemaphores* semaphores, int home, int* frame) {
+    int count = __atomic_load_n(&hive->frameCount, __ATOMIC_RELAXED);
+    int start = home % count;
+
+    // home, home + 1, home - 1, home + 2, ...: bees spread out from where they were
+    for (int step = 0; step < count; step++) {
+        int offset = (step + 1) / 2;
+        int f = (step % 2 == 1) ? start + offset : start - offset;
+        f = ((f % count) + count) % count;
+        if (!frameHasRoom(hive, f)) continue;
+
+        if (lockFrame(semaphores, f) == -1) {
+            return -1;
+        }
+        if (frameHasRoom(hive, f)) {
+            *frame = f;
+            return 0;
+        }
+        unlockFrame(semaphores, f);
+    }
+    *frame = -1;
+    return 0;
+}
+
+int frameEnter(HiveData* hive, int frame) {
+    __atomic_store_n(&hive->frames[frame].bees, hive->frames[frame].bees + 1, __ATOMIC_RELAXED);
+    return __atomic_add_fetch(&hive->currentBeesInHive, 1, __ATOMIC_RELAXED);
+}
+
+int frameLeave(HiveData* hive, int frame) {
+    __atomic_store_n(&hive->frames[frame].bees, hive->frames[frame].bees - 1, __ATOMIC_RELAXED);
+    return __atomic_sub_fetch(&hive->currentBeesInHive, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include "hivelock.h"
+#include "cohorts.h"
+#include <sched.h>
+
+int robustLockInit(pthread_mutex_t* lock) {
+    pthread_mutexattr_t attr;
+    int rc = pthread_mutexattr_init(&attr);
+    if (rc == 0) rc = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    if (rc == 0) rc = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (rc == 0) rc = pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+int robustLock(pthread_mutex_t* lock, HiveSemaphores* semaphores) {
+    int rc = pthread_mutex_lock(lock);
+    if (rc == EOWNERDEAD) {
+        // The owner died inside its critical section; whatever it guarded is repaired under the hive lock
+        __atomic_add_fetch(&semaphores->ownerDeaths, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&semaphores->repairPending, 1, __ATOMIC_RELEASE);
+        rc = pthread_mutex_consistent(lock);
+    }
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+int robustUnlock(pthread_mutex_t* lock) {
+    int rc = pthread_mutex_unlock(lock);
+    if (rc != 0) {
+        errno = rc;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * processAlive:
+ * Checks whether a process is still running. Zombies count as dead: a bee that was
+ * killed but not yet reaped by its parent must not be counted.
+ *
+ * @param pid Process to check.
+ * @return true if the process exists and is not a zombie.
+ */
+static bool processAlive(pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* stat = fopen(path, "r");
+    if (!stat) {
+        return kill(pid, 0) == 0 || errno == EPERM;
+    }
+
+    char buffer[512];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, stat);
+    fclose(stat);
+    buffer[length] = '\0';
+
+    // The state follows the command name, which is enclosed in parentheses and may contain spaces
+    char* end = strrchr(buffer, ')');
+    return !end || (end[1] == ' ' && end[2] != 'Z' && end[2] != 'X');
+}
+
+/**
+ * repairHive:
+ * Recomputes the HiveData counters from the per-bee state table after a lock owner died.
+ * Slots of bees whose processes are gone are released first, so whatever the dead bee
+ * left half-updated is dropped together with it.
+ *
+ * @param hive Shared hive state to repair (hive lock held).
+ * @param table Per-bee state table.
+ */
+static void repairHive(HiveData* hive, BeeTable* table) {
+    int alive = 0, inside = 0, waiting[2] = {0, 0}, reclaimed = 0;
+    int frameBees[HIVE_MAX_FRAMES] = {0};
+
+    for (uint64_t i = 0; i < table->capacity; i++) {
+        BeeSlot* s = &table->slots[i];
+        uint8_t state = __atomic_load_n(&s->state, __ATOMIC_ACQUIRE);
+        if (state == BEE_SLOT_FREE) continue;
+
+        // Slots of bees that have not started yet (pid 0) belong to the living
+        pid_t pid = __atomic_load_n(&s->pid, __ATOMIC_ACQUIRE);
+        if (pid != 0 && !processAlive(pid)) {
+            logMessage(LOG_WARNING, "[Recovery] Bee %d (pid %d) is gone; releasing its slot.", s->id, (int)pid);
+            cohortRecord(hive, s, true);
+            beeTableRelease(table, (int)i);
+            reclaimed++;
+            continue;
+        }
+
+        alive++;
+        if (state == BEE_SLOT_INSIDE || state == BEE_SLOT_QUEUED_OUT) {
+            inside++;
+            frameBees[s->frame % HIVE_MAX_FRAMES]++;
+        }
+        if (state == BEE_SLOT_QUEUED_IN || state == BEE_SLOT_QUEUED_OUT) waiting[s->entrance & 1]++;
+    }
+
+    // A bee holding several locks at its death flags the repair more than once; only report real changes
+    bool changed = alive != hive->beesAlive || inside != hive->currentBeesInHive ||
+                   waiting[0] != hive->beesWaiting[0] || waiting[1] != hive->beesWaiting[1];
+    for (int f = 0; f < HIVE_MAX_FRAMES; f++) {
+        if (frameBees[f] != hive->frames[f].bees) changed = true;
+        hive->frames[f].bees = frameBees[f];
+    }
+    logMessage(changed ? LOG_WARNING : LOG_DEBUG,
+               "[Recovery] Repaired hive counters: alive %d -> %d, in hive %d -> %d, waiting %d/%d -> %d/%d (%d slots reclaimed).",
+               hive->beesAlive, alive, hive->currentBeesInHive, inside,
+               hive->beesWaiting[0], hive->beesWaiting[1], waiting[0], waiting[1], reclaimed);
+    hive->deaths += reclaimed;
+    hive->beesAlive = alive;
+    hive->currentBeesInHive = inside;
+    hive->beesWaiting[0] = waiting[0];
+    hive->beesWaiting[1] = waiting[1];
+}
+
+void requestHiveRepair(HiveSemaphores* semaphores) {
+    __atomic_store_n(&semaphores->repairPending, 1, __ATOMIC_RELEASE);
+}
+
+void requestShutdown(HiveSemaphores* semaphores) {
+    if (!__atomic_exchange_n(&semaphores->shutdown, 1, __ATOMIC_ACQ_REL)) {
+        sem_post(&semaphores->queenWake);
+    }
+}
+
+bool shutdownRequested(const HiveSemaphores* semaphores) {
+    return __atomic_load_n(&semaphores->shutdown, __ATOMIC_ACQUIRE) != 0;
+}
+
+/**
+ * countAcquisition:
+ * Counts an acquisition of a lock by the NUMA node of the calling CPU. Every change of node
+ * between holders moves the lock and the data it guards across the interconnect.
+ * Called with the lock held.
+ *
+ * @param acquisitions Per-node acquisition counters of the lock.
+ * @param handoffs Handoff counter of the lock.
+ * @param lastNode Node of the previous holder, or -1.
+ */
+static void countAcquisition(unsigned long* acquisitions, unsigned long* handoffs, int* lastNode) {
+    unsigned int cpu, node;
+    if (getcpu(&cpu, &node) == 0) {
+        if (node >= HIVE_MAX_NODES) node = HIVE_MAX_NODES - 1;
+        acquisitions[node]++;
+        if (*lastNode != -1 && *lastNode != (int)node) (*handoffs)++;
+        *lastNode = (int)node;
+    }
+}
+
+int lockHive(HiveSemaphores* semaphores, HiveData* hive, BeeTable* table) {
+    if (robustLock(&semaphores->hiveSem, semaphores) == -1) {
+        return -1;
+    }
+    if (__atomic_exchange_n(&semaphores->repairPending, 0, __ATOMIC_ACQ_REL)) {
+        // Bees enter, leave and queue under the frame locks alone; hold them all for the recount
+        if (lockAllFrames(semaphores) == 0) {
+            repairHive(hive, table);
+            unlockAllFrames(semaphores);
+        } else {
+            requestHiveRepair(semaphores);
+        }
+    }
+    countAcquisition(hive->lockAcquisitions, &hive->crossNodeHandoffs, &hive->lastLockNode);
+    return 0;
+}
+
+int lockFrame(HiveSemaphores* semaphores, int frame) {
+    HiveFrameLock* frameLock = &semaphores->frameSem[frame];
+    if (robustLock(&frameLock->lock, semaphores) == -1) {
+        return -1;
+    }
+    countAcquisition(frameLock->acquisitions, &frameLock->crossNodeHandoffs, &frameLock->lastNode);
+    return 0;
+}
+
+int unlockFrame(HiveSemaphores* semaphores, int frame) {
+    return robustUnlock(&semaphores->frameSem[frame].lock);
+}
+
+int lockAllFrames(HiveSemaphores* semaphores) {
+    for (int f = 0; f < HIVE_MAX_FRAMES; f++) {
+        if (lockFrame(semaphores, f) == -1) {
+            int saved = errno;
+            while (f-- > 0) unlockFrame(semaphores, f);
+            errno = saved;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void unlockAllFrames(HiveSemaphores* semaphores) {
+    for (int f = HIVE_MAX_FRAMES - 1; f >= 0; f--) {
+        unlockFrame(semaphores, f);
+    }
+}
@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+#include "logfile.h"
+#include <dirent.h>
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <zlib.h>
+
+/**
+ * Interval (in milliseconds) at which the compressor looks for closed segments when the
+ * directory cannot be watched with inotify.
+ */
+#define LOG_COMPRESSOR_POLL_MS 1000
+
+// Log file of this process, opened on first use and reopened after every rotation
+static int logFd = -1;
+static pthread_mutex_t logFileLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t forkHandlersOnce = PTHREAD_ONCE_INIT;
+
+// Compressor thread and the pipe that stops it
+static pthread_t compressorThread;
+static int compressorStop[2] = {-1, -1};
+
+static void lockLogFile(void) {
+    pthread_mutex_lock(&logFileLock);
+}
+
+static void unlockLogFile(void) {
+    pthread_mutex_unlock(&logFileLock);
+}
+
+/**
+ * Gives a forked child a log file descriptor of its own. flock locks belong to the open
+ * file description, so a descriptor shared with the parent could not exclude it. The
+ * compressor thread is not copied by fork, so the child forgets it too.
+ */
+static void forgetLogFile(void) {
+    if (logFd != -1) {
+        close(logFd);
+        logFd = -1;
+    }
+    if (compressorStop[0] != -1) {
+        close(compressorStop[0]);
+        close(compressorStop[1]);
+        compressorStop[0] = compressorStop[1] = -1;
+    }
+    unlockLogFile();
+}
+
+static void registerForkHandlers(void) {
+    pthread_atfork(lockLogFile, unlockLogFile, forgetLogFile);
+}
+
+/**
+ * Returns the number of the newest segment recorded in the index, or 0 if there is none.
+ */
+static unsigned long lastSegment(int fd) {
+    unsigned long seq = 0;
+    struct stat st;
+    char tail[128];
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        off_t offset = st.st_size > (off_t)sizeof(tail) - 1 ? st.st_size - (off_t)sizeof(tail) + 1 : 0;
+        ssize_t got = pread(fd, tail, sizeof(tail) - 1, offset);
+        if (got > 0) {
+            tail[got] = '\0';
+            if (tail[got - 1] == '\n') tail[got - 1] = '\0';
+            char* line = strrchr(tail, '\n');
+            seq = strtoul(line ? line + 1 : tail, NULL, 10);
+        }
+    }
+    return seq;
+}
+
+/**
+ * Returns the time of the first message of a log file, read from its timestamp, or 0.
+ */
+static time_t firstMessageTime(int fd) {
+    char head[32];
+    ssize_t got = pread(fd, head, sizeof(head) - 1, 0);
+    if (got <= 0) {
+        return 0;
+    }
+    head[got] = '\0';
+    struct tm t = {0};
+    if (sscanf(head, "[%d-%d-%d %d:%d:%d]", &t.tm_mday, &t.tm_mon, &t.tm_year,
+               &t.tm_hour, &t.tm_min, &t.tm_sec) != 6) {
+        return 0;
+    }
+    t.tm_mon -= 1;
+    t.tm_year -= 1900;
+    t.tm_isdst = -1;
+    return mktime(&t);
+}
+
+/**
+ * Removes the segments (compressed or not) that fall out of the retention window once
+ * segment newest has been closed.
+ */
+static void pruneSegments(const char* path, unsigned long newest) {
+    if (logConfig.keepSegments <= 0 || newest <= (unsigned long)logConfig.keepSegments) {
+        return;
+    }
+    for (unsigned long seq = newest - (unsigned long)logConfig.keepSegments; seq >= 1; seq--) {
+        char segment[PATH_MAX];
+        snprintf(segment, sizeof(segment), "%s.%lu", path, seq);
+        bool removed = unlink(segment) == 0;
+        strncat(segment, ".gz", sizeof(segment) - strlen(segment) - 1);
+        removed = (unlink(segment) == 0) || removed;
+        if (!removed) break; // Older segments are already gone
+    }
+}
+
+/**
+ * rotateLogFile:
+ * Closes the full log file of this process as the next segment, unless another process
+ * rotated it first, and records the segment in the index. Either way the descriptor is
+ * closed, so the next write opens the current file.
+ */
+static void rotateLogFile(void) {
+    const char* path = logConfig.filePath;
+    struct stat current, named;
+    // Writers hold a shared lock, so no message is appended to the file once it is renamed
+    if (flock(logFd, LOCK_EX) == 0 && fstat(logFd, &current) == 0 &&
+        stat(path, &named) == 0 && named.st_dev == current.st_dev && named.st_ino == current.st_ino &&
+        (size_t)current.st_size >= logConfig.segmentSize) {
+        char indexPath[PATH_MAX];
+        char segment[PATH_MAX];
+        snprintf(indexPath, sizeof(indexPath), "%s%s", path, LOG_INDEX_SUFFIX);
+        int index = open(indexPath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+        // The rotation of the next file may start before this one is recorded in the index
+        if (index != -1 && flock(index, LOCK_EX) == 0) {
+            unsigned long seq = lastSegment(index) + 1;
+            snprintf(segment, sizeof(segment), "%s.%lu", path, seq);
+            if (rename(path, segment) == 0) {
+                dprintf(index, "%lu %ld %ld %ld\n", seq, (long)firstMessageTime(logFd),
+                        (long)time(NULL), (long)current.st_size);
+                pruneSegments(path, seq);
+            } else {
+                perror("[logFileWrite] Failed to rotate log file");
+            }
+        } else {
+            perror("[logFileWrite] Failed to lock the log index");
+        }
+        if (index != -1) close(index);
+    }
+    close(logFd); // Also releases the lock
+    logFd = -1;
+}
+
+void logFileWrite(const char* line, size_t length) {
+    pthread_once(&forkHandlersOnce, registerForkHandlers);
+    lockLogFile();
+
+    // Every rotation is followed by another attempt on the new file
+    while (1) {
+        if (logFd == -1) {
+            logFd = open(logConfig.filePath, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (logFd == -1) {
+                // If the log file cannot be opened, print an error to stderr
+                perror("[logMessage] Failed to open log file");
+                break;
+            }
+        }
+        if (logConfig.segmentSize == 0) {
+            ssize_t written = write(logFd, line, length);
+            (void)written;
+            break;
+        }
+
+        // A file below the segment size has not been rotated, since rotation only closes full ones
+        struct stat st;
+        flock(logFd, LOCK_SH);
+        if (fstat(logFd, &st) == 0 && (size_t)st.st_size < logConfig.segmentSize) {
+            ssize_t written = write(logFd, line, length);
+            (void)written;
+            flock(logFd, LOCK_UN);
+            break;
+        }
+        flock(logFd, LOCK_UN);
+        rotateLogFile();
+    }
+
+    unlockLogFile();
+}
+
+/**
+ * compressSegment:
+ * Replaces a closed segment by its gzip-compressed copy.
+ *
+ * @param segment Path of the segment.
+ */
+static void compressSegment(const char* segment) {
+    char target[PATH_MAX];
+    char temp[PATH_MAX];
+    snprintf(target, sizeof(target), "%s.gz", segment);
+    snprintf(temp, sizeof(temp), "%s.gz.tmp", segment);
+
+    int in = open(segment, O_RDONLY | O_CLOEXEC);
+    if (in == -1) {
+        return; // Pruned meanwhile
+    }
+    gzFile out = gzopen(temp, "wb");
+    if (!out) {
+        logMessage(LOG_WARNING, "[LogCompressor] Failed to create %s: %s", temp, strerror(errno));
+        close(in);
+        return;
+    }
+
+    char buffer[65536];
+    ssize_t got;
+    bool ok = true;
+    while ((got = read(in, buffer, sizeof(buffer))) > 0) {
+        if (gzwrite(out, buffer, (unsigned)got) != (int)got) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && got == 0;
+    close(in);
+    ok = (gzclose(out) == Z_OK) && ok;
+
+    if (!ok || rename(temp, target) == -1) {
+        logMessage(LOG_WARNING, "[LogCompressor] Failed to compress %s.", segment);
+        unlink(temp);
+        return;
+    }
+    if (unlink(segment) == -1 && errno == ENOENT) {
+        unlink(target); // Pruned while it was being compressed
+    }
+}
+
+/**
+ * compressPendingSegments:
+ * Compresses every segment of the log file that is still plain text.
+ *
+ * @param directory Directory of the log file.
+ * @param base File name of the log file.
+ */
+static void compressPendingSegments(const char* directory, const char* base) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+    size_t baseLength = strlen(base);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+        if (strncmp(name, base, baseLength) != 0 || name[baseLength] != '.') continue;
+        const char* seq = name + baseLength + 1;
+        if (*seq == '\0' || strspn(seq, "0123456789") != strlen(seq)) continue;
+
+        char segment[PATH_MAX];
+        snprintf(segment, sizeof(segment), "%s/%s", directory, name);
+        compressSegment(segment);
+    }
+    closedir(dir);
+}
+
+/**
+ * runCompressor:
+ * Body of the compressor thread: compresses closed segments as they appear, at the lowest
+ * priority, until asked to stop.
+ */
+static void* runCompressor(void* arg) {
+    (void)arg;
+    setpriority(PRIO_PROCESS, (id_t)gettid(), 19);
+
+    char pathCopy[PATH_MAX];
+    char baseCopy[PATH_MAX];
+    snprintf(pathCopy, sizeof(pathCopy), "%s", logConfig.filePath);
+    snprintf(baseCopy, sizeof(baseCopy), "%s", logConfig.filePath);
+    const char* directory = dirname(pathCopy);
+    const char* base = basename(baseCopy);
+
+    // Segments are created by renaming the log file, wherever the rotating process runs
+    int watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch != -1 && inotify_add_watch(watch, directory, IN_MOVED_TO) == -1) {
+        close(watch);
+        watch = -1;
+    }
+
+    while (1) {
+        compressPendingSegments(directory, base);
+
+        struct pollfd fds[2] = {{compressorStop[0], POLLIN, 0}, {watch, POLLIN, 0}};
+        if (poll(fds, watch == -1 ? 1 : 2, watch == -1 ? LOG_COMPRESSOR_POLL_MS : -1) == -1 && errno != EINTR) {
+            break;
+        }
+        if (fds[0].revents) {
+            break;
+        }
+        char events[4096];
+        while (watch != -1 && read(watch, events, sizeof(events)) > 0) {
+        }
+    }
+
+    // Leave nothing uncompressed behind
+    compressPendingSegments(directory, base);
+    if (watch != -1) close(watch);
+    return NULL;
+}
+
+int logCompressorStart(void) {
+    if (!logConfig.logToFile || logConfig.segmentSize == 0 || compressorStop[0] != -1) {
+        return 0;
+    }
+    if (pipe2(compressorStop, O_CLOEXEC) == -1) {
+        compressorStop[0] = compressorStop[1] = -1;
+        return -1;
+    }
+    int error = pthread_create(&compressorThread, NULL, runCompressor, NULL);
+    if (error != 0) {
+        close(compressorStop[0]);
+        close(compressorStop[1]);
+        compressorStop[0] = compressorStop[1] = -1;
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+void logCompressorStop(void) {
+    if (compressorStop[0] == -1) {
+        return;
+    }
+    ssize_t written = write(compressorStop[1], "", 1);
+    (void)written;
+    pthread_join(compressorThread, NULL);
+    close(compressorStop[0]);
+    close(compressorStop[1]);
+    compressorStop[0] = compressorStop[1] = -1;
+}
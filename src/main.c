@@ -1,116 +1,559 @@
-#include "common.h"
-#include "bee.h"
-#include "queen.h"
-#include "beekeeper.h"
-#include <sys/wait.h>
+#define _GNU_SOURCE
+#include "beehive.h"
+#include "beetable.h"
+#include "apiary.h"
+#include "logfile.h"
+#include "cohorts.h"
 #include <signal.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <getopt.h>
+#include <sys/resource.h>
+
+/**
+ * Longest time (in milliseconds) the main loop lets the colony wait before checking the
+ * duration and checkpoint requests again.
+ */
+#define STEP_TIMEOUT_MS 100
+
+/**
+ * Codes of the long-only placement options.
+ */
+enum {
+    OPT_QUEEN_CPU = 256,
+    OPT_KEEPER_CPU,
+    OPT_BEE_CPUS,
+    OPT_BEE_PLACEMENT,
+    OPT_MEM_NODE,
+    OPT_CHECKPOINT_AT,
+    OPT_SPLIT_CPUS,
+    OPT_LOG_SEGMENT,
+    OPT_LOG_KEEP,
+    OPT_EVENTS,
+    OPT_CONFIG
+};
+
+/**
+ * Set by SIGHUP to ask the main loop for a checkpoint.
+ */
+static volatile sig_atomic_t checkpointRequested = 0;
+
+/**
+ * SIGHUP handler: requests a checkpoint of the colony.
+ */
+static void handleCheckpointSignal(int signum) {
+    (void)signum;
+    checkpointRequested = 1;
+}
+
+/**
+ * Set by SIGINT and SIGTERM to stop the simulation.
+ */
+static volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * SIGINT/SIGTERM handler: requests a stop. The main process leads the process group of the
+ * apiary's hive processes, so it passes the first stop signal on to them.
+ */
+static void handleStopSignal(int signum) {
+    if (!stopRequested) {
+        stopRequested = 1;
+        if (getpid() == getpgrp()) kill(0, signum);
+    }
+}
+
+/**
+ * Options of one colony, as parsed from the command line. In an apiary every hive
+ * runs a copy with its own hive index and coordinator socket.
+ */
+typedef struct {
+    int N;
+    int T_k;
+    int eggsCount;
+    int duration;
+    int maxVisits;
+    int T_inHive;
+    const char* summaryPath;
+    int capacity;
+    bool hugePages;
+    int eventCapacity;
+    const char* configPath;
+    double targetUtilization;
+    const char* checkpointPath;
+    double checkpointAt;
+    const char* restorePath;
+    const char* metricsAddress;
+    PlacementConfig placement;
+    int hiveIndex; // Index of the hive in the apiary, or -1 for a standalone colony.
+    int apiaryFd;  // Socket to the apiary coordinator, or -1 for a standalone colony.
+} ColonyConfig;
+
+/**
+ * Prints the command-line usage of the simulation.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <N: initial hive size> <T_k: egg-laying interval> <eggsCount>\n"
+            "Options:\n"
+            "  -d, --duration SECONDS   Stop the simulation after SECONDS (default: run until all bees exit)\n"
+            "  -v, --max-visits COUNT   Visits after which a bee dies (default: %d)\n"
+            "  -t, --time-in-hive SECS  Time a bee spends inside the hive per visit (default: %d)\n"
+            "  -s, --summary FILE       Write run metrics as key=value lines to FILE\n"
+            "  -c, --capacity COUNT     Maximum number of bees alive at once (default: max(N, %d))\n"
+            "  -H, --huge-pages         Back the per-bee state table with huge pages\n"
+            "  --events COUNT           Events kept by the event bus for subscribers (default: %d)\n"
+            "  --config FILE            Load the live parameters from FILE (name = value lines), over the\n"
+            "                           command line; change them while the colony runs with beehive-config\n"
+            "  -a, --adaptive UTIL      Adapt laying interval and batch size to hold occupancy at UTIL\n"
+            "                           (fraction of the hive capacity, e.g. 0.8); eggsCount is the nominal batch\n"
+            "  -C, --checkpoint FILE    Write a checkpoint of the colony to FILE on SIGHUP\n"
+            "  --checkpoint-at SECONDS  Also write it once after SECONDS\n"
+            "  -r, --restore FILE       Resume the colony saved in FILE (N is taken from the checkpoint)\n"
+            "  -A, --apiary HIVES       Run HIVES hives of N bees each and migrate bees between them\n"
+            "                           to balance their populations (summaries go to FILE.<hive>)\n"
+            "  --split-cpus             Give every hive of the apiary an equal share of the CPUs\n"
+            "  -m, --metrics PORT|PATH  Serve hive metrics in Prometheus text format on 127.0.0.1:PORT\n"
+            "                           or a Unix-domain socket (hive h of an apiary: PORT+h, PATH.h)\n"
+            "  -q, --quiet              Disable console logging\n"
+            "  --log-segment SIZE       Rotate beehive.log into gzip-compressed segments of SIZE bytes\n"
+            "                           (suffix K, M or G), indexed in beehive.log.index\n"
+            "  --log-keep COUNT         Keep only the newest COUNT segments (default: all)\n"
+            "Placement:\n"
+            "  --queen-cpu CPU          Pin the queen to CPU\n"
+            "  --keeper-cpu CPU         Pin the beekeeper to CPU\n"
+            "  --bee-cpus LIST          CPUs available to bees, e.g. 0-7,16-23 (default: all)\n"
+            "  --bee-placement MODE     spread: one CPU per bee, alternating NUMA nodes;\n"
+            "                           pack: all bees on the memory node's CPUs of the list\n"
+            "  --mem-node NODE|auto     Bind the shared segments to a NUMA node (auto: node of most bee CPUs)\n",
+            prog, MAX_BEE_VISITS, T_IN_HIVE, BEE_TABLE_DEFAULT_CAPACITY, EVENT_BUS_DEFAULT_CAPACITY);
+}
+
+/**
+ * writeSummary:
+ * Writes the metrics of a finished run to a file as key=value lines.
+ * The format is consumed by beehive_sweep when aggregating parameter sweeps.
+ *
+ * @param path Destination file.
+ * @param status State and statistics of the colony at the end of the run.
+ * @param config Options of the run.
+ */
+static void writeSummary(const char* path, const BeehiveStatus* status, const ColonyConfig* config) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        logMessage(LOG_WARNING, "[MAIN] Failed to open summary file %s: %s", path, strerror(errno));
+        return;
+    }
+
+    int attempts = status->entries + status->rejections;
+    fprintf(out, "N=%d\n", config->N);
+    // The live parameters as they were at the end (see configVersion for whether they changed)
+    fprintf(out, "T_k=%d\n", status->tunables.T_k);
+    fprintf(out, "eggsCount=%d\n", status->tunables.eggsCount);
+    fprintf(out, "maxVisits=%d\n", status->tunables.maxVisits);
+    fprintf(out, "T_inHive=%d\n", status->tunables.T_inHive);
+    fprintf(out, "minOutsideTime=%d\n", status->tunables.minOutsideTime);
+    fprintf(out, "maxOutsideTime=%d\n", status->tunables.maxOutsideTime);
+    fprintf(out, "transitMs=%d\n", status->tunables.transitMs);
+    fprintf(out, "maxBees=%d\n", status->tunables.maxBees);
+    fprintf(out, "configVersion=%lu\n", status->configVersion);
+    fprintf(out, "elapsed=%.2f\n", status->elapsed);
+    fprintf(out, "meanOccupancy=%.3f\n", status->meanOccupancy);
+    fprintf(out, "maxOccupancy=%d\n", status->maxOccupancy);
+    fprintf(out, "entries=%d\n", status->entries);
+    fprintf(out, "rejections=%d\n", status->rejections);
+    fprintf(out, "rejectionRate=%.4f\n", attempts ? (double)status->rejections / attempts : 0.0);
+    fprintf(out, "survivalTime=%.2f\n", status->survivalTime);
+    fprintf(out, "beesAlive=%d\n", status->beesAlive);
+    fprintf(out, "deaths=%d\n", status->deaths);
+    fprintf(out, "emigrations=%d\n", status->emigrations);
+    fprintf(out, "immigrations=%d\n", status->immigrations);
+    fprintf(out, "lockRecoveries=%d\n", status->lockRecoveries);
+    fprintf(out, "beeExits=%d\n", status->beeExits);
+    fprintf(out, "abnormalExits=%d\n", status->abnormalExits);
+    fprintf(out, "meanBeeLifetime=%.2f\n", status->meanBeeLifetime);
+    fprintf(out, "maxBeeLifetime=%.2f\n", status->maxBeeLifetime);
+    for (int node = 0; node < HIVE_MAX_NODES; node++) {
+        if (status->lockAcquisitions[node] > 0) {
+            fprintf(out, "lockAcquisitions.node%d=%lu\n", node, status->lockAcquisitions[node]);
+        }
+    }
+    fprintf(out, "crossNodeHandoffs=%lu\n", status->crossNodeHandoffs);
+    for (int c = 0; c < BEE_COHORTS; c++) {
+        const CohortStats* cohort = &status->cohorts[c];
+        const char* name = cohortName(c);
+        fprintf(out, "cohort.%s.deaths=%ld\n", name, cohort->deaths);
+        fprintf(out, "cohort.%s.abnormal=%ld\n", name, cohort->abnormal);
+        fprintf(out, "cohort.%s.meanVisits=%.3f\n", name, cohort->visits.mean);
+        fprintf(out, "cohort.%s.meanRejections=%.3f\n", name, cohort->rejections.mean);
+        fprintf(out, "cohort.%s.meanQueueTime=%.3f\n", name, cohort->queueTime.mean);
+        fprintf(out, "cohort.%s.meanInsideTime=%.3f\n", name, cohort->insideTime.mean);
+        fprintf(out, "cohort.%s.meanOutsideTime=%.3f\n", name, cohort->outsideTime.mean);
+        fprintf(out, "cohort.%s.meanLifetime=%.3f\n", name, cohort->lifetime.mean);
+        fprintf(out, "cohort.%s.stddevLifetime=%.3f\n", name, runningStatStddev(&cohort->lifetime, cohort->deaths));
+    }
+    fclose(out);
+}
+
+/**
+ * logCohortReport:
+ * Logs the lifetime statistics of the bees that died, one block per cohort: mean,
+ * standard deviation and range of each quantity. Bees still alive at the end are not included.
+ *
+ * @param status Final state of the colony.
+ */
+static void logCohortReport(const BeehiveStatus* status) {
+    for (int c = 0; c < BEE_COHORTS; c++) {
+        const CohortStats* cohort = &status->cohorts[c];
+        if (cohort->deaths == 0) continue;
+
+        logMessage(LOG_INFO, "[MAIN] Cohort %s: %ld bees died (%ld abnormally).", cohortName(c), cohort->deaths, cohort->abnormal);
+        const struct {
+            const char* label;
+            const RunningStat* stat;
+        } rows[] = {
+            {"visits", &cohort->visits},
+            {"rejections", &cohort->rejections},
+            {"queued (s)", &cohort->queueTime},
+            {"inside (s)", &cohort->insideTime},
+            {"outside (s)", &cohort->outsideTime},
+            {"lifetime (s)", &cohort->lifetime},
+        };
+        for (size_t r = 0; r < sizeof(rows) / sizeof(rows[0]); r++) {
+            logMessage(LOG_INFO, "[MAIN]   %-12s mean %8.2f  stddev %8.2f  min %8.2f  max %8.2f", rows[r].label,
+                       rows[r].stat->mean, runningStatStddev(rows[r].stat, cohort->deaths), rows[r].stat->min, rows[r].stat->max);
+        }
+    }
+    logMessage(LOG_INFO, "[MAIN] Bees alive at the end (not in the cohort report): %d", status->beesAlive);
+}
+
+/**
+ * Error callback of the colony: failures are also printed on stderr.
+ */
+static void printColonyError(void* user, const char* message, int errnum) {
+    (void)user;
+    fprintf(stderr, "Error: %s: %s\n", message, strerror(errnum));
+}
+
+/**
+ * runColony:
+ * Runs one colony to completion on top of libbeehive.
+ *
+ * Detailed functionality:
+ * 1. Creates the colony: shared state, queen, beekeeper, and initial bees (or those of a checkpoint).
+ * 2. Steps it until all of its processes exit, the configured duration elapses, or a stop is
+ *    requested with SIGINT or SIGTERM, writing checkpoints when requested.
+ * 3. Stops the colony, logs lock statistics, writes the optional run summary, and releases it.
+ *
+ * @param config Options of the colony.
+ * @return 0 on success, or 1 on failure.
+ */
+static int runColony(const ColonyConfig* config) {
+    BeehiveOptions options;
+    beehiveDefaultOptions(&options);
+    options.N = config->N;
+    options.T_k = config->T_k;
+    options.eggsCount = config->eggsCount;
+    options.maxVisits = config->maxVisits;
+    options.T_inHive = config->T_inHive;
+    options.capacity = config->capacity;
+    options.hugePages = config->hugePages;
+    options.eventCapacity = (size_t)config->eventCapacity;
+    options.configPath = config->configPath;
+    options.targetUtilization = config->targetUtilization;
+    options.restorePath = config->restorePath;
+    options.metricsAddress = config->metricsAddress;
+    options.apiaryHive = config->hiveIndex;
+    options.apiaryFd = config->apiaryFd;
+    options.placement = &config->placement;
+    options.error = printColonyError;
+
+    Beehive* beehive = beehiveCreate(&options);
+    if (!beehive) {
+        return 1;
+    }
+
+    // Checkpoints are requested with SIGHUP; colony processes restore the default
+    if (config->checkpointPath) {
+        struct sigaction hup = {0};
+        hup.sa_handler = handleCheckpointSignal;
+        sigaction(SIGHUP, &hup, NULL);
+    }
+
+    // Step the colony until every child has exited or the duration elapses
+    double checkpointAt = config->checkpointAt;
+    double start = monotonicSeconds();
+    int result = 0;
+    while (1) {
+        double now = monotonicSeconds();
+        if (config->duration > 0 && now - start >= config->duration) {
+            logMessage(LOG_INFO, "[MAIN] Duration of %d seconds elapsed. Stopping the colony.", config->duration);
+            break;
+        }
+        if (stopRequested) {
+            logMessage(LOG_INFO, "[MAIN] Stop requested. Stopping the colony.");
+            break;
+        }
+
+        if (checkpointRequested || (checkpointAt >= 0 && now - start >= checkpointAt)) {
+            checkpointRequested = 0;
+            checkpointAt = -1.0;
+            beehiveCheckpoint(beehive, config->checkpointPath);
+        }
+
+        int step = beehiveStep(beehive, STEP_TIMEOUT_MS);
+        if (step <= 0) {
+            result = step == -1 ? 1 : 0;
+            break;
+        }
+    }
+
+    // Stop every process of the colony at once; the shared segments are removed when it is released
+    if (beehiveStop(beehive) == -1) {
+        result = 1;
+    }
+
+    BeehiveStatus status;
+    beehiveQuery(beehive, &status);
+
+    // Per-node lock traffic: handoffs between nodes are the cross-socket coherence traffic on the counters
+    for (int node = 0; node < HIVE_MAX_NODES; node++) {
+        if (status.lockAcquisitions[node] > 0) {
+            logMessage(LOG_INFO, "[MAIN] Hive and frame lock acquisitions on NUMA node %d: %lu", node, status.lockAcquisitions[node]);
+        }
+    }
+    logMessage(LOG_INFO, "[MAIN] Hive and frame lock handoffs between NUMA nodes: %lu", status.crossNodeHandoffs);
+    logCohortReport(&status);
+
+    if (config->summaryPath) {
+        writeSummary(config->summaryPath, &status, config);
+    }
+
+    // Release the bee table, shared memory and semaphores
+    beehiveDestroy(beehive);
+
+    if (result == 0) {
+        logMessage(LOG_INFO, "[MAIN] Simulation completed successfully.");
+    }
+    return result;
+}
+
+/**
+ * runHive:
+ * Runs one hive of an apiary; matches ApiaryHiveFunction.
+ *
+ * @param context The ColonyConfig shared by all hives.
+ * @param hiveIndex Index of the hive.
+ * @param fd The hive's socket to the coordinator.
+ * @return Exit status of the hive process.
+ */
+static int runHive(void* context, int hiveIndex, int fd) {
+    ColonyConfig config = *(const ColonyConfig*)context;
+    config.hiveIndex = hiveIndex;
+    config.apiaryFd = fd;
+
+    char summaryPath[4096];
+    if (config.summaryPath) {
+        snprintf(summaryPath, sizeof(summaryPath), "%s.%d", config.summaryPath, hiveIndex);
+        config.summaryPath = summaryPath;
+    }
+    char metricsAddress[4096];
+    if (config.metricsAddress) {
+        if (strspn(config.metricsAddress, "0123456789") == strlen(config.metricsAddress)) {
+            snprintf(metricsAddress, sizeof(metricsAddress), "%d", atoi(config.metricsAddress) + hiveIndex);
+        } else {
+            snprintf(metricsAddress, sizeof(metricsAddress), "%s.%d", config.metricsAddress, hiveIndex);
+        }
+        config.metricsAddress = metricsAddress;
+    }
+    return runColony(&config);
+}
+
+/**
+ * Parses a size in bytes with an optional K, M or G suffix.
+ *
+ * @param text The size.
+ * @param size Receives the size.
+ * @return 0 on success, or -1 if text is not a positive size.
+ */
+static int parseSize(const char* text, size_t* size) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (*end) {
+        case 'K': case 'k': value <<= 10; end++; break;
+        case 'M': case 'm': value <<= 20; end++; break;
+        case 'G': case 'g': value <<= 30; end++; break;
+        default: break;
+    }
+    if (end == text || *end != '\0' || value == 0) {
+        return -1;
+    }
+    *size = (size_t)value;
+    return 0;
+}
 
 /**
  * Main entry point of the hive simulation program.
  *
  * Detailed functionality:
  * 1. Validates command-line arguments for hive size (N), queen's egg-laying interval (T_k), and egg count per cycle.
- * 2. Uses modularized initialization functions to set up shared memory and semaphores.
- * 3. Spawns the queen, beekeeper, and initial bee processes.
- * 4. Waits for all bee processes to complete and cleans up resources.
+ * 2. Runs a single colony, or an apiary of colonies that exchange bees (see --apiary).
  *
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line arguments.
  * @return 0 on success, or 1 on failure.
  */
 int main(int argc, char* argv[]) {
-    if (argc < 4) {
-        fprintf(stderr, "Usage: %s <N: initial hive size> <T_k: egg-laying interval> <eggsCount>\n", argv[0]);
+    ColonyConfig config = {0};
+    config.maxVisits = MAX_BEE_VISITS;
+    config.T_inHive = T_IN_HIVE;
+    config.checkpointAt = -1.0;
+    config.hiveIndex = -1;
+    config.apiaryFd = -1;
+    placementDefaultConfig(&config.placement);
+    PlacementConfig* placement = &config.placement;
+    int hives = 0;
+    bool splitCpus = false;
+
+    static const struct option longOptions[] = {
+        {"duration", required_argument, NULL, 'd'},
+        {"max-visits", required_argument, NULL, 'v'},
+        {"time-in-hive", required_argument, NULL, 't'},
+        {"summary", required_argument, NULL, 's'},
+        {"capacity", required_argument, NULL, 'c'},
+        {"huge-pages", no_argument, NULL, 'H'},
+        {"events", required_argument, NULL, OPT_EVENTS},
+        {"config", required_argument, NULL, OPT_CONFIG},
+        {"adaptive", required_argument, NULL, 'a'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-at", required_argument, NULL, OPT_CHECKPOINT_AT},
+        {"restore", required_argument, NULL, 'r'},
+        {"apiary", required_argument, NULL, 'A'},
+        {"split-cpus", no_argument, NULL, OPT_SPLIT_CPUS},
+        {"metrics", required_argument, NULL, 'm'},
+        {"quiet", no_argument, NULL, 'q'},
+        {"log-segment", required_argument, NULL, OPT_LOG_SEGMENT},
+        {"log-keep", required_argument, NULL, OPT_LOG_KEEP},
+        {"queen-cpu", required_argument, NULL, OPT_QUEEN_CPU},
+        {"keeper-cpu", required_argument, NULL, OPT_KEEPER_CPU},
+        {"bee-cpus", required_argument, NULL, OPT_BEE_CPUS},
+        {"bee-placement", required_argument, NULL, OPT_BEE_PLACEMENT},
+        {"mem-node", required_argument, NULL, OPT_MEM_NODE},
+        {NULL, 0, NULL, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:v:t:s:c:Ha:C:r:A:m:q", longOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'd': config.duration = atoi(optarg); break;
+            case 'v': config.maxVisits = atoi(optarg); break;
+            case 't': config.T_inHive = atoi(optarg); break;
+            case 's': config.summaryPath = optarg; break;
+            case 'c': config.capacity = atoi(optarg); break;
+            case 'H': config.hugePages = true; break;
+            case OPT_EVENTS: config.eventCapacity = atoi(optarg); break;
+            case OPT_CONFIG: config.configPath = optarg; break;
+            case 'a': config.targetUtilization = atof(optarg); break;
+            case 'C': config.checkpointPath = optarg; break;
+            case OPT_CHECKPOINT_AT: config.checkpointAt = atof(optarg); break;
+            case 'r': config.restorePath = optarg; break;
+            case 'A': hives = atoi(optarg); break;
+            case OPT_SPLIT_CPUS: splitCpus = true; break;
+            case 'm': config.metricsAddress = optarg; break;
+            case 'q': logConfig.logToConsole = false; break;
+            case OPT_LOG_SEGMENT:
+                if (parseSize(optarg, &logConfig.segmentSize) == -1) {
+                    fprintf(stderr, "Error: Invalid log segment size '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_LOG_KEEP: logConfig.keepSegments = atoi(optarg); break;
+            case OPT_QUEEN_CPU: placement->queenCpu = atoi(optarg); break;
+            case OPT_KEEPER_CPU: placement->keeperCpu = atoi(optarg); break;
+            case OPT_BEE_CPUS:
+                if (parseCpuList(optarg, placement->beeCpus, &placement->beeCpuCount) == -1) {
+                    fprintf(stderr, "Error: Invalid CPU list '%s'.\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_BEE_PLACEMENT:
+                if (strcmp(optarg, "spread") == 0) placement->beePlacement = BEE_PLACEMENT_SPREAD;
+                else if (strcmp(optarg, "pack") == 0) placement->beePlacement = BEE_PLACEMENT_PACK;
+                else {
+                    fprintf(stderr, "Error: Bee placement must be 'spread' or 'pack'.\n");
+                    return 1;
+                }
+                break;
+            case OPT_MEM_NODE:
+                placement->memNode = strcmp(optarg, "auto") == 0 ? PLACEMENT_NODE_AUTO : atoi(optarg);
+                break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (argc - optind < 3) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    int N = atoi(argv[1]);
-    int T_k = atoi(argv[2]);
-    int eggsCount = atoi(argv[3]);
+    config.N = atoi(argv[optind]);
+    config.T_k = atoi(argv[optind + 1]);
+    config.eggsCount = atoi(argv[optind + 2]);
 
-    if (N <= 0 || T_k <= 0 || eggsCount <= 0) {
+    if (config.N <= 0 || config.T_k <= 0 || config.eggsCount <= 0) {
         fprintf(stderr, "Error: All arguments must be positive integers.\n");
         return 1;
     }
 
-    // Ensure the number of initial bees does not exceed MAX_BEES
-    if (N > MAX_BEES) {
-        logMessage(LOG_WARNING, "[MAIN] Initial hive size (%d) exceeds MAX_BEES (%d). Setting N to %d.", N, MAX_BEES, MAX_BEES);
-        N = MAX_BEES;
-    }
-
-    // Shared memory IDs
-    int shmid, semid;
-
-    // Initialize HiveData and HiveSemaphores using modular functions
-    HiveData* hive = initHiveData(N, &shmid);
-    HiveSemaphores* semaphores = initHiveSemaphores(&semid);
-
-    // Spawn the queen process
-    pid_t queenPid = fork();
-    if (queenPid == 0) {
-        QueenArgs queenArgs = {T_k, eggsCount, hive, semaphores, semid, shmid};
-        queenWorker(&queenArgs);
-        exit(EXIT_SUCCESS);
-    } else if (queenPid < 0) {
-        handleError("[MAIN] Failed to fork queen process", shmid, semid);
-    }
-
-    // Spawn the beekeeper process
-    pid_t beekeeperPid = fork();
-    if (beekeeperPid == 0) {
-        BeekeeperArgs keeperArgs = {hive, semaphores, semid, shmid};
-        beekeeperWorker(&keeperArgs);
-        exit(EXIT_SUCCESS);
-    } else if (beekeeperPid < 0) {
-        handleError("[MAIN] Failed to fork beekeeper process", shmid, semid);
-    }
-
-    // Spawn initial bee processes
-    for (int i = 0; i < N; i++) {
-        pid_t beePid = fork();
-        if (beePid == 0) {
-            BeeArgs beeArgs = {i, 0, MAX_BEE_VISITS, T_IN_HIVE, hive, semaphores, false, semid, shmid};
-            beeWorker(&beeArgs);
-            exit(EXIT_SUCCESS);
-        } else if (beePid < 0) {
-            handleError("[MAIN] Failed to fork bee process", shmid, semid);
-        }
+    if (config.duration < 0 || config.maxVisits <= 0 || config.T_inHive < 0 || config.capacity < 0 || config.eventCapacity < 0 ||
+        config.targetUtilization < 0 || config.targetUtilization > 1 || logConfig.keepSegments < 0 ||
+        (config.checkpointAt >= 0 && !config.checkpointPath)) {
+        fprintf(stderr, "Error: Invalid option value.\n");
+        return 1;
     }
 
-    // Wait for all bee processes to finish
-    while (1) {
-        pid_t result = wait(NULL);
-        if (result == -1) {
-            if (errno == ECHILD) {
-                // No more child processes
-                break;
-            } else {
-                handleError("[MAIN] Failed to wait for bee processes", shmid, semid);
-            }
-        }
+    if (hives != 0 && (hives < 2 || hives > APIARY_MAX_HIVES)) {
+        fprintf(stderr, "Error: An apiary needs 2 to %d hives.\n", APIARY_MAX_HIVES);
+        return 1;
     }
-
-    // Terminate the queen and beekeeper processes
-    if (kill(queenPid, SIGTERM) == -1) {
-        handleError("[MAIN] Failed to terminate queen process", shmid, semid);
+    if (hives != 0 && (config.checkpointPath || config.restorePath)) {
+        fprintf(stderr, "Error: Checkpoints are not supported in an apiary.\n");
+        return 1;
     }
-    if (waitpid(queenPid, NULL, 0) == -1) {
-        handleError("[MAIN] Failed to wait for queen process", shmid, semid);
+    if (splitCpus && hives == 0) {
+        fprintf(stderr, "Error: --split-cpus requires --apiary.\n");
+        return 1;
     }
 
-    if (kill(beekeeperPid, SIGTERM) == -1) {
-        handleError("[MAIN] Failed to terminate beekeeper process", shmid, semid);
-    }
-    if (waitpid(beekeeperPid, NULL, 0) == -1) {
-        handleError("[MAIN] Failed to wait for beekeeper process", shmid, semid);
+    // Lead a process group of our own so a stop signal reaches every hive of an apiary; the
+    // colony processes of each hive have a group of their own and are stopped by their hive
+    setpgid(0, 0);
+    struct sigaction stop = {0};
+    stop.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    // The supervisor holds one pidfd per living process
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
     }
 
-    // Cleanup shared memory and semaphores
-    cleanupResources(shmid, semid);
+    // Segments closed by any process of the colony are compressed here, off the bees' path
+    if (logCompressorStart() == -1) {
+        fprintf(stderr, "Error: Failed to start the log compressor: %s\n", strerror(errno));
+        return 1;
+    }
 
-    logMessage(LOG_INFO, "[MAIN] Simulation completed successfully.");
-    return 0;
+    int status = hives > 0 ? apiaryRun(hives, splitCpus, runHive, &config) : runColony(&config);
+    if (status == -1) {
+        fprintf(stderr, "Error: Failed to run the apiary: %s\n", strerror(errno));
+        status = 1;
+    }
+    logCompressorStop();
+    return status;
 }
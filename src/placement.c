@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#if PLACEMENT_MAX_CPUS > CPU_SETSIZE
+#error "PLACEMENT_MAX_CPUS must fit in a cpu_set_t"
+#endif
+
+/**
+ * Fills a CPU set from a CPU list.
+ */
+static void toCpuSet(const int* cpus, int count, cpu_set_t* set) {
+    CPU_ZERO(set);
+    for (int i = 0; i < count; i++) {
+        CPU_SET(cpus[i], set);
+    }
+}
+
+/**
+ * Lists the CPUs of a set in ascending order.
+ */
+static int fromCpuSet(const cpu_set_t* set, int* cpus) {
+    int count = 0;
+    for (int cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++) {
+        if (CPU_ISSET(cpu, set)) cpus[count++] = cpu;
+    }
+    return count;
+}
+
+void placementDefaultConfig(PlacementConfig* config) {
+    memset(config, 0, sizeof(*config));
+    config->queenCpu = -1;
+    config->keeperCpu = -1;
+    config->beePlacement = BEE_PLACEMENT_NONE;
+    config->memNode = -1;
+    cpu_set_t affinity;
+    if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0) {
+        config->beeCpuCount = fromCpuSet(&affinity, config->beeCpus);
+    }
+}
+
+int parseCpuList(const char* list, int* cpus, int* count) {
+    // Ranges may overlap or come in any order; the set sorts them and drops repeats
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    const char* p = list;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        if (last >= PLACEMENT_MAX_CPUS) return -1;
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        p = end;
+    }
+    *count = fromCpuSet(&set, cpus);
+    return *count > 0 ? 0 : -1;
+}
+
+int cpuNode(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dir = opendir(path);
+    if (!dir) return 0;
+
+    // The CPU directory holds a "nodeN" link to its NUMA node
+    int node = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * Tells whether a NUMA node exists and has memory.
+ */
+static bool nodeHasMemory(int node) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/meminfo", node);
+    return access(path, F_OK) == 0 || (node == 0 && access("/sys/devices/system/node", F_OK) != 0);
+}
+
+int placementResolve(PlacementConfig* config) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        return -1;
+    }
+    int pinned[2] = {config->queenCpu, config->keeperCpu};
+    for (int i = 0; i < 2; i++) {
+        if (pinned[i] >= PLACEMENT_MAX_CPUS || (pinned[i] >= 0 && !CPU_ISSET(pinned[i], &allowed))) {
+            logMessage(LOG_ERROR, "[Placement] CPU %d is not available to this process.", pinned[i]);
+            return -1;
+        }
+    }
+    cpu_set_t beeCpus;
+    toCpuSet(config->beeCpus, config->beeCpuCount, &beeCpus);
+    CPU_AND(&beeCpus, &beeCpus, &allowed);
+    config->beeCpuCount = fromCpuSet(&beeCpus, config->beeCpus);
+    if (config->beeCpuCount == 0) {
+        logMessage(LOG_ERROR, "[Placement] None of the bee CPUs is available to this process.");
+        return -1;
+    }
+
+    // Group the bee CPUs by node; the node with most of them hosts the segments in auto mode.
+    // The table is per call, since instances may be created from several threads at once.
+    int (*byNode)[PLACEMENT_MAX_CPUS] = malloc(HIVE_MAX_NODES * sizeof(*byNode));
+    if (!byNode) {
+        return -1;
+    }
+    int perNode[HIVE_MAX_NODES] = {0};
+    for (int i = 0; i < config->beeCpuCount; i++) {
+        int cpu = config->beeCpus[i];
+        int node = cpuNode(cpu);
+        if (node >= HIVE_MAX_NODES) node = HIVE_MAX_NODES - 1;
+        byNode[node][perNode[node]++] = cpu;
+    }
+    if (config->memNode == PLACEMENT_NODE_AUTO) {
+        int best = 0;
+        for (int n = 1; n < HIVE_MAX_NODES; n++) {
+            if (perNode[n] > perNode[best]) best = n;
+        }
+        config->memNode = best;
+    }
+    if (config->memNode >= HIVE_MAX_NODES || (config->memNode >= 0 && !nodeHasMemory(config->memNode))) {
+        logMessage(LOG_ERROR, "[Placement] NUMA node %d does not exist or has no memory.", config->memNode);
+        free(byNode);
+        return -1;
+    }
+
+    // Spreading takes one CPU from every node in turn, so neighbouring bee IDs land on different nodes
+    config->cpuCount = 0;
+    for (int round = 0; config->cpuCount < config->beeCpuCount; round++) {
+        for (int n = 0; n < HIVE_MAX_NODES; n++) {
+            if (round < perNode[n]) config->cpuOrder[config->cpuCount++] = byNode[n][round];
+        }
+    }
+
+    // Packing keeps bees on the memory node; without one, on the node with most bee CPUs
+    int packNode = config->memNode;
+    if (packNode < 0 || perNode[packNode] == 0) {
+        packNode = 0;
+        for (int n = 1; n < HIVE_MAX_NODES; n++) {
+            if (perNode[n] > perNode[packNode]) packNode = n;
+        }
+    }
+    config->packCount = perNode[packNode];
+    memcpy(config->packCpus, byNode[packNode], (size_t)config->packCount * sizeof(int));
+    free(byNode);
+    return 0;
+}
+
+int pinToCpu(int cpu) {
+    if (cpu < 0) return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+int placeBee(const PlacementConfig* config, int beeId) {
+    switch (config->beePlacement) {
+        case BEE_PLACEMENT_SPREAD:
+            return pinToCpu(config->cpuOrder[beeId % config->cpuCount]);
+        case BEE_PLACEMENT_PACK: {
+            cpu_set_t set;
+            toCpuSet(config->packCpus, config->packCount, &set);
+            return sched_setaffinity(0, sizeof(set), &set);
+        }
+        default:
+            return 0;
+    }
+}
+
+int bindToNode(void* addr, size_t length, int node) {
+    if (node < 0) return 0;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    length = (length + pageSize - 1) / pageSize * pageSize;
+
+    unsigned long mask[(HIVE_MAX_NODES + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+    // Pages touched before the policy was set are migrated as well
+    return (int)syscall(SYS_mbind, addr, length, MPOL_BIND, mask, HIVE_MAX_NODES + 1, MPOL_MF_MOVE);
+}
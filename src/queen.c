@@ -1,12 +1,198 @@
+#define _GNU_SOURCE
 #include "queen.h"
-#include "bee.h"
 #include "common.h"
-#include <semaphore.h>
+#include "hivelock.h"
+#include "frames.h"
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
+#include <semaphore.h>
 #include <sys/prctl.h>
 
+/**
+ * State of the adaptive egg-laying controller, kept privately by the queen.
+ */
+typedef struct {
+    double integral;     // Accumulated occupancy error (bee-seconds).
+    double deathRate;    // Smoothed deaths per second (feed-forward term).
+    double credit;       // Eggs owed by the requested birth rate but not laid yet.
+    double lastTime;     // CLOCK_MONOTONIC seconds of the previous update.
+    int lastDeaths;      // HiveData.deaths at the previous update.
+    int lastEpoch;       // HiveData.resizeEpoch at the previous update.
+} LayingController;
+
+/**
+ * waitForCycle:
+ * Sleeps until the next laying cycle. An adaptive queen returns early when the beekeeper
+ * resizes the hive; any queen returns early when the colony shuts down.
+ *
+ * @param queen The queen's arguments.
+ * @param seconds Time until the next cycle.
+ * @param wakeOnResize Whether a resize ends the wait.
+ * @return false if the colony is shutting down, true otherwise.
+ */
+static bool waitForCycle(QueenArgs* queen, double seconds, bool wakeOnResize) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    long nanos = deadline.tv_nsec + (long)((seconds - (long)seconds) * 1e9);
+    deadline.tv_sec += (time_t)seconds + nanos / 1000000000L;
+    deadline.tv_nsec = nanos % 1000000000L;
+
+    while (!shutdownRequested(queen->semaphores)) {
+        if (sem_clockwait(&queen->semaphores->queenWake, CLOCK_MONOTONIC, &deadline) == 0) {
+            if (wakeOnResize) break;
+        } else if (errno == ETIMEDOUT) {
+            break;
+        } else if (errno != EINTR) {
+            handleError("[Queen] sem_clockwait (queenWake) failed", -1, -1);
+        }
+    }
+    return !shutdownRequested(queen->semaphores);
+}
+
+/**
+ * updateController:
+ * Runs one step of the adaptive controller (hive lock held) and decides how many eggs
+ * to lay now and when to run the next cycle.
+ *
+ * The requested birth rate is the smoothed death rate (to keep the population steady)
+ * plus a PI correction of the error between the occupancy setpoint and the occupancy
+ * that is inside or already queued at the entrances. Eggs are owed at that rate and
+ * laid in whole batches; the next cycle is scheduled so that a batch holds about
+ * eggsCount eggs.
+ *
+ * @param queen The queen's arguments.
+ * @param c Controller state.
+ * @param interval Receives the time until the next cycle in seconds.
+ * @return Number of eggs to lay now.
+ */
+static int updateController(QueenArgs* queen, LayingController* c, double* interval) {
+    HiveData* hive = queen->hive;
+    int T_k = READ_TUNABLE(queen->config, T_k);
+    int eggsCount = READ_TUNABLE(queen->config, eggsCount);
+    double now = monotonicSeconds();
+    double dt = now - c->lastTime;
+    if (dt <= 0) dt = 1e-3;
+    // A long stall (e.g. waiting for the hive lock) must not be integrated as one huge step
+    if (dt > T_k) dt = T_k;
+    c->lastTime = now;
+
+    // A resize moves the setpoint; the integral built up for the old one would only overshoot
+    if (hive->resizeEpoch != c->lastEpoch) {
+        c->lastEpoch = hive->resizeEpoch;
+        c->integral = 0.0;
+        c->credit = 0.0;
+        logMessage(LOG_INFO, "[Queen] Hive resized to N = %d; adapting to the new capacity.", hive->N);
+    }
+
+    int deaths = hive->deaths - c->lastDeaths;
+    c->lastDeaths = hive->deaths;
+    c->deathRate += QUEEN_DEATH_RATE_SMOOTHING * (deaths / dt - c->deathRate);
+
+    int capacity = calculateP(hive->N);
+    double setpoint = queen->targetUtilization * (capacity > 0 ? capacity : 0);
+    int occupancy = hive->currentBeesInHive + hive->beesWaiting[0] + hive->beesWaiting[1];
+    double error = setpoint - occupancy;
+
+    double rate = c->deathRate + QUEEN_KP * error + QUEEN_KI * (c->integral + error * dt);
+    double maxRate = (double)eggsCount * QUEEN_MAX_BATCH_FACTOR / QUEEN_MIN_INTERVAL;
+    bool saturated = (rate <= 0 && error < 0) || (rate >= maxRate && error > 0);
+    if (rate < 0) rate = 0;
+    if (rate > maxRate) rate = maxRate;
+
+    c->credit += rate * dt;
+    if (c->credit > eggsCount * QUEEN_MAX_BATCH_FACTOR) c->credit = eggsCount * QUEEN_MAX_BATCH_FACTOR;
+    int eggs = (int)c->credit;
+
+    // Eggs are only useful while there is room inside and below the N population limit
+    int freeSpace = capacity - hive->currentBeesInHive;
+    int freePopulation = hive->N - hive->beesAlive;
+    if (eggs > freeSpace || eggs > freePopulation) {
+        eggs = freeSpace < freePopulation ? freeSpace : freePopulation;
+        if (error > 0) saturated = true;
+    }
+    if (eggs < 0) eggs = 0;
+
+    // Conditional integration (anti-windup): the integral only moves while the queen can act on it
+    if (!saturated) {
+        c->integral += error * dt;
+    }
+
+    // The occupancy is checked at least every T_k, so a drop is never noticed later than in fixed mode
+    *interval = rate > 0 ? eggsCount / rate : T_k;
+    if (*interval > T_k) *interval = T_k;
+    if (*interval < QUEEN_MIN_INTERVAL) *interval = QUEEN_MIN_INTERVAL;
+
+    logMessage(LOG_INFO, "[Queen] Adaptive: occupancy %d (target %.1f of %d), deaths %.2f/s, birth rate %.2f/s, laying %d, next cycle in %.1f s.",
+               occupancy, setpoint, capacity, c->deathRate, rate, eggs, *interval);
+    return eggs;
+}
+
+/**
+ * layEggs:
+ * Lays newborn bees inside the hive (hive lock held). Each one is counted, put on a frame
+ * and given a slot here, then requested from the main process's supervisor through the
+ * spawn pipe. Eggs that could not be laid are counted as skipped, and the cycle ends with
+ * one "Laid X of Y eggs." line.
+ *
+ * @param queen The queen's arguments.
+ * @param count Number of eggs to lay.
+ * @return Number of eggs actually laid (fewer if the frames or the bee table are full, the colony
+ *         is at maxBees, or the pipe fails).
+ */
+static int layEggs(QueenArgs* queen, int count) {
+    int laid = 0;
+    while (laid < count) {
+        int maxBees = READ_TUNABLE(queen->config, maxBees);
+        if (queen->hive->beesAlive >= maxBees) {
+            logMessage(LOG_WARNING, "[Queen] The colony is at its limit of %d bees.", maxBees);
+            break;
+        }
+        // Brood goes on the frames in turn, as the bees' first home
+        int frame;
+        if (lockFreeFrame(queen->hive, queen->semaphores, queen->hive->nextBeeID, &frame) == -1) {
+            handleError("[Queen] lock (frameSem) failed", -1, -1);
+        }
+        if (frame == -1) {
+            logMessage(LOG_WARNING, "[Queen] Every frame is full.");
+            break;
+        }
+        int slot = beeTableAcquire(queen->table, queen->hive->nextBeeID, BEE_SLOT_INSIDE);
+        if (slot == -1) {
+            unlockFrame(queen->semaphores, frame);
+            logMessage(LOG_WARNING, "[Queen] Bee table is full (capacity: %d).", queen->hive->tableCapacity);
+            break;
+        }
+        beeTableSetFlags(queen->table, slot, BEE_SLOT_NEWBORN);
+        beeTableSetFrame(queen->table, slot, frame);
+        beeTableSetCohort(queen->table, slot, BEE_COHORT_QUEEN);
+        queen->hive->beesAlive++;
+        frameEnter(queen->hive, frame);
+        unlockFrame(queen->semaphores, frame);
+
+        // The newborn is counted now; the supervisor forks its process
+        SpawnRequest request = {queen->hive->nextBeeID, slot};
+        if (write(queen->spawnFd, &request, sizeof(request)) != (ssize_t)sizeof(request)) {
+            logMessage(LOG_WARNING, "[Queen] Failed to request bee %d from the supervisor: %s", queen->hive->nextBeeID, strerror(errno));
+            queen->hive->beesAlive--;
+            if (lockFrame(queen->semaphores, frame) == -1) {
+                handleError("[Queen] lock (frameSem) failed", -1, -1);
+            }
+            frameLeave(queen->hive, frame);
+            beeTableRelease(queen->table, slot);
+            unlockFrame(queen->semaphores, frame);
+            break;
+        }
+        eventBusPublish(queen->events, HIVE_EVENT_BIRTH, queen->hive->nextBeeID, 0, queen->hive->beesAlive, 0);
+        queen->hive->nextBeeID++;
+        laid++;
+    }
+    // One line per cycle in both modes, with what was actually laid (beehive-analyze counts it)
+    logMessage(LOG_INFO, "[Queen] Laid %d of %d eggs.", laid, count);
+    __atomic_fetch_add(&queen->hive->eggsLaid, (unsigned long)laid, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&queen->hive->eggsSkipped, (unsigned long)(count - laid), __ATOMIC_RELAXED);
+    return laid;
+}
+
 /**
  * queenWorker:
  * Implements the queen's behavior in the hive simulation.
@@ -16,10 +202,13 @@
  *
  * Detailed functionality:
  * 1. Attaches to shared memory for hive data and semaphores.
- * 2. Enters a loop to lay eggs at specified intervals (T_k).
- * 3. Uses semaphores to safely update hive data and spawn bee processes.
+ * 2. Enters a loop to lay eggs at specified intervals (T_k), or, in adaptive mode, at the
+ *    intervals and batch sizes chosen by the occupancy controller.
+ * 3. Uses the hive lock to safely update hive data and reserve a slot for every newborn, then
+ *    asks the main process's supervisor, through the spawn pipe, to fork it. The supervisor
+ *    owns and reaps every bee.
  * 4. Checks hive capacity and logs warnings if space is insufficient.
- * 5. Cleans up resources and detaches from shared memory upon termination.
+ * 5. Cleans up resources and detaches from shared memory once the colony shuts down.
  *
  * @param arg Pointer to QueenArgs containing the queen's configuration and shared resources.
  */
@@ -31,56 +220,56 @@ void queenWorker(QueenArgs* arg) {
     queen->hive = (HiveData*)attachSharedMemory(queen->shmid);
     queen->semaphores = (HiveSemaphores*)attachSharedMemory(queen->semid);
     if (queen->hive == NULL || queen->semaphores == NULL) {
-        handleError("[Queen] attachSharedMemory failed", queen->shmid, queen->semid);
+        handleError("[Queen] attachSharedMemory failed", -1, -1);
     }
 
-    int nextBeeID = queen->hive->N;
-
-    while (1) {
-        sleep(queen->T_k); // Wait for the next egg-laying interval
+    bool adaptive = queen->targetUtilization > 0;
+    LayingController controller = {0.0, 0.0, 0.0, monotonicSeconds(), queen->hive->deaths, queen->hive->resizeEpoch};
+    double interval = READ_TUNABLE(queen->config, T_k);
 
+    // Wait for the next egg-laying interval
+    while (waitForCycle(queen, adaptive ? interval : READ_TUNABLE(queen->config, T_k), adaptive)) {
         // Lock hive access
-        if (sem_wait(&queen->semaphores->hiveSem) == -1) {
-            handleError("[Queen] sem_wait (hiveSem) failed", queen->shmid, queen->semid);
+        if (lockHive(queen->semaphores, queen->hive, queen->table) == -1) {
+            handleError("[Queen] lock (hiveSem) failed", -1, -1);
+        }
+        // No egg is laid once the colony is stopping
+        if (shutdownRequested(queen->semaphores)) {
+            robustUnlock(&queen->semaphores->hiveSem);
+            break;
         }
 
-        // Reap any terminated child processes to prevent zombies
-        while (waitpid(-1, NULL, WNOHANG) > 0);
-
-        // Calculate available space in the hive
-        int freeSpace = calculateP(queen->hive->N) - queen->hive->currentBeesInHive;
-
-        // Check if there is enough space and the total bee count does not exceed hive size N
-        if (freeSpace >= queen->eggsCount && (queen->hive->beesAlive + queen->eggsCount) <= queen->hive->N) {
-            logMessage(LOG_INFO, "[Queen] Laying %d eggs.", queen->eggsCount);
-
-            for (int i = 0; i < queen->eggsCount; i++) {
-                queen->hive->beesAlive++;
-                queen->hive->currentBeesInHive++;
+        if (adaptive) {
+            int eggs = updateController(queen, &controller, &interval);
+            if (eggs > 0) {
+                controller.credit -= layEggs(queen, eggs);
+                logMessage(LOG_INFO, "[Queen] Total living bees: %d", queen->hive->beesAlive);
+            }
+        } else {
+            // The batch size may have been changed since the last cycle
+            int eggsCount = READ_TUNABLE(queen->config, eggsCount);
 
-                BeeArgs beeArgs = {nextBeeID++, 0, MAX_BEE_VISITS, T_IN_HIVE, queen->hive, queen->semaphores, true, queen->semid, queen->shmid};
+            // Calculate available space in the hive
+            int freeSpace = calculateP(queen->hive->N) - queen->hive->currentBeesInHive;
 
-                pid_t beePid = fork();
-                if (beePid == 0) {
-                    beeWorker(&beeArgs); // Start the bee process
-                    exit(EXIT_SUCCESS);
-                } else if (beePid < 0) {
-                    handleError("[Queen] fork failed", queen->shmid, queen->semid);
-                }
+            // Check if there is enough space and the total bee count does not exceed hive size N
+            if (freeSpace >= eggsCount && (queen->hive->beesAlive + eggsCount) <= queen->hive->N) {
+                layEggs(queen, eggsCount);
+                logMessage(LOG_INFO, "[Queen] Total living bees: %d", queen->hive->beesAlive);
+            } else {
+                logMessage(LOG_WARNING, "[Queen] Not enough space in the hive (free: %d) or hive size limit reached (alive: %d, max: %d).", freeSpace, queen->hive->beesAlive, queen->hive->N);
+                __atomic_fetch_add(&queen->hive->eggsSkipped, (unsigned long)eggsCount, __ATOMIC_RELAXED);
             }
-            logMessage(LOG_INFO, "[Queen] Total living bees: %d", queen->hive->beesAlive);
-        } else {
-            logMessage(LOG_WARNING, "[Queen] Not enough space in the hive (free: %d) or hive size limit reached (alive: %d, max: %d).", freeSpace, queen->hive->beesAlive, queen->hive->N);
         }
 
         // Unlock hive access
-        if (sem_post(&queen->semaphores->hiveSem) == -1) {
-            handleError("[Queen] sem_post (hiveSem) failed", queen->shmid, queen->semid);
+        if (robustUnlock(&queen->semaphores->hiveSem) == -1) {
+            handleError("[Queen] unlock (hiveSem) failed", -1, -1);
         }
     }
 
     // Detach from shared memory
     detachSharedMemory(queen->hive); 
     detachSharedMemory(queen->semaphores); 
-    exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+    exitColonyProcess(EXIT_SUCCESS);
+}
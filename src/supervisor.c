@@ -0,0 +1,350 @@
+#include "supervisor.h"
+#include "hivelock.h"
+#include "frames.h"
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+/**
+ * Maximum number of epoll events handled per wait.
+ */
+#define SUPERVISOR_EVENT_BATCH 64
+
+/**
+ * A process watched by the supervisor.
+ */
+typedef struct {
+    pid_t pid;
+    int pidfd;
+    SupervisedKind kind;
+    int id;
+    int slot;
+    int index;        // Position in Supervisor.live, kept up to date on removal.
+    bool signalled;   // Whether the supervisor itself asked the process to stop.
+    double startedAt; // CLOCK_MONOTONIC seconds when the process was registered.
+} Watched;
+
+struct Supervisor {
+    int epfd;
+    int spawnFd;           // Read end of the spawn pipe, or -1 once closed.
+    SpawnBeeFunction spawn; // Forks the bees requested through the spawn pipe.
+    void* spawnContext;
+    Watched** live;        // Processes not yet reaped.
+    int liveCount;
+    int liveCapacity;
+    int running[SUPERVISED_BEE + 1];
+    HiveData* hive;
+    HiveSemaphores* semaphores;
+    BeeTable* table;
+    EventBus* events;
+    bool stopping;         // Set by supervisorShutdown: every exit is expected from then on.
+    SupervisorStats stats;
+};
+
+/**
+ * Display names of the SupervisedKind values.
+ */
+static const char* const KIND_NAMES[] = {"Queen", "Beekeeper", "Bee"};
+
+/**
+ * Its address is the data pointer of the caller's wake descriptors in the epoll set, told
+ * apart from the spawn pipe (NULL) and the pidfds (their Watched entries).
+ */
+static char wakeMarker;
+
+Supervisor* supervisorCreate(HiveData* hive, HiveSemaphores* semaphores, BeeTable* table, EventBus* events) {
+    Supervisor* supervisor = calloc(1, sizeof(Supervisor));
+    if (!supervisor) {
+        return NULL;
+    }
+    supervisor->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (supervisor->epfd == -1) {
+        free(supervisor);
+        return NULL;
+    }
+    supervisor->spawnFd = -1;
+    supervisor->hive = hive;
+    supervisor->semaphores = semaphores;
+    supervisor->table = table;
+    supervisor->events = events;
+    return supervisor;
+}
+
+int supervisorWatch(Supervisor* supervisor, pid_t pid, SupervisedKind kind, int id, int slot) {
+    if (supervisor->liveCount == supervisor->liveCapacity) {
+        int capacity = supervisor->liveCapacity ? supervisor->liveCapacity * 2 : 64;
+        Watched** live = realloc(supervisor->live, capacity * sizeof(Watched*));
+        if (!live) {
+            return -1;
+        }
+        supervisor->live = live;
+        supervisor->liveCapacity = capacity;
+    }
+
+    Watched* w = malloc(sizeof(Watched));
+    if (!w) {
+        return -1;
+    }
+    // A zombie still has a pidfd, which is readable at once; nothing can be missed
+    w->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (w->pidfd == -1) {
+        free(w);
+        return -1;
+    }
+    w->pid = pid;
+    w->kind = kind;
+    w->id = id;
+    w->slot = slot;
+    w->signalled = false;
+    w->startedAt = monotonicSeconds();
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = w};
+    if (epoll_ctl(supervisor->epfd, EPOLL_CTL_ADD, w->pidfd, &ev) == -1) {
+        close(w->pidfd);
+        free(w);
+        return -1;
+    }
+
+    w->index = supervisor->liveCount;
+    supervisor->live[supervisor->liveCount++] = w;
+    supervisor->running[kind]++;
+    supervisor->stats.watched++;
+    return 0;
+}
+
+int supervisorAddSpawnPipe(Supervisor* supervisor, int fd, SpawnBeeFunction spawn, void* context) {
+    // The pipe is told apart from pidfds by its NULL data pointer
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(supervisor->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        return -1;
+    }
+    supervisor->spawnFd = fd;
+    supervisor->spawn = spawn;
+    supervisor->spawnContext = context;
+    return 0;
+}
+
+/**
+ * abandonSpawn:
+ * Gives back the slot and the counters the queen reserved for a bee that could not be forked.
+ *
+ * @param supervisor The supervisor.
+ * @param request The request that failed.
+ */
+static void abandonSpawn(Supervisor* supervisor, const SpawnRequest* request) {
+    if (lockHive(supervisor->semaphores, supervisor->hive, supervisor->table) == -1) {
+        logMessage(LOG_ERROR, "[Supervisor] lock (hiveSem) failed: %s", strerror(errno));
+        return;
+    }
+    const BeeSlot* s = &supervisor->table->slots[request->slot];
+    // A repair in between may already have reclaimed the slot
+    if (__atomic_load_n(&s->state, __ATOMIC_ACQUIRE) != BEE_SLOT_FREE && s->id == request->id) {
+        if (s->state == BEE_SLOT_INSIDE && lockFrame(supervisor->semaphores, s->frame) == 0) {
+            frameLeave(supervisor->hive, s->frame);
+            unlockFrame(supervisor->semaphores, s->frame);
+        }
+        supervisor->hive->beesAlive--;
+        beeTableRelease(supervisor->table, request->slot);
+    }
+    robustUnlock(&supervisor->semaphores->hiveSem);
+}
+
+/**
+ * readSpawnRequests:
+ * Drains the spawn pipe, then forks and starts watching every requested bee.
+ *
+ * @param supervisor The supervisor.
+ */
+static void readSpawnRequests(Supervisor* supervisor) {
+    SpawnRequest requests[SUPERVISOR_EVENT_BATCH];
+    ssize_t bytes = read(supervisor->spawnFd, requests, sizeof(requests));
+    if (bytes == -1) {
+        if (errno != EINTR && errno != EAGAIN) {
+            logMessage(LOG_WARNING, "[Supervisor] Failed to read the spawn pipe: %s", strerror(errno));
+        }
+        return;
+    }
+    if (bytes == 0) {
+        // The queen (and every process holding the write end) is gone
+        close(supervisor->spawnFd);
+        supervisor->spawnFd = -1;
+        return;
+    }
+
+    // Writes of a single request are atomic, so reads never split one
+    for (size_t i = 0; i < (size_t)bytes / sizeof(SpawnRequest); i++) {
+        pid_t pid = supervisor->spawn(supervisor->spawnContext, requests[i].id, requests[i].slot);
+        if (pid == -1) {
+            logMessage(LOG_WARNING, "[Supervisor] Cannot fork bee %d: %s", requests[i].id, strerror(errno));
+            abandonSpawn(supervisor, &requests[i]);
+        } else if (supervisorWatch(supervisor, pid, SUPERVISED_BEE, requests[i].id, requests[i].slot) == -1) {
+            // An unwatched bee would never be reaped; other colonies may share this process
+            logMessage(LOG_WARNING, "[Supervisor] Cannot watch bee %d (pid %d): %s", requests[i].id, (int)pid, strerror(errno));
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+            abandonSpawn(supervisor, &requests[i]);
+        }
+    }
+}
+
+/**
+ * reap:
+ * Collects the exit status of a watched process, records its lifetime, and repairs
+ * the hive counters if a bee died without giving back its slot.
+ *
+ * @param supervisor The supervisor.
+ * @param w The process whose pidfd became readable.
+ */
+static void reap(Supervisor* supervisor, Watched* w) {
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PIDFD, w->pidfd, &info, WEXITED) == -1) {
+        logMessage(LOG_WARNING, "[Supervisor] waitid failed for %s pid %d: %s", KIND_NAMES[w->kind], (int)w->pid, strerror(errno));
+    }
+
+    double lifetime = monotonicSeconds() - w->startedAt;
+    // Processes stopped by supervisorSignal, or by the colony's shutdown, count as normal exits
+    bool normal = (info.si_code == CLD_EXITED && info.si_status == EXIT_SUCCESS) || w->signalled || supervisor->stopping;
+    if (!normal) {
+        supervisor->stats.abnormalExits++;
+        if (info.si_code == CLD_EXITED) {
+            logMessage(LOG_WARNING, "[Supervisor] %s %d (pid %d) exited with status %d after %.1f s.",
+                       KIND_NAMES[w->kind], w->id, (int)w->pid, info.si_status, lifetime);
+        } else {
+            logMessage(LOG_WARNING, "[Supervisor] %s %d (pid %d) was killed by signal %d after %.1f s.",
+                       KIND_NAMES[w->kind], w->id, (int)w->pid, info.si_status, lifetime);
+        }
+    }
+
+    if (w->kind == SUPERVISED_BEE) {
+        supervisor->stats.beeExits++;
+        supervisor->stats.beeLifetimeSum += lifetime;
+        if (lifetime > supervisor->stats.maxBeeLifetime) supervisor->stats.maxBeeLifetime = lifetime;
+
+        // A bee that died on its own terms has released its slot; anything else is reconciled
+        const BeeSlot* s = &supervisor->table->slots[w->slot];
+        if (!normal && __atomic_load_n(&s->state, __ATOMIC_ACQUIRE) != BEE_SLOT_FREE && s->id == w->id) {
+            eventBusPublish(supervisor->events, HIVE_EVENT_DEATH, w->id, s->entrance, s->visits, HIVE_EVENT_ABNORMAL);
+            requestHiveRepair(supervisor->semaphores);
+            if (lockHive(supervisor->semaphores, supervisor->hive, supervisor->table) == 0) {
+                robustUnlock(&supervisor->semaphores->hiveSem);
+                supervisor->stats.reconciled++;
+            }
+        }
+    }
+
+    // Children may share the pidfd's open file, so it has to leave the epoll set explicitly
+    epoll_ctl(supervisor->epfd, EPOLL_CTL_DEL, w->pidfd, NULL);
+    close(w->pidfd);
+    Watched* last = supervisor->live[--supervisor->liveCount];
+    supervisor->live[w->index] = last;
+    last->index = w->index;
+    supervisor->running[w->kind]--;
+    free(w);
+}
+
+int supervisorAddWakeFd(Supervisor* supervisor, int fd) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &wakeMarker};
+    return epoll_ctl(supervisor->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void supervisorRemoveWakeFd(Supervisor* supervisor, int fd) {
+    epoll_ctl(supervisor->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int supervisorPoll(Supervisor* supervisor, int timeoutMs) {
+    struct epoll_event events[SUPERVISOR_EVENT_BATCH];
+    int count = epoll_wait(supervisor->epfd, events, SUPERVISOR_EVENT_BATCH, timeoutMs);
+    if (count == -1) {
+        if (errno != EINTR) {
+            return -1;
+        }
+        count = 0;
+    }
+
+    // Requests first, so the batch's exits are reaped after the newborns are watched
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.ptr == NULL && supervisor->spawnFd != -1) {
+            readSpawnRequests(supervisor);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.ptr != NULL && events[i].data.ptr != &wakeMarker) {
+            reap(supervisor, events[i].data.ptr);
+        }
+    }
+    return supervisor->liveCount;
+}
+
+void supervisorShutdown(Supervisor* supervisor) {
+    supervisor->stopping = true;
+    if (supervisor->spawnFd != -1) {
+        epoll_ctl(supervisor->epfd, EPOLL_CTL_DEL, supervisor->spawnFd, NULL);
+        close(supervisor->spawnFd);
+        supervisor->spawnFd = -1;
+    }
+}
+
+bool supervisorExpectsSpawns(const Supervisor* supervisor) {
+    return supervisor->spawnFd != -1;
+}
+
+int supervisorRunning(const Supervisor* supervisor, SupervisedKind kind) {
+    return supervisor->running[kind];
+}
+
+int supervisorSignal(Supervisor* supervisor, SupervisedKind kind, int sig) {
+    int failures = 0;
+    for (int i = 0; i < supervisor->liveCount; i++) {
+        Watched* w = supervisor->live[i];
+        if (w->kind != kind) continue;
+        if (syscall(SYS_pidfd_send_signal, w->pidfd, sig, NULL, 0) == -1) {
+            if (errno != ESRCH) failures++;
+        } else {
+            w->signalled = true;
+        }
+    }
+    return failures ? -1 : 0;
+}
+
+int supervisorSignalBee(Supervisor* supervisor, int id, int slot, int sig) {
+    for (int i = 0; i < supervisor->liveCount; i++) {
+        Watched* w = supervisor->live[i];
+        if (w->kind != SUPERVISED_BEE || w->id != id || w->slot != slot) continue;
+        if (syscall(SYS_pidfd_send_signal, w->pidfd, sig, NULL, 0) == -1) {
+            return -1;
+        }
+        w->signalled = true;
+        return 0;
+    }
+    errno = ESRCH;
+    return -1;
+}
+
+int supervisorKillBee(Supervisor* supervisor, int id, int slot) {
+    for (int i = 0; i < supervisor->liveCount; i++) {
+        Watched* w = supervisor->live[i];
+        if (w->kind != SUPERVISED_BEE || w->id != id || w->slot != slot) continue;
+        return (int)syscall(SYS_pidfd_send_signal, w->pidfd, SIGKILL, NULL, 0);
+    }
+    errno = ESRCH;
+    return -1;
+}
+
+void supervisorStats(const Supervisor* supervisor, SupervisorStats* stats) {
+    *stats = supervisor->stats;
+}
+
+void supervisorDestroy(Supervisor* supervisor) {
+    for (int i = 0; i < supervisor->liveCount; i++) {
+        epoll_ctl(supervisor->epfd, EPOLL_CTL_DEL, supervisor->live[i]->pidfd, NULL);
+        close(supervisor->live[i]->pidfd);
+        free(supervisor->live[i]);
+    }
+    if (supervisor->spawnFd != -1) {
+        close(supervisor->spawnFd);
+    }
+    close(supervisor->epfd);
+    free(supervisor->live);
+    free(supervisor);
+}
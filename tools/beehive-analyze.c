@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <zlib.h>
+
+/**
+ * Minimum chunk size handed to a parser thread. Smaller files are parsed by fewer threads.
+ */
+#define MIN_CHUNK_BYTES (1 << 20)
+
+/**
+ * Length of the timestamp prefix written by logMessage: "[dd-mm-yyyy hh:mm:ss] ".
+ */
+#define TIMESTAMP_LEN 22
+
+/**
+ * Per-second occupancy bucket.
+ */
+typedef struct {
+    int last;    // Occupancy reported by the last line of the second (-1 if none).
+    int max;     // Highest occupancy reported during the second (-1 if none).
+    long sum;    // Sum of reported occupancies.
+    int count;   // Number of reports.
+} OccupancyBucket;
+
+/**
+ * Per-bee history reconstructed from the log.
+ */
+typedef struct {
+    int visits;        // "Entering" lines.
+    int64_t firstSeen; // Timestamp of the first line mentioning the bee (0 if never seen).
+    int64_t died;      // Timestamp of the "Dying" line (0 if the bee did not die).
+    bool bornInHive;   // Whether a "Starting in the hive" line was seen.
+} BeeHistory;
+
+/**
+ * Everything one parser thread extracts from its chunk. Chunks are merged in file
+ * order, so later chunks win when a value is "the last one seen".
+ */
+typedef struct {
+    const char* begin;         // First byte of the chunk (start of a line).
+    const char* end;           // One past the last byte (end of a line).
+    int64_t base;              // Timestamp of buckets[0].
+    int64_t top;               // Latest timestamp with an occupancy report.
+    OccupancyBucket* buckets;  // Occupancy per second since base.
+    size_t bucketCount;
+    BeeHistory* bees;          // Indexed by bee ID.
+    size_t beeCount;
+    long enter[2];             // Entries per entrance.
+    long leave[2];             // Exits per entrance.
+    long deaths;
+    long births;               // "Starting in the hive" lines.
+    long layEvents;            // "[Queen] Laid" lines with at least one egg.
+    long eggsLaid;
+    long skipEvents;           // "[Queen] Not enough space" lines.
+    long lines;
+    long malformed;            // Lines without a parsable timestamp.
+} ChunkResult;
+
+/**
+ * Converts a civil date to days since 1970-01-01 (proleptic Gregorian calendar).
+ */
+static int64_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/**
+ * Parses two decimal digits.
+ */
+static inline int twoDigits(const char* p) {
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+/**
+ * parseTimestamp:
+ * Parses the "[dd-mm-yyyy hh:mm:ss]" prefix written by logMessage into seconds
+ * since the epoch (local time taken as-is; only differences are used).
+ *
+ * @return The timestamp, or -1 if the line does not start with a timestamp.
+ */
+static int64_t parseTimestamp(const char* p, const char* end) {
+    if (end - p < TIMESTAMP_LEN || p[0] != '[' || p[3] != '-' || p[6] != '-' || p[11] != ' ' ||
+        p[14] != ':' || p[17] != ':' || p[20] != ']') {
+        return -1;
+    }
+    int day = twoDigits(p + 1), month = twoDigits(p + 4);
+    int year = twoDigits(p + 7) * 100 + twoDigits(p + 9);
+    int hour = twoDigits(p + 12), minute = twoDigits(p + 15), second = twoDigits(p + 18);
+    return daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+/**
+ * Parses a non-negative decimal integer and advances the cursor past it.
+ *
+ * @return The value, or -1 if no digit is present.
+ */
+static long parseNumber(const char** cursor, const char* end) {
+    const char* p = *cursor;
+    long value = 0;
+    bool any = false;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+        any = true;
+    }
+    *cursor = p;
+    return any ? value : -1;
+}
+
+/**
+ * Returns whether [p, end) starts with the given literal, advancing p past it if so.
+ */
+static inline bool consume(const char** p, const char* end, const char* literal, size_t len) {
+    if ((size_t)(end - *p) < len || memcmp(*p, literal, len) != 0) return false;
+    *p += len;
+    return true;
+}
+#define CONSUME(p, end, lit) consume(&(p), (end), (lit), sizeof(lit) - 1)
+
+/**
+ * Returns the history slot of a bee, growing the table as needed.
+ */
+static BeeHistory* beeSlot(ChunkResult* r, long id) {
+    if (id < 0) return NULL;
+    if ((size_t)id >= r->beeCount) {
+        size_t count = r->beeCount ? r->beeCount : 1024;
+        while (count <= (size_t)id) count *= 2;
+        BeeHistory* bees = realloc(r->bees, count * sizeof(BeeHistory));
+        if (!bees) return NULL;
+        memset(bees + r->beeCount, 0, (count - r->beeCount) * sizeof(BeeHistory));
+        r->bees = bees;
+        r->beeCount = count;
+    }
+    return &r->bees[id];
+}
+
+/**
+ * Records an occupancy report in the per-second buckets, growing them in either direction.
+ */
+static void recordOccupancy(ChunkResult* r, int64_t ts, int occupancy) {
+    if (r->bucketCount == 0) {
+        r->base = ts;
+    }
+    if (ts < r->base) {
+        // Out-of-order line from a process that logged late: shift the buckets
+        size_t shift = (size_t)(r->base - ts);
+        OccupancyBucket* b = realloc(r->buckets, (r->bucketCount + shift) * sizeof(OccupancyBucket));
+        if (!b) return;
+        memmove(b + shift, b, r->bucketCount * sizeof(OccupancyBucket));
+        for (size_t i = 0; i < shift; i++) b[i] = (OccupancyBucket){-1, -1, 0, 0};
+        r->buckets = b;
+        r->bucketCount += shift;
+        r->base = ts;
+    }
+    size_t at = (size_t)(ts - r->base);
+    if (at >= r->bucketCount) {
+        size_t count = r->bucketCount ? r->bucketCount : 256;
+        while (count <= at) count *= 2;
+        OccupancyBucket* b = realloc(r->buckets, count * sizeof(OccupancyBucket));
+        if (!b) return;
+        for (size_t i = r->bucketCount; i < count; i++) b[i] = (OccupancyBucket){-1, -1, 0, 0};
+        r->buckets = b;
+        r->bucketCount = count;
+    }
+    if (ts > r->top) r->top = ts;
+    r->buckets[at].last = occupancy;
+    if (occupancy > r->buckets[at].max) r->buckets[at].max = occupancy;
+    r->buckets[at].sum += occupancy;
+    r->buckets[at].count++;
+}
+
+/**
+ * parseLine:
+ * Extracts the events of one log line. Only the message formats produced by
+ * beeWorker and queenWorker are interpreted; everything else is counted and skipped.
+ */
+static void parseLine(ChunkResult* r, const char* p, const char* end) {
+    r->lines++;
+    int64_t ts = parseTimestamp(p, end);
+    if (ts < 0) {
+        r->malformed++;
+        return;
+    }
+    p += TIMESTAMP_LEN;
+
+    // Level tag: "[INFO] ", "[WARNING] ", ...
+    const char* close = memchr(p, ']', end - p);
+    if (!close || close + 2 > end) return;
+    p = close + 2;
+
+    if (CONSUME(p, end, "[Bee ")) {
+        long id = parseNumber(&p, end);
+        if (id < 0 || !CONSUME(p, end, "] ")) return;
+        BeeHistory* bee = beeSlot(r, id);
+        if (!bee) return;
+        if (bee->firstSeen == 0 || ts < bee->firstSeen) bee->firstSeen = ts;
+
+        bool entering = CONSUME(p, end, "Entering through entrance ");
+        if (entering || CONSUME(p, end, "Leaving through entrance ")) {
+            long entrance = parseNumber(&p, end);
+            if (CONSUME(p, end, ". (Bees in hive: ")) {
+                long occupancy = parseNumber(&p, end);
+                if (occupancy >= 0) recordOccupancy(r, ts, (int)occupancy);
+            }
+            if (entrance == 0 || entrance == 1) {
+                if (entering) r->enter[entrance]++;
+                else r->leave[entrance]++;
+            }
+            if (entering) bee->visits++;
+        } else if (CONSUME(p, end, "Dying.")) {
+            bee->died = ts;
+            r->deaths++;
+        } else if (CONSUME(p, end, "Starting in the hive.")) {
+            bee->bornInHive = true;
+            r->births++;
+        }
+    } else if (CONSUME(p, end, "[Queen] ")) {
+        if (CONSUME(p, end, "Laid ")) {
+            // Written once per cycle by layEggs, fixed or adaptive, with the eggs actually laid
+            long eggs = parseNumber(&p, end);
+            if (eggs > 0) {
+                r->layEvents++;
+                r->eggsLaid += eggs;
+            }
+        } else if (CONSUME(p, end, "Not enough space")) {
+            r->skipEvents++;
+        }
+    }
+}
+
+/**
+ * Thread body: parses every line of one chunk straight from the mapping.
+ */
+static void* parseChunk(void* arg) {
+    ChunkResult* r = arg;
+    const char* p = r->begin;
+    while (p < r->end) {
+        const char* nl = memchr(p, '\n', r->end - p);
+        const char* lineEnd = nl ? nl : r->end;
+        parseLine(r, p, lineEnd);
+        p = lineEnd + 1;
+    }
+    return NULL;
+}
+
+/**
+ * Decompresses a gzip-compressed log segment (as rotated by --log-segment) into memory,
+ * where it is cut into chunks and parsed like a mapped file.
+ *
+ * @param fd Descriptor of the segment; always closed.
+ * @param size Receives the decompressed size.
+ * @return The decompressed text (to free), or NULL if the segment cannot be read.
+ */
+static char* inflateLog(int fd, size_t* size) {
+    gzFile in = gzdopen(fd, "rb");
+    if (!in) {
+        close(fd);
+        return NULL;
+    }
+    gzbuffer(in, 1 << 17);
+    size_t capacity = 1 << 20, length = 0;
+    char* text = malloc(capacity);
+    while (text) {
+        if (length == capacity) {
+            char* grown = realloc(text, capacity * 2);
+            if (!grown) break;
+            text = grown;
+            capacity *= 2;
+        }
+        size_t room = capacity - length;
+        int got = gzread(in, text + length, room > (1u << 30) ? (1u << 30) : (unsigned)room);
+        if (got <= 0) {
+            if (got == 0) {
+                gzclose(in);
+                *size = length;
+                return text;
+            }
+            break; // Truncated or corrupt data
+        }
+        length += (size_t)got;
+    }
+    free(text);
+    gzclose(in);
+    return NULL;
+}
+
+/**
+ * Prints the command-line usage of the analyzer.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] [beehive.log ...]\n"
+            "Reconstructs colony activity from simulation logs using parallel parsers.\n"
+            "Several files (e.g. log segments) are analyzed as one log, in the given order;\n"
+            "gzip-compressed segments (beehive.log.<seq>.gz) are decompressed in memory.\n"
+            "  -j THREADS   Parser threads (default: number of online CPUs)\n"
+            "  -o FILE      Write occupancy per second as CSV to FILE\n"
+            "  -b FILE      Write per-bee visits and lifetimes as CSV to FILE\n",
+            prog);
+}
+
+/**
+ * Entry point of beehive-analyze.
+ *
+ * Detailed functionality:
+ * 1. Memory-maps every input file and splits it into line-aligned chunks.
+ * 2. Parses the chunks in parallel threads without copying lines.
+ * 3. Merges the per-chunk results in file order and prints the report.
+ */
+int main(int argc, char* argv[]) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* occupancyPath = NULL;
+    const char* beesPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:o:b:h")) != -1) {
+        switch (opt) {
+            case 'j': threads = atol(optarg); break;
+            case 'o': occupancyPath = optarg; break;
+            case 'b': beesPath = optarg; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (threads < 1) threads = 1;
+
+    int fileCount = argc - optind;
+    const char* defaultFile = "beehive.log";
+    const char** files = fileCount > 0 ? (const char**)&argv[optind] : &defaultFile;
+    if (fileCount == 0) fileCount = 1;
+
+    struct timespec start, finish;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Map the inputs and cut them into line-aligned chunks
+    size_t maxChunks = (size_t)threads * fileCount;
+    ChunkResult* chunks = calloc(maxChunks, sizeof(ChunkResult));
+    void** maps = calloc(fileCount, sizeof(void*));
+    size_t* sizes = calloc(fileCount, sizeof(size_t));
+    bool* inflated = calloc(fileCount, sizeof(bool));
+    if (!chunks || !maps || !sizes || !inflated) {
+        perror("[Analyze] calloc");
+        return 1;
+    }
+    size_t chunkCount = 0, totalBytes = 0;
+    for (int f = 0; f < fileCount; f++) {
+        int fd = open(files[f], O_RDONLY);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1) {
+            fprintf(stderr, "[Analyze] Cannot open %s: %s\n", files[f], strerror(errno));
+            return 1;
+        }
+        sizes[f] = (size_t)st.st_size;
+        unsigned char magic[2];
+        if (sizes[f] == 0) {
+            close(fd);
+            continue;
+        } else if (pread(fd, magic, sizeof(magic), 0) == 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+            // Rotated segments are gzipped by the log compressor
+            maps[f] = inflateLog(fd, &sizes[f]);
+            if (!maps[f]) {
+                fprintf(stderr, "[Analyze] Cannot decompress %s\n", files[f]);
+                return 1;
+            }
+            inflated[f] = true;
+        } else {
+            maps[f] = mmap(NULL, sizes[f], PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (maps[f] == MAP_FAILED) {
+                fprintf(stderr, "[Analyze] Cannot map %s: %s\n", files[f], strerror(errno));
+                return 1;
+            }
+            // The advice values are not flags: each one takes a call of its own
+            madvise(maps[f], sizes[f], MADV_SEQUENTIAL);
+            madvise(maps[f], sizes[f], MADV_WILLNEED);
+        }
+        totalBytes += sizes[f];
+
+        const char* data = maps[f];
+        const char* end = data + sizes[f];
+        size_t pieces = sizes[f] / MIN_CHUNK_BYTES + 1;
+        if (pieces > (size_t)threads) pieces = (size_t)threads;
+        size_t step = sizes[f] / pieces;
+        const char* p = data;
+        for (size_t i = 0; i < pieces && p < end; i++) {
+            const char* cut = (i == pieces - 1) ? end : data + (i + 1) * step;
+            if (cut < p) cut = p;
+            if (cut < end) {
+                const char* nl = memchr(cut, '\n', end - cut);
+                cut = nl ? nl + 1 : end;
+            }
+            chunks[chunkCount].begin = p;
+            chunks[chunkCount].end = cut;
+            chunkCount++;
+            p = cut;
+        }
+    }
+
+    // Parse in parallel, at most `threads` chunks at a time
+    pthread_t* tids = calloc(chunkCount, sizeof(pthread_t));
+    for (size_t first = 0; first < chunkCount; first += threads) {
+        size_t last = first + threads < chunkCount ? first + threads : chunkCount;
+        for (size_t i = first; i < last; i++) {
+            if (pthread_create(&tids[i], NULL, parseChunk, &chunks[i]) != 0) {
+                parseChunk(&chunks[i]);
+                tids[i] = 0;
+            }
+        }
+        for (size_t i = first; i < last; i++) {
+            if (tids[i]) pthread_join(tids[i], NULL);
+        }
+    }
+
+    // Merge in file order
+    ChunkResult total = {0};
+    int64_t minTs = INT64_MAX, maxTs = INT64_MIN;
+    size_t maxBees = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        ChunkResult* c = &chunks[i];
+        for (int e = 0; e < 2; e++) {
+            total.enter[e] += c->enter[e];
+            total.leave[e] += c->leave[e];
+        }
+        total.deaths += c->deaths;
+        total.births += c->births;
+        total.layEvents += c->layEvents;
+        total.eggsLaid += c->eggsLaid;
+        total.skipEvents += c->skipEvents;
+        total.lines += c->lines;
+        total.malformed += c->malformed;
+        if (c->bucketCount > 0) {
+            if (c->base < minTs) minTs = c->base;
+            if (c->top > maxTs) maxTs = c->top;
+        }
+        if (c->beeCount > maxBees) maxBees = c->beeCount;
+    }
+
+    size_t seconds = minTs <= maxTs ? (size_t)(maxTs - minTs + 1) : 0;
+    OccupancyBucket* occupancy = calloc(seconds ? seconds : 1, sizeof(OccupancyBucket));
+    BeeHistory* bees = calloc(maxBees ? maxBees : 1, sizeof(BeeHistory));
+    for (size_t s = 0; s < seconds; s++) occupancy[s].last = occupancy[s].max = -1;
+    for (size_t i = 0; i < chunkCount; i++) {
+        ChunkResult* c = &chunks[i];
+        for (size_t b = 0; c->bucketCount > 0 && b <= (size_t)(c->top - c->base); b++) {
+            if (c->buckets[b].count == 0) continue;
+            OccupancyBucket* o = &occupancy[c->base + (int64_t)b - minTs];
+            o->last = c->buckets[b].last;
+            if (c->buckets[b].max > o->max) o->max = c->buckets[b].max;
+            o->sum += c->buckets[b].sum;
+            o->count += c->buckets[b].count;
+        }
+        for (size_t b = 0; b < c->beeCount; b++) {
+            BeeHistory* src = &c->bees[b];
+            if (src->firstSeen == 0) continue;
+            BeeHistory* dst = &bees[b];
+            dst->visits += src->visits;
+            if (dst->firstSeen == 0 || src->firstSeen < dst->firstSeen) dst->firstSeen = src->firstSeen;
+            if (src->died > dst->died) dst->died = src->died;
+            dst->bornInHive |= src->bornInHive;
+        }
+        free(c->buckets);
+        free(c->bees);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    double elapsed = (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1e9;
+
+    // Report
+    long seen = 0, dead = 0, visitSum = 0;
+    double lifetimeSum = 0;
+    int64_t lifetimeMax = 0;
+    for (size_t b = 0; b < maxBees; b++) {
+        if (bees[b].firstSeen == 0) continue;
+        seen++;
+        visitSum += bees[b].visits;
+        if (bees[b].died) {
+            int64_t life = bees[b].died - bees[b].firstSeen;
+            dead++;
+            lifetimeSum += life;
+            if (life > lifetimeMax) lifetimeMax = life;
+        }
+    }
+    long occupancySum = 0, occupancyCount = 0;
+    int occupancyMax = 0;
+    for (size_t s = 0; s < seconds; s++) {
+        occupancySum += occupancy[s].sum;
+        occupancyCount += occupancy[s].count;
+        if (occupancy[s].max > occupancyMax) occupancyMax = occupancy[s].max;
+    }
+
+    printf("Parsed %ld lines (%.1f MB) in %.3f s with %ld threads (%.1f MB/s)\n", total.lines,
+           totalBytes / 1e6, elapsed, threads, elapsed > 0 ? totalBytes / 1e6 / elapsed : 0.0);
+    if (total.malformed) printf("Lines without timestamp: %ld\n", total.malformed);
+    printf("Time span:          %zu s\n", seconds);
+    printf("Occupancy:          mean %.2f, max %d\n",
+           occupancyCount ? (double)occupancySum / occupancyCount : 0.0, occupancyMax);
+    printf("Entrance 0 traffic: %ld in, %ld out\n", total.enter[0], total.leave[0]);
+    printf("Entrance 1 traffic: %ld in, %ld out\n", total.enter[1], total.leave[1]);
+    printf("Bees seen:          %ld (%ld born in the hive), %ld died\n", seen, total.births, total.deaths);
+    printf("Visits per bee:     %.2f\n", seen ? (double)visitSum / seen : 0.0);
+    printf("Lifetime of dead:   mean %.1f s, max %lld s\n", dead ? lifetimeSum / dead : 0.0, (long long)lifetimeMax);
+    printf("Queen:              %ld laying events (%ld eggs), %ld skipped\n",
+           total.layEvents, total.eggsLaid, total.skipEvents);
+
+    if (occupancyPath) {
+        FILE* out = fopen(occupancyPath, "w");
+        if (!out) {
+            perror("[Analyze] fopen");
+        } else {
+            fprintf(out, "second,occupancy,mean,reports\n");
+            int current = 0;
+            for (size_t s = 0; s < seconds; s++) {
+                if (occupancy[s].last >= 0) current = occupancy[s].last;
+                fprintf(out, "%zu,%d,%.2f,%d\n", s, current,
+                        occupancy[s].count ? (double)occupancy[s].sum / occupancy[s].count : (double)current,
+                        occupancy[s].count);
+            }
+            fclose(out);
+        }
+    }
+    if (beesPath) {
+        FILE* out = fopen(beesPath, "w");
+        if (!out) {
+            perror("[Analyze] fopen");
+        } else {
+            fprintf(out, "bee,visits,firstSeen,lifetime,bornInHive\n");
+            for (size_t b = 0; b < maxBees; b++) {
+                if (bees[b].firstSeen == 0) continue;
+                fprintf(out, "%zu,%d,%lld,%lld,%d\n", b, bees[b].visits,
+                        (long long)(bees[b].firstSeen - (minTs == INT64_MAX ? 0 : minTs)),
+                        bees[b].died ? (long long)(bees[b].died - bees[b].firstSeen) : -1LL,
+                        bees[b].bornInHive ? 1 : 0);
+            }
+            fclose(out);
+        }
+    }
+
+    for (int f = 0; f < fileCount; f++) {
+        if (inflated[f]) free(maps[f]);
+        else if (maps[f] && maps[f] != MAP_FAILED) munmap(maps[f], sizes[f]);
+    }
+    free(occupancy);
+    free(bees);
+    free(tids);
+    free(chunks);
+    free(maps);
+    free(sizes);
+    free(inflated);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "beetable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+/**
+ * Display names of the BeeSlotState values.
+ */
+static const char* const STATE_NAMES[] = {"free", "outside", "queued-in", "inside", "queued-out"};
+
+/**
+ * Prints the command-line usage of the bee table viewer.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <table>\n"
+            "Shows the per-bee state table of a running simulation (path as logged by [MAIN]).\n"
+            "  -l    List every occupied slot\n",
+            prog);
+}
+
+/**
+ * Entry point of the bee table viewer.
+ *
+ * Detailed functionality:
+ * 1. Maps the table read-only.
+ * 2. Counts the bees in each lifecycle state in a single pass over the slots.
+ * 3. Optionally lists every occupied slot with its age and time since the last transition.
+ */
+int main(int argc, char* argv[]) {
+    bool list = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "lh")) != -1) {
+        switch (opt) {
+            case 'l': list = true; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const BeeTable* table = beeTableAttach(argv[optind]);
+    if (!table) {
+        fprintf(stderr, "Error: cannot map bee table %s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t now = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+
+    long counts[BEE_SLOT_QUEUED_OUT + 1] = {0};
+    if (list) {
+        printf("%8s %8s %-10s %6s %5s %8s %10s %10s\n", "slot", "id", "state", "visits", "frame", "pid", "age[s]", "since[s]");
+    }
+    for (uint64_t i = 0; i < table->capacity; i++) {
+        const BeeSlot* s = &table->slots[i];
+        uint8_t state = __atomic_load_n(&s->state, __ATOMIC_ACQUIRE);
+        if (state > BEE_SLOT_QUEUED_OUT) continue;
+        counts[state]++;
+        if (list && state != BEE_SLOT_FREE) {
+            printf("%8lu %8d %-10s %6u %5u %8d %10.2f %10.2f\n", (unsigned long)i, s->id, STATE_NAMES[state],
+                   s->visits, s->frame, (int)s->pid, (now - s->bornAt) / 1e9, (now - s->changedAt) / 1e9);
+        }
+    }
+
+    printf("Table %s: %lu slots, %zu bytes%s\n", argv[optind], (unsigned long)table->capacity,
+           table->mappedBytes, table->hugePages ? " (huge pages)" : "");
+    printf("  used %d, high water %d\n", table->used, table->highWater);
+    for (int s = BEE_SLOT_OUTSIDE; s <= BEE_SLOT_QUEUED_OUT; s++) {
+        printf("  %-10s %ld\n", STATE_NAMES[s], counts[s]);
+    }
+
+    beeTableDetach(table);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "configpage.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+/**
+ * Prints the command-line usage of the configuration tool.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <page> [NAME=VALUE ...]\n"
+            "Shows or changes the live parameters of a running simulation (page as logged by [MAIN]).\n"
+            "Changes are published together and take effect at the next lifecycle step of every bee.\n"
+            "  -f FILE    Load the parameters in FILE (name = value lines) before the assignments\n",
+            prog);
+}
+
+/**
+ * Prints the version and every parameter of a page.
+ */
+static void printValues(const HiveTunables* values, uint64_t version) {
+    printf("version %llu\n", (unsigned long long)version);
+    for (int i = 0; configName(i); i++) {
+        printf("%s = %d\n", configName(i), configValue(values, i));
+    }
+}
+
+/**
+ * applyChanges:
+ * Applies the file and the assignments to a copy of the current parameters.
+ *
+ * @return 0 on success, or -1 after printing the problem.
+ */
+static int applyChanges(HiveTunables* values, const char* file, char** assignments, int count) {
+    if (file) {
+        char error[512];
+        if (configLoad(file, values, error, sizeof(error)) == -1) {
+            fprintf(stderr, "Error: %s\n", error);
+            return -1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        char name[64];
+        int value;
+        char extra;
+        if (sscanf(assignments[i], "%63[A-Za-z_]=%d%c", name, &value, &extra) != 2 ||
+            configSet(values, name, value) == -1) {
+            fprintf(stderr, "Error: invalid assignment '%s'\n", assignments[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Entry point of the configuration tool.
+ *
+ * Detailed functionality:
+ * 1. Maps the configuration page of the colony and takes a consistent copy of it.
+ * 2. Without changes, prints the parameters and their version.
+ * 3. Otherwise applies the file and the assignments to the copy, checks it and publishes
+ *    it in one write; if another writer got in first, starts over from its values.
+ */
+int main(int argc, char* argv[]) {
+    const char* file = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:h")) != -1) {
+        switch (opt) {
+            case 'f': file = optarg; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[optind];
+    ConfigPage* page = configPageAttach(path);
+    if (!page) {
+        fprintf(stderr, "Error: cannot map configuration page %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    char** assignments = &argv[optind + 1];
+    int count = argc - optind - 1;
+    bool changes = file || count > 0;
+
+    int result = 1;
+    bool reported = false;
+    for (int attempt = 0; attempt < CONFIG_PAGE_READ_ATTEMPTS; attempt++) {
+        HiveTunables values;
+        uint64_t version;
+        if (!configPageRead(page, &values, &version)) {
+            continue;
+        }
+        if (!changes) {
+            printValues(&values, version);
+            result = 0;
+            break;
+        }
+        if (applyChanges(&values, file, assignments, count) == -1) {
+            reported = true;
+            break;
+        }
+        const char* invalid = configCheck(&values, page->capacity);
+        if (invalid) {
+            fprintf(stderr, "Error: %s\n", invalid);
+            reported = true;
+            break;
+        }
+        uint64_t written = configPageWrite(page, &values, version);
+        if (written != 0) {
+            printValues(&values, written);
+            result = 0;
+            break;
+        }
+        if (errno != EAGAIN) {
+            fprintf(stderr, "Error: cannot update %s: %s\n", path, strerror(errno));
+            reported = true;
+            break;
+        }
+    }
+    if (result != 0 && !reported) {
+        fprintf(stderr, "Error: %s is being updated; try again.\n", path);
+    }
+    configPageDetach(page);
+    return result;
+}
@@ -0,0 +1,156 @@
+#include "eventbus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+/**
+ * Set by SIGINT to end the subscription.
+ */
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleStop(int sig) {
+    (void)sig;
+    stopRequested = 1;
+}
+
+/**
+ * Prints the command-line usage of the event viewer.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <bus>\n"
+            "Follows the event bus of a running simulation (path as logged by [MAIN]).\n"
+            "  -a            Start with the oldest event still kept instead of the next one\n"
+            "  -c            Print the number of events of each type every second instead of the events\n"
+            "  -d SECONDS    Stop after SECONDS (default: until interrupted)\n",
+            prog);
+}
+
+/**
+ * Tells whether the simulation still has its bus, i.e. has not finished.
+ */
+static bool busExists(const char* path) {
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        return errno != ENOENT;
+    }
+    close(fd);
+    return true;
+}
+
+/**
+ * Prints one event: time of day, type, bee, entrance, value and flags.
+ */
+static void printEvent(const HiveEvent* event) {
+    time_t seconds = (time_t)(event->time / 1000000000LL);
+    struct tm t;
+    localtime_r(&seconds, &t);
+    printf("%02d:%02d:%02d.%06ld %-7s bee %6d entrance %d value %6d%s%s%s\n",
+           t.tm_hour, t.tm_min, t.tm_sec, (long)(event->time % 1000000000LL) / 1000,
+           eventTypeName(event->type), (int)event->bee, event->entrance, (int)event->value,
+           event->flags & HIVE_EVENT_OUTBOUND ? " outbound" : "",
+           event->flags & HIVE_EVENT_ADDED ? " added" : "",
+           event->flags & HIVE_EVENT_ABNORMAL ? " abnormal" : "");
+}
+
+/**
+ * Prints the events counted since the last report, one column per type.
+ */
+static void printCounts(const long counts[HIVE_EVENT_TYPES], uint64_t lost) {
+    for (int type = HIVE_EVENT_QUEUE; type < HIVE_EVENT_TYPES; type++) {
+        printf("%s %ld  ", eventTypeName(type), counts[type]);
+    }
+    printf("lost %llu\n", (unsigned long long)lost);
+    fflush(stdout);
+}
+
+/**
+ * Entry point of the event viewer.
+ *
+ * Detailed functionality:
+ * 1. Maps the bus read-only and subscribes with a cursor of its own, so it never slows
+ *    the colony down: if it falls more than a lap behind, the overwritten events are counted as lost.
+ * 2. Prints every event, or the number of events of each type per second.
+ * 3. Stops on SIGINT, after the given duration, or when the simulation removes the bus,
+ *    and reports the events it lost.
+ */
+int main(int argc, char* argv[]) {
+    bool fromOldest = false;
+    bool countsOnly = false;
+    double duration = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "acd:h")) != -1) {
+        switch (opt) {
+            case 'a': fromOldest = true; break;
+            case 'c': countsOnly = true; break;
+            case 'd': duration = atof(optarg); break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[optind];
+    const EventBus* bus = eventBusAttach(path);
+    if (!bus) {
+        fprintf(stderr, "Error: cannot map event bus %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    signal(SIGINT, handleStop);
+
+    EventCursor cursor;
+    eventBusSubscribe(bus, &cursor, fromOldest);
+
+    long counts[HIVE_EVENT_TYPES] = {0};
+    uint64_t received = 0;
+    uint64_t reportedLost = 0;
+    double start = monotonicSeconds();
+    double nextReport = start + 1.0;
+    struct timespec idle = {0, 10 * 1000000L};
+    int idleRounds = 0;
+
+    while (!stopRequested) {
+        // Read in batches, so a busy colony cannot keep the reports and the duration from being checked
+        HiveEvent event;
+        int batch = 0;
+        while (batch < 4096 && eventBusNext(bus, &cursor, &event)) {
+            batch++;
+            if (event.type < HIVE_EVENT_TYPES) counts[event.type]++;
+            if (!countsOnly) printEvent(&event);
+        }
+        received += batch;
+
+        double t = monotonicSeconds();
+        if (countsOnly && t >= nextReport) {
+            printCounts(counts, cursor.lost - reportedLost);
+            memset(counts, 0, sizeof(counts));
+            reportedLost = cursor.lost;
+            nextReport += 1.0;
+        }
+        if (duration > 0 && t - start >= duration) {
+            break;
+        }
+        if (batch > 0) {
+            continue;
+        }
+        // The mapping outlives the object: check now and then whether the run is over
+        if (++idleRounds % 100 == 0 && !busExists(path)) {
+            break;
+        }
+        if (!countsOnly) fflush(stdout);
+        nanosleep(&idle, NULL);
+    }
+
+    printf("Received %llu events, lost %llu\n", (unsigned long long)received, (unsigned long long)cursor.lost);
+    eventBusDetach(bus);
+    return 0;
+}
@@ -0,0 +1,520 @@
+#include "beehive.h"
+#include <getopt.h>
+#include <sys/resource.h>
+
+/**
+ * Longest time (in milliseconds) the driver lets the colony wait before checking the
+ * schedule again.
+ */
+#define SCENARIO_STEP_MS 100
+
+/**
+ * Longest accepted line of a scenario file.
+ */
+#define SCENARIO_LINE_MAX 256
+
+/**
+ * Kinds of scenario actions.
+ */
+typedef enum {
+    ACTION_SET,   // Change a colony parameter.
+    ACTION_ADD,   // Add a burst of bees outside the hive.
+    ACTION_KILL,  // Kill a share of the living bees.
+    ACTION_STOP   // End the scenario.
+} ActionType;
+
+/**
+ * One line of a phase.
+ */
+typedef struct {
+    ActionType type;
+    BeehiveParameter parameter; // ACTION_SET: parameter to change.
+    int value;                  // ACTION_SET: new value; ACTION_ADD: number of bees.
+    double fraction;            // ACTION_KILL: share of the living bees.
+} ScenarioAction;
+
+/**
+ * A phase: the actions applied at its start time, and the metrics gathered until the
+ * next phase starts.
+ */
+typedef struct {
+    char name[32];            // Name in the report ("phase<k>" if the file gives none).
+    double at;                // Start time in seconds since the colony was created.
+    ScenarioAction* actions;
+    int actionCount;
+} ScenarioPhase;
+
+/**
+ * A parsed scenario file.
+ */
+typedef struct {
+    unsigned int seed;        // Seed of the random choices of the driver (which bees are killed).
+    ScenarioPhase* phases;
+    int phaseCount;
+    bool stops;               // Whether the last phase ends the scenario.
+} Scenario;
+
+/**
+ * Metrics of a phase being run.
+ */
+typedef struct {
+    BeehiveStatus start;      // Colony status when the phase started.
+    double occupancySum;      // Occupancy integrated over the phase so far, in bee-seconds.
+    double sampledTime;       // Seconds covered by occupancySum.
+    double lastSampleAt;      // Elapsed time of the last occupancy sample.
+    int lastOccupancy;        // Occupancy of the last sample, taken to hold until the next one.
+    int maxOccupancy;
+    int added;                // Bees added by the phase's actions.
+    int killed;               // Bees killed by the phase's actions.
+} PhaseRecord;
+
+/**
+ * Set by SIGINT and SIGTERM to end the scenario early.
+ */
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleStopSignal(int signum) {
+    (void)signum;
+    stopRequested = 1;
+}
+
+/**
+ * Prints the command-line usage of the scenario driver.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <scenario>\n"
+            "Runs a colony through the phases of a scenario file and reports the metrics of each phase.\n"
+            "  -o FILE          Also write the phase metrics as CSV to FILE\n"
+            "  -m PORT|PATH     Serve hive metrics in Prometheus text format (see beehive_simulation)\n"
+            "  -q               Disable console logging\n"
+            "Scenario lines ('#' starts a comment):\n"
+            "  seed VALUE       Seed of the random choices (before the first phase)\n"
+            "  at SECONDS [NAME] Start a phase SECONDS after the colony was created\n"
+            "  set PARAM VALUE  Set N, T_k, eggsCount, T_inHive, maxVisits, minOutsideTime, maxOutsideTime,\n"
+            "                   transitMs or maxBees\n"
+            "  add COUNT        Add COUNT bees outside the hive\n"
+            "  kill FRACTION    Kill FRACTION (0-1) of the living bees\n"
+            "  stop             End the scenario\n"
+            "The first phase is at 0 and must set N, T_k and eggsCount.\n",
+            prog);
+}
+
+/**
+ * Appends an action to a phase.
+ *
+ * @return 0 on success, or -1 if memory is exhausted.
+ */
+static int addAction(ScenarioPhase* phase, const ScenarioAction* action) {
+    ScenarioAction* actions = realloc(phase->actions, (size_t)(phase->actionCount + 1) * sizeof(ScenarioAction));
+    if (!actions) {
+        return -1;
+    }
+    phase->actions = actions;
+    phase->actions[phase->actionCount++] = *action;
+    return 0;
+}
+
+/**
+ * Releases the phases of a scenario.
+ */
+static void freeScenario(Scenario* scenario) {
+    for (int i = 0; i < scenario->phaseCount; i++) {
+        free(scenario->phases[i].actions);
+    }
+    free(scenario->phases);
+}
+
+/**
+ * parseScenario:
+ * Reads a scenario file. Errors are printed with the file name and line.
+ *
+ * @param path The scenario file.
+ * @param scenario Receives the scenario.
+ * @return 0 on success, or -1 on failure.
+ */
+static int parseScenario(const char* path, Scenario* scenario) {
+    memset(scenario, 0, sizeof(*scenario));
+    scenario->seed = 1;
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: cannot open scenario %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[SCENARIO_LINE_MAX];
+    int lineNumber = 0;
+    const char* error = NULL;
+    while (!error && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char keyword[32], argument[64], extra[64];
+        int fields = sscanf(line, "%31s %63s %63s", keyword, argument, extra);
+        if (fields <= 0) continue;
+        ScenarioPhase* phase = scenario->phaseCount ? &scenario->phases[scenario->phaseCount - 1] : NULL;
+
+        if (scenario->stops) {
+            error = "nothing may follow 'stop'";
+        } else if (strcmp(keyword, "seed") == 0) {
+            if (fields != 2 || phase) error = "'seed VALUE' must come before the first phase";
+            else scenario->seed = (unsigned int)strtoul(argument, NULL, 10);
+        } else if (strcmp(keyword, "at") == 0) {
+            char* end;
+            double at = fields >= 2 ? strtod(argument, &end) : -1;
+            if (fields < 2 || *end != '\0' || at < 0) {
+                error = "expected 'at SECONDS [NAME]'";
+            } else if (!phase && at != 0) {
+                error = "the first phase must be at 0";
+            } else if (phase && at < phase->at) {
+                error = "phases must be in chronological order";
+            } else {
+                ScenarioPhase* phases = realloc(scenario->phases, (size_t)(scenario->phaseCount + 1) * sizeof(ScenarioPhase));
+                if (!phases) {
+                    error = strerror(errno);
+                    break;
+                }
+                scenario->phases = phases;
+                phase = &phases[scenario->phaseCount++];
+                memset(phase, 0, sizeof(*phase));
+                phase->at = at;
+                if (fields == 3) snprintf(phase->name, sizeof(phase->name), "%.31s", extra);
+                else snprintf(phase->name, sizeof(phase->name), "phase%d", scenario->phaseCount);
+            }
+        } else if (!phase) {
+            error = "actions must follow an 'at' line";
+        } else {
+            ScenarioAction action = {0};
+            char* end = NULL;
+            if (strcmp(keyword, "set") == 0 && fields == 3) {
+                action.type = ACTION_SET;
+                action.parameter = BEEHIVE_PARAM_COUNT;
+                for (int p = 0; p < BEEHIVE_PARAM_COUNT; p++) {
+                    if (strcmp(argument, beehiveParameterName((BeehiveParameter)p)) == 0) {
+                        action.parameter = (BeehiveParameter)p;
+                    }
+                }
+                action.value = (int)strtol(extra, &end, 10);
+                if (action.parameter == BEEHIVE_PARAM_COUNT) error = "unknown parameter";
+                else if (*end != '\0') error = "the value must be an integer";
+            } else if (strcmp(keyword, "add") == 0 && fields == 2) {
+                action.type = ACTION_ADD;
+                action.value = (int)strtol(argument, &end, 10);
+                if (*end != '\0' || action.value <= 0) error = "expected 'add COUNT'";
+            } else if (strcmp(keyword, "kill") == 0 && fields == 2) {
+                action.type = ACTION_KILL;
+                action.fraction = strtod(argument, &end);
+                if (*end != '\0' || action.fraction < 0 || action.fraction > 1) error = "expected 'kill FRACTION' with 0 <= FRACTION <= 1";
+            } else if (strcmp(keyword, "stop") == 0 && fields == 1) {
+                action.type = ACTION_STOP;
+                scenario->stops = true;
+            } else {
+                error = "unknown action";
+            }
+            if (!error && addAction(phase, &action) == -1) {
+                error = strerror(errno);
+            }
+        }
+    }
+    fclose(file);
+
+    if (!error && scenario->phaseCount == 0) {
+        error = "the scenario has no phase";
+        lineNumber = 0;
+    }
+    if (error) {
+        if (lineNumber > 0) fprintf(stderr, "Error: %s:%d: %s\n", path, lineNumber, error);
+        else fprintf(stderr, "Error: %s: %s\n", path, error);
+        freeScenario(scenario);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Tells whether an action of the first phase is applied through BeehiveOptions, i.e.
+ * before the colony starts.
+ */
+static bool isStartupAction(const ScenarioAction* action) {
+    if (action->type != ACTION_SET) return false;
+    switch (action->parameter) {
+        case BEEHIVE_PARAM_N:
+        case BEEHIVE_PARAM_T_K:
+        case BEEHIVE_PARAM_EGGS_COUNT:
+        case BEEHIVE_PARAM_T_IN_HIVE:
+        case BEEHIVE_PARAM_MAX_VISITS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * applyActions:
+ * Applies the actions of a phase to the running colony.
+ *
+ * @param beehive The colony.
+ * @param phase The phase.
+ * @param skipStartup Skip the actions already applied through BeehiveOptions.
+ * @param seed State of the driver's random number generator.
+ * @param record Receives the number of bees added and killed.
+ */
+static void applyActions(Beehive* beehive, const ScenarioPhase* phase, bool skipStartup, unsigned int* seed, PhaseRecord* record) {
+    for (int i = 0; i < phase->actionCount; i++) {
+        const ScenarioAction* action = &phase->actions[i];
+        if (skipStartup && isStartupAction(action)) continue;
+        switch (action->type) {
+            case ACTION_SET:
+                beehiveSet(beehive, action->parameter, action->value);
+                break;
+            case ACTION_ADD:
+                record->added += beehiveAddBees(beehive, action->value);
+                break;
+            case ACTION_KILL: {
+                int killed = beehiveKillBees(beehive, action->fraction, seed);
+                if (killed > 0) record->killed += killed;
+                break;
+            }
+            case ACTION_STOP:
+                break;
+        }
+    }
+}
+
+/**
+ * Starts the metrics of a phase from the colony status at its start.
+ */
+static void startRecord(PhaseRecord* record, const BeehiveStatus* now) {
+    memset(record, 0, sizeof(*record));
+    record->start = *now;
+    record->lastSampleAt = now->elapsed;
+    record->lastOccupancy = now->occupancy;
+    record->maxOccupancy = now->occupancy;
+}
+
+/**
+ * sampleOccupancy:
+ * Adds an occupancy sample. Steps return on every process event, so samples come in bursts
+ * when the colony is busy: each one is weighted by the time since the previous sample, over
+ * which the previous occupancy held.
+ *
+ * @param record Metrics of the phase.
+ * @param now Current colony status.
+ */
+static void sampleOccupancy(PhaseRecord* record, const BeehiveStatus* now) {
+    double held = now->elapsed - record->lastSampleAt;
+    if (held > 0) {
+        record->occupancySum += record->lastOccupancy * held;
+        record->sampledTime += held;
+    }
+    record->lastSampleAt = now->elapsed;
+    record->lastOccupancy = now->occupancy;
+    if (now->occupancy > record->maxOccupancy) record->maxOccupancy = now->occupancy;
+}
+
+/**
+ * reportPhase:
+ * Prints the metrics of a finished phase, and appends them to the CSV file if any.
+ *
+ * @param phase The phase.
+ * @param record Metrics gathered during the phase, sampled up to its end.
+ * @param end Colony status at the end of the phase.
+ * @param csv CSV output, or NULL.
+ */
+static void reportPhase(const ScenarioPhase* phase, const PhaseRecord* record, const BeehiveStatus* end, FILE* csv) {
+    const BeehiveStatus* start = &record->start;
+    int entries = end->entries - start->entries;
+    int rejections = end->rejections - start->rejections;
+    int attempts = entries + rejections;
+    double rejectionRate = attempts > 0 ? (double)rejections / attempts : 0.0;
+    double meanOccupancy = record->sampledTime > 0 ? record->occupancySum / record->sampledTime : record->lastOccupancy;
+
+    printf("%-12s %7.1f %7.1f %6d %8d %8d %7.4f %7d %7lu %7lu %7d %8.2f %6d %6d %6d %8d\n",
+           phase->name, start->elapsed, end->elapsed, end->N, entries, rejections, rejectionRate,
+           end->deaths - start->deaths, end->eggsLaid - start->eggsLaid, end->eggsSkipped - start->eggsSkipped,
+           end->beesAlive, meanOccupancy, record->maxOccupancy, record->added, record->killed,
+           end->abnormalExits - start->abnormalExits);
+    if (csv) {
+        fprintf(csv, "%s,%.3f,%.3f,%d,%d,%d,%d,%d,%d,%d,%.4f,%d,%lu,%lu,%lu,%d,%.3f,%d,%d,%d,%d\n",
+                phase->name, start->elapsed, end->elapsed, end->N, end->tunables.T_k, end->tunables.eggsCount,
+                end->tunables.T_inHive, end->tunables.maxVisits, entries, rejections, rejectionRate,
+                end->deaths - start->deaths, end->eggsLaid - start->eggsLaid, end->eggsSkipped - start->eggsSkipped,
+                (end->transits[0] + end->transits[1]) - (start->transits[0] + start->transits[1]),
+                end->beesAlive, meanOccupancy, record->maxOccupancy, record->added, record->killed,
+                end->abnormalExits - start->abnormalExits);
+        fflush(csv);
+    }
+}
+
+/**
+ * Prints a colony error to stderr (error callback of the colony).
+ */
+static void printColonyError(void* user, const char* message, int errnum) {
+    (void)user;
+    fprintf(stderr, "Error: %s: %s\n", message, strerror(errnum));
+}
+
+/**
+ * Entry point of the scenario driver.
+ *
+ * Detailed functionality:
+ * 1. Parses the scenario; the settings of the first phase configure the new colony.
+ * 2. Starts every later phase when its time has come, applying its actions to the
+ *    running colony, and samples occupancy in between.
+ * 3. Reports the metrics of each phase as it ends: counter deltas, occupancy, and the
+ *    state of the colony at its end.
+ */
+int main(int argc, char* argv[]) {
+    const char* csvPath = NULL;
+    const char* metricsAddress = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:m:qh")) != -1) {
+        switch (opt) {
+            case 'o': csvPath = optarg; break;
+            case 'm': metricsAddress = optarg; break;
+            case 'q': logConfig.logToConsole = false; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Scenario scenario;
+    if (parseScenario(argv[optind], &scenario) == -1) {
+        return 1;
+    }
+
+    BeehiveOptions options;
+    beehiveDefaultOptions(&options);
+    for (int i = 0; i < scenario.phases[0].actionCount; i++) {
+        const ScenarioAction* action = &scenario.phases[0].actions[i];
+        if (!isStartupAction(action)) continue;
+        switch (action->parameter) {
+            case BEEHIVE_PARAM_N: options.N = action->value; break;
+            case BEEHIVE_PARAM_T_K: options.T_k = action->value; break;
+            case BEEHIVE_PARAM_EGGS_COUNT: options.eggsCount = action->value; break;
+            case BEEHIVE_PARAM_T_IN_HIVE: options.T_inHive = action->value; break;
+            case BEEHIVE_PARAM_MAX_VISITS: options.maxVisits = action->value; break;
+            default: break;
+        }
+    }
+    if (options.N <= 0 || options.T_k <= 0 || options.eggsCount <= 0 || options.T_inHive < 0 || options.maxVisits <= 0) {
+        fprintf(stderr, "Error: The first phase must set N, T_k and eggsCount to positive values.\n");
+        freeScenario(&scenario);
+        return 1;
+    }
+    options.metricsAddress = metricsAddress;
+    options.error = printColonyError;
+
+    FILE* csv = NULL;
+    if (csvPath) {
+        csv = fopen(csvPath, "w");
+        if (!csv) {
+            fprintf(stderr, "Error: cannot create %s: %s\n", csvPath, strerror(errno));
+            freeScenario(&scenario);
+            return 1;
+        }
+        fprintf(csv, "phase,start,end,N,T_k,eggsCount,T_inHive,maxVisits,entries,rejections,rejectionRate,"
+                     "deaths,eggsLaid,eggsSkipped,transits,beesAlive,meanOccupancy,maxOccupancy,added,killed,abnormalExits\n");
+    }
+
+    // The supervisor holds one pidfd per living process
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    Beehive* beehive = beehiveCreate(&options);
+    if (!beehive) {
+        if (csv) fclose(csv);
+        freeScenario(&scenario);
+        return 1;
+    }
+    struct sigaction stop = {0};
+    stop.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    printf("%-12s %7s %7s %6s %8s %8s %7s %7s %7s %7s %7s %8s %6s %6s %6s %8s\n",
+           "phase", "start", "end", "N", "entries", "rejected", "rejRate", "deaths", "laid", "skipped",
+           "alive", "meanOcc", "maxOcc", "added", "killed", "abnormal");
+
+    unsigned int seed = scenario.seed;
+    int current = 0;
+    PhaseRecord record;
+    BeehiveStatus initial;
+    beehiveQuery(beehive, &initial);
+    startRecord(&record, &initial);
+    applyActions(beehive, &scenario.phases[0], true, &seed, &record);
+    bool running = !(scenario.phaseCount == 1 && scenario.stops);
+    int status = 0;
+    if (!running) {
+        // A lone phase that stops at once still gets its line, with what its actions did
+        BeehiveStatus now;
+        beehiveQuery(beehive, &now);
+        sampleOccupancy(&record, &now);
+        reportPhase(&scenario.phases[0], &record, &now, csv);
+    }
+
+    while (running && !stopRequested) {
+        BeehiveStatus now;
+        beehiveQuery(beehive, &now);
+
+        // Start the next phase once its time has come
+        if (current + 1 < scenario.phaseCount && now.elapsed >= scenario.phases[current + 1].at) {
+            sampleOccupancy(&record, &now);
+            reportPhase(&scenario.phases[current], &record, &now, csv);
+            current++;
+            if (current == scenario.phaseCount - 1 && scenario.stops) {
+                running = false;
+                break;
+            }
+            startRecord(&record, &now);
+            logMessage(LOG_INFO, "[Scenario] Phase %s starts at %.1f s.", scenario.phases[current].name, now.elapsed);
+            applyActions(beehive, &scenario.phases[current], false, &seed, &record);
+            continue;
+        }
+
+        int timeoutMs = SCENARIO_STEP_MS;
+        if (current + 1 < scenario.phaseCount) {
+            int untilPhase = (int)((scenario.phases[current + 1].at - now.elapsed) * 1000) + 1;
+            if (untilPhase < timeoutMs) timeoutMs = untilPhase;
+        }
+        int result = beehiveStep(beehive, timeoutMs);
+        if (result == -1) {
+            status = 1;
+        }
+        if (result <= 0) {
+            break;
+        }
+
+        beehiveQuery(beehive, &now);
+        sampleOccupancy(&record, &now);
+    }
+
+    // A phase cut short by a signal or by the end of the colony is reported as it stands
+    if (running) {
+        BeehiveStatus now;
+        beehiveQuery(beehive, &now);
+        sampleOccupancy(&record, &now);
+        reportPhase(&scenario.phases[current], &record, &now, csv);
+    }
+
+    signal(SIGTERM, SIG_IGN);
+    if (beehiveStop(beehive) == -1) {
+        status = 1;
+    }
+    beehiveDestroy(beehive);
+    if (csv) fclose(csv);
+    freeScenario(&scenario);
+    return status;
+}
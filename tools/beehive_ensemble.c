@@ -0,0 +1,148 @@
+#include "ensemble.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+/**
+ * Prints the command-line usage of the ensemble runner.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <N> <T_k> <eggsCount>\n"
+            "Simulates many independent colonies with a vectorized time-stepped engine.\n"
+            "  -r REPLICAS   Number of independent colonies (default: 1024)\n"
+            "  -s STEPS      Simulated seconds per colony (default: 600)\n"
+            "  -v VISITS     Visits after which a bee dies\n"
+            "  -t SECONDS    Time spent inside the hive per visit\n"
+            "  -S SEED       Base random seed (default: current time)\n"
+            "  -o FILE       Write per-replica results as CSV to FILE\n",
+            prog);
+}
+
+/**
+ * Comparison function for qsort over integers.
+ */
+static int compareInt(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Entry point of the Monte Carlo ensemble runner.
+ *
+ * Detailed functionality:
+ * 1. Builds an ensemble of independent replicas of the colony described by the arguments.
+ * 2. Advances all replicas with the vectorized kernel and measures bee-steps per second.
+ * 3. Prints the aggregate occupancy and survival distributions and optionally the
+ *    per-replica results.
+ */
+int main(int argc, char* argv[]) {
+    EnsembleConfig config;
+    ensembleDefaultConfig(&config);
+    const char* csvPath = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:v:t:S:o:h")) != -1) {
+        switch (opt) {
+            case 'r': config.replicas = atoi(optarg); break;
+            case 's': config.steps = atoi(optarg); break;
+            case 'v': config.maxVisits = atoi(optarg); break;
+            case 't': config.T_inHive = atoi(optarg); break;
+            case 'S': config.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'o': csvPath = optarg; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    config.N = atoi(argv[optind]);
+    config.T_k = atoi(argv[optind + 1]);
+    config.eggsCount = atoi(argv[optind + 2]);
+
+    Ensemble* ensemble = ensembleCreate(&config);
+    if (!ensemble) {
+        fprintf(stderr, "Error: invalid ensemble parameters or out of memory.\n");
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ensembleRun(ensemble);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    const EnsembleReplicaStats* results = ensembleResults(ensemble);
+    int R = config.replicas;
+
+    // Aggregate occupancy, rejection and survival statistics over replicas
+    double occSum = 0, occSq = 0, occMin = INFINITY, occMax = 0;
+    long entries = 0, rejections = 0;
+    int* extinct = malloc(R * sizeof(int));
+    int extinctCount = 0;
+    if (!extinct) {
+        ensembleDestroy(ensemble);
+        return 1;
+    }
+    for (int r = 0; r < R; r++) {
+        double m = results[r].meanOccupancy;
+        occSum += m;
+        occSq += m * m;
+        if (m < occMin) occMin = m;
+        if (m > occMax) occMax = m;
+        entries += results[r].entries;
+        rejections += results[r].rejections;
+        if (results[r].survivalTime >= 0) extinct[extinctCount++] = results[r].survivalTime;
+    }
+    double occMean = occSum / R;
+    double occStd = sqrt(fmax(0.0, occSq / R - occMean * occMean));
+
+    double beeSteps = (double)R * config.N * config.steps;
+    printf("Ensemble: %d replicas x %d bee slots x %d steps in %.3f s (%.1f M bee-steps/s)\n",
+           R, config.N, config.steps, seconds, seconds > 0 ? beeSteps / seconds / 1e6 : 0.0);
+    printf("Mean occupancy:    mean %.3f  std %.3f  min %.3f  max %.3f\n", occMean, occStd, occMin, occMax);
+    printf("Rejection rate:    %.4f (%ld of %ld attempts)\n",
+           entries + rejections ? (double)rejections / (entries + rejections) : 0.0,
+           rejections, entries + rejections);
+    printf("Colony survival:   %d of %d replicas alive after %d s\n", R - extinctCount, R, config.steps);
+    if (extinctCount > 0) {
+        qsort(extinct, extinctCount, sizeof(int), compareInt);
+        printf("Extinction time:   p10 %d  p50 %d  p90 %d\n",
+               extinct[extinctCount / 10], extinct[extinctCount / 2], extinct[extinctCount * 9 / 10]);
+    }
+
+    int bins;
+    const long* histogram = ensembleOccupancyHistogram(ensemble, &bins);
+    double totalSteps = (double)R * config.steps;
+    printf("Occupancy distribution (fraction of replica-steps):\n");
+    for (int b = 0; b < bins; b++) {
+        printf("  %4d  %.4f\n", b, totalSteps > 0 ? histogram[b] / totalSteps : 0.0);
+    }
+
+    if (csvPath) {
+        FILE* csv = fopen(csvPath, "w");
+        if (!csv) {
+            perror("[Ensemble] fopen");
+        } else {
+            fprintf(csv, "replica,meanOccupancy,maxOccupancy,entries,rejections,eggsLaid,survivalTime,finalAlive\n");
+            for (int r = 0; r < R; r++) {
+                const EnsembleReplicaStats* s = &results[r];
+                fprintf(csv, "%d,%.3f,%d,%d,%d,%d,%d,%d\n", r, s->meanOccupancy, s->maxOccupancy,
+                        s->entries, s->rejections, s->eggsLaid, s->survivalTime, s->finalAlive);
+            }
+            fclose(csv);
+        }
+    }
+
+    free(extinct);
+    ensembleDestroy(ensemble);
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "fluid.h"
+#include "ensemble.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+
+/**
+ * Prints the command-line usage of the fluid solver.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options] <N> <T_k> <eggsCount>\n"
+            "Mean-field approximation of the colony for very large hives.\n"
+            "  -v VISITS     Visits after which a bee dies\n"
+            "  -t SECONDS    Time spent inside the hive per visit\n"
+            "  -H SECONDS    Simulated horizon (default: 600)\n"
+            "  -d SECONDS    Integration step (default: 0.05)\n"
+            "  -o FILE       Write the trajectory (one row per second) as CSV to FILE\n"
+            "  -V REPLICAS   Validate against the discrete ensemble engine with REPLICAS colonies\n",
+            prog);
+}
+
+/**
+ * Returns the elapsed time between two timestamps in microseconds.
+ */
+static double elapsedMicros(const struct timespec* a, const struct timespec* b) {
+    return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+/**
+ * validate:
+ * Runs the discrete ensemble engine with the same parameters and compares its
+ * replica-averaged occupancy and final population with the fluid results.
+ *
+ * @param c Fluid parameters.
+ * @param fluid Fluid results for the same horizon.
+ * @param replicas Number of discrete replicas to average.
+ * @return 0 on success, -1 if the discrete engine could not be created.
+ */
+static int validate(const FluidConfig* c, const FluidSummary* fluid, int replicas) {
+    EnsembleConfig ec;
+    ensembleDefaultConfig(&ec);
+    ec.N = (int)c->N;
+    ec.T_k = (int)c->T_k;
+    ec.eggsCount = (int)c->eggsCount;
+    ec.maxVisits = c->maxVisits;
+    ec.T_inHive = (int)c->T_inHive;
+    ec.minOutside = (int)c->minOutside;
+    ec.maxOutside = (int)c->maxOutside;
+    ec.transitsPerStep = (int)c->transitsPerSecond;
+    ec.replicas = replicas;
+    ec.steps = (int)c->horizon;
+
+    Ensemble* ensemble = ensembleCreate(&ec);
+    if (!ensemble) {
+        fprintf(stderr, "Error: parameters are not valid for the discrete engine.\n");
+        return -1;
+    }
+    ensembleRun(ensemble);
+    const EnsembleReplicaStats* results = ensembleResults(ensemble);
+
+    double occupancy = 0, alive = 0, eggs = 0;
+    long entries = 0, rejections = 0;
+    for (int r = 0; r < replicas; r++) {
+        occupancy += results[r].meanOccupancy;
+        alive += results[r].finalAlive;
+        eggs += results[r].eggsLaid;
+        entries += results[r].entries;
+        rejections += results[r].rejections;
+    }
+    occupancy /= replicas;
+    alive /= replicas;
+    eggs /= replicas;
+    double rejectionRate = entries + rejections ? (double)rejections / (entries + rejections) : 0.0;
+    ensembleDestroy(ensemble);
+
+    printf("Validation against %d discrete replicas:\n", replicas);
+    printf("  %-16s %12s %12s %10s\n", "metric", "fluid", "discrete", "rel.err");
+    printf("  %-16s %12.3f %12.3f %9.1f%%\n", "mean occupancy", fluid->meanInside, occupancy,
+           occupancy > 0 ? 100.0 * fabs(fluid->meanInside - occupancy) / occupancy : 0.0);
+    printf("  %-16s %12.3f %12.3f %9.1f%%\n", "final alive", fluid->finalAlive, alive,
+           alive > 0 ? 100.0 * fabs(fluid->finalAlive - alive) / alive : 0.0);
+    printf("  %-16s %12.3f %12.3f %9.1f%%\n", "eggs laid", fluid->eggsLaid, eggs,
+           eggs > 0 ? 100.0 * fabs(fluid->eggsLaid - eggs) / eggs : 0.0);
+    printf("  %-16s %12.4f %12.4f %9.1f%%\n", "rejection rate", fluid->rejectionRate, rejectionRate,
+           rejectionRate > 0 ? 100.0 * fabs(fluid->rejectionRate - rejectionRate) / rejectionRate : 0.0);
+    return 0;
+}
+
+/**
+ * Entry point of the fluid solver.
+ *
+ * Detailed functionality:
+ * 1. Computes the closed-form steady state and the binding capacity constraint.
+ * 2. Integrates the population ODEs over the horizon and reports time-averaged results.
+ * 3. Optionally writes the trajectory and validates it against the discrete engine.
+ */
+int main(int argc, char* argv[]) {
+    FluidConfig config;
+    fluidDefaultConfig(&config);
+    const char* csvPath = NULL;
+    int replicas = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "v:t:H:d:o:V:h")) != -1) {
+        switch (opt) {
+            case 'v': config.maxVisits = atoi(optarg); break;
+            case 't': config.T_inHive = atof(optarg); break;
+            case 'H': config.horizon = atof(optarg); break;
+            case 'd': config.dt = atof(optarg); break;
+            case 'o': csvPath = optarg; break;
+            case 'V': replicas = atoi(optarg); break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    config.N = atof(argv[optind]);
+    config.T_k = atof(argv[optind + 1]);
+    config.eggsCount = atof(argv[optind + 2]);
+    if (!fluidValidConfig(&config)) {
+        fprintf(stderr, "Error: invalid model parameters.\n");
+        return 1;
+    }
+
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    FluidEquilibrium eq;
+    fluidEquilibrium(&config, &eq);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    int maxSamples = (int)config.horizon + 1;
+    FluidSample* samples = csvPath ? calloc(maxSamples, sizeof(FluidSample)) : NULL;
+    FluidSummary summary;
+    int written = fluidSolve(&config, samples, samples ? maxSamples : 0, &summary);
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+
+    printf("Steady state (%.1f us):\n", elapsedMicros(&t0, &t1));
+    printf("  birth rate   %.4f bees/s (limited by %s)\n", eq.birthRate, eq.binding);
+    printf("  alive        %.2f\n", eq.alive);
+    printf("  inside       %.2f (utilization %.1f%%)\n", eq.inside, 100.0 * eq.utilization);
+    printf("  rejection    %.4f\n", eq.rejectionRate);
+    printf("Trajectory over %.0f s (%.1f us):\n", config.horizon, elapsedMicros(&t1, &t2));
+    printf("  mean occupancy  %.3f\n", summary.meanInside);
+    printf("  final alive     %.3f\n", summary.finalAlive);
+    printf("  eggs laid       %.3f\n", summary.eggsLaid);
+    printf("  rejection rate  %.4f\n", summary.rejectionRate);
+
+    if (csvPath) {
+        FILE* csv = fopen(csvPath, "w");
+        if (!csv) {
+            perror("[Fluid] fopen");
+        } else {
+            fprintf(csv, "t,outside,queued,inside,dead,birthRate\n");
+            for (int i = 0; i < written; i++) {
+                const FluidSample* s = &samples[i];
+                fprintf(csv, "%.2f,%.4f,%.4f,%.4f,%.4f,%.5f\n", s->t, s->outside, s->queued,
+                        s->inside, s->dead, s->birthRate);
+            }
+            fclose(csv);
+        }
+    }
+    free(samples);
+
+    if (replicas > 0 && validate(&config, &summary, replicas) == -1) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/**
+ * Maximum number of values accepted for a single swept parameter.
+ */
+#define MAX_AXIS_VALUES 64
+
+/**
+ * A single swept parameter: the option passed to beehive_simulation and its values.
+ */
+typedef struct {
+    const char* name;               // Column name in the result table.
+    int values[MAX_AXIS_VALUES];    // Values to explore.
+    int count;                      // Number of values in the axis.
+} SweepAxis;
+
+/**
+ * Indexes of the swept parameters, in the order they vary in the grid
+ * (the last axis varies fastest).
+ */
+enum { AXIS_N, AXIS_TK, AXIS_EGGS, AXIS_VISITS, AXIS_TIN, AXIS_COUNT };
+
+/**
+ * State of a single grid point: its parameters, working directory, and process.
+ */
+typedef struct {
+    int params[AXIS_COUNT]; // Parameter values of this run.
+    char dir[PATH_MAX];     // Directory holding the run's beehive.log and summary.
+    pid_t pid;              // Simulation process, or 0 if not started / finished.
+    int status;             // Exit status reported by waitpid.
+    double meanOccupancy;   // Metrics read back from the summary file.
+    double rejectionRate;
+    double survivalTime;
+    int entries;
+    int rejections;
+    bool ok;                // Whether the run exited successfully and its summary was read.
+} SweepRun;
+
+/**
+ * Prints the command-line usage of the sweep driver.
+ *
+ * @param prog Name of the executable (argv[0]).
+ */
+static void printUsage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Runs isolated beehive_simulation instances over a parameter grid in parallel.\n"
+            "Every grid option takes a comma-separated list of values.\n"
+            "  -N LIST          Initial hive sizes (default: 10)\n"
+            "  -T LIST          Egg-laying intervals T_k (default: 5)\n"
+            "  -e LIST          Eggs per cycle (default: 2)\n"
+            "  -v LIST          Bee visit limits (default: simulation default)\n"
+            "  -t LIST          Time in hive per visit (default: simulation default)\n"
+            "  -d SECONDS       Duration of every run (default: 60)\n"
+            "  -j JOBS          Concurrent runs (default: number of online CPUs)\n"
+            "  -o DIR           Output directory (default: sweep_out)\n"
+            "  -b PATH          Simulation binary (default: ./beehive_simulation)\n",
+            prog);
+}
+
+/**
+ * parseList:
+ * Parses a comma-separated list of positive integers into an axis.
+ *
+ * @param text The list to parse.
+ * @param axis The axis receiving the values.
+ * @return 0 on success, -1 if the list is malformed.
+ */
+static int parseList(const char* text, SweepAxis* axis) {
+    axis->count = 0;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long value = strtol(p, &end, 10);
+        if (end == p || value <= 0 || value > INT_MAX || axis->count == MAX_AXIS_VALUES) {
+            return -1;
+        }
+        axis->values[axis->count++] = (int)value;
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        p = end;
+    }
+    return axis->count > 0 ? 0 : -1;
+}
+
+/**
+ * readSummary:
+ * Reads the key=value summary written by beehive_simulation --summary. The summary of a
+ * run that did not exit successfully is not trusted, even if one was written.
+ *
+ * @param run The run whose summary should be loaded.
+ */
+static void readSummary(SweepRun* run) {
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s/summary.txt", run->dir);
+    FILE* in = NULL;
+    if (WIFEXITED(run->status) && WEXITSTATUS(run->status) == 0) {
+        in = fopen(path, "r");
+    }
+    if (!in) {
+        run->ok = false;
+        return;
+    }
+
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        char* eq = strchr(line, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        const char* value = eq + 1;
+        if (strcmp(line, "meanOccupancy") == 0) run->meanOccupancy = atof(value);
+        else if (strcmp(line, "rejectionRate") == 0) run->rejectionRate = atof(value);
+        else if (strcmp(line, "survivalTime") == 0) run->survivalTime = atof(value);
+        else if (strcmp(line, "entries") == 0) run->entries = atoi(value);
+        else if (strcmp(line, "rejections") == 0) run->rejections = atoi(value);
+    }
+    fclose(in);
+    run->ok = true;
+}
+
+/**
+ * startRun:
+ * Forks a simulation instance inside the run's own directory and process group.
+ * Every instance creates private shared memory segments and writes its own
+ * beehive.log, so concurrent runs never interfere with each other.
+ *
+ * @param run The run to start.
+ * @param binary Absolute path of the simulation binary.
+ * @param duration Duration of the run in seconds.
+ * @param axes Swept axes, used to tell which optional parameters were given.
+ */
+static void startRun(SweepRun* run, const char* binary, int duration, const SweepAxis* axes) {
+    // Run directories are reused, and a summary from an earlier sweep must not pass for this run's
+    char summary[PATH_MAX + 16];
+    snprintf(summary, sizeof(summary), "%s/summary.txt", run->dir);
+    if (unlink(summary) == -1 && errno != ENOENT) {
+        perror("[Sweep] unlink summary.txt");
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("[Sweep] fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid > 0) {
+        run->pid = pid;
+        return;
+    }
+
+    if (chdir(run->dir) == -1) {
+        perror("[Sweep] chdir");
+        _exit(127);
+    }
+    setpgid(0, 0);
+
+    // Console logging is disabled; anything else the simulation prints goes to console.txt
+    int fd = open("console.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+
+    char args[AXIS_COUNT + 1][16];
+    char* argv[20];
+    int argc = 0;
+    argv[argc++] = (char*)binary;
+    argv[argc++] = "--quiet";
+    argv[argc++] = "--summary";
+    argv[argc++] = "summary.txt";
+    snprintf(args[AXIS_COUNT], sizeof(args[AXIS_COUNT]), "%d", duration);
+    argv[argc++] = "--duration";
+    argv[argc++] = args[AXIS_COUNT];
+    for (int a = 0; a < AXIS_COUNT; a++) {
+        snprintf(args[a], sizeof(args[a]), "%d", run->params[a]);
+    }
+    if (axes[AXIS_VISITS].count > 0) {
+        argv[argc++] = "--max-visits";
+        argv[argc++] = args[AXIS_VISITS];
+    }
+    if (axes[AXIS_TIN].count > 0) {
+        argv[argc++] = "--time-in-hive";
+        argv[argc++] = args[AXIS_TIN];
+    }
+    argv[argc++] = args[AXIS_N];
+    argv[argc++] = args[AXIS_TK];
+    argv[argc++] = args[AXIS_EGGS];
+    argv[argc] = NULL;
+
+    execv(binary, argv);
+    perror("[Sweep] execv");
+    _exit(127);
+}
+
+/**
+ * Entry point of the parameter sweep driver.
+ *
+ * Detailed functionality:
+ * 1. Parses the parameter grid and expands it into individual runs.
+ * 2. Keeps up to JOBS simulation instances running concurrently, each isolated
+ *    in its own directory, process group, and shared memory segments.
+ * 3. Collects the per-run summaries into one table printed to stdout and
+ *    written to DIR/results.csv.
+ */
+int main(int argc, char* argv[]) {
+    SweepAxis axes[AXIS_COUNT] = {
+        {"N", {10}, 1},
+        {"T_k", {5}, 1},
+        {"eggs", {2}, 1},
+        {"visits", {0}, 0},
+        {"T_in", {0}, 0},
+    };
+    int duration = 60;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* outDir = "sweep_out";
+    const char* binary = "./beehive_simulation";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "N:T:e:v:t:d:j:o:b:h")) != -1) {
+        int axis = -1;
+        switch (opt) {
+            case 'N': axis = AXIS_N; break;
+            case 'T': axis = AXIS_TK; break;
+            case 'e': axis = AXIS_EGGS; break;
+            case 'v': axis = AXIS_VISITS; break;
+            case 't': axis = AXIS_TIN; break;
+            case 'd': duration = atoi(optarg); break;
+            case 'j': jobs = atol(optarg); break;
+            case 'o': outDir = optarg; break;
+            case 'b': binary = optarg; break;
+            default:
+                printUsage(argv[0]);
+                return 1;
+        }
+        if (axis >= 0 && parseList(optarg, &axes[axis]) == -1) {
+            fprintf(stderr, "Error: invalid value list '%s' for -%c.\n", optarg, opt);
+            return 1;
+        }
+    }
+
+    if (duration <= 0 || jobs <= 0) {
+        fprintf(stderr, "Error: duration and job count must be positive.\n");
+        return 1;
+    }
+
+    char binaryPath[PATH_MAX];
+    if (realpath(binary, binaryPath) == NULL || access(binaryPath, X_OK) == -1) {
+        fprintf(stderr, "Error: simulation binary '%s' is not executable.\n", binary);
+        return 1;
+    }
+
+    if (mkdir(outDir, 0755) == -1 && errno != EEXIST) {
+        perror("[Sweep] mkdir");
+        return 1;
+    }
+
+    // Expand the grid
+    int total = 1;
+    for (int a = 0; a < AXIS_COUNT; a++) {
+        if (axes[a].count > 0) total *= axes[a].count;
+    }
+    SweepRun* runs = calloc(total, sizeof(SweepRun));
+    if (!runs) {
+        perror("[Sweep] calloc");
+        return 1;
+    }
+    for (int r = 0; r < total; r++) {
+        int rest = r;
+        for (int a = AXIS_COUNT - 1; a >= 0; a--) {
+            if (axes[a].count == 0) continue;
+            runs[r].params[a] = axes[a].values[rest % axes[a].count];
+            rest /= axes[a].count;
+        }
+        snprintf(runs[r].dir, sizeof(runs[r].dir), "%s/run_%04d", outDir, r);
+        if (mkdir(runs[r].dir, 0755) == -1 && errno != EEXIST) {
+            perror("[Sweep] mkdir");
+            return 1;
+        }
+    }
+
+    printf("[Sweep] %d runs of %d s, %ld concurrent.\n", total, duration, jobs);
+    fflush(stdout);
+
+    // Keep the job slots filled until every run has finished
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    int next = 0, running = 0, done = 0;
+    while (done < total) {
+        while (running < jobs && next < total) {
+            startRun(&runs[next++], binaryPath, duration, axes);
+            running++;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid == -1) {
+            if (errno == EINTR) continue;
+            perror("[Sweep] wait");
+            break;
+        }
+        for (int r = 0; r < next; r++) {
+            if (runs[r].pid == pid) {
+                runs[r].pid = 0;
+                runs[r].status = status;
+                readSummary(&runs[r]);
+                running--;
+                done++;
+                fprintf(stderr, "[Sweep] %d/%d runs finished.\n", done, total);
+                break;
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    // Aggregate the results into one table
+    char csvPath[PATH_MAX + 16];
+    snprintf(csvPath, sizeof(csvPath), "%s/results.csv", outDir);
+    FILE* csv = fopen(csvPath, "w");
+    if (!csv) {
+        perror("[Sweep] fopen results.csv");
+    }
+
+    printf("%-6s", "run");
+    for (int a = 0; a < AXIS_COUNT; a++) {
+        if (axes[a].count > 0) printf(" %7s", axes[a].name);
+    }
+    printf(" %9s %8s %10s %9s %9s\n", "meanOcc", "entries", "rejections", "rejRate", "survival");
+    if (csv) {
+        fprintf(csv, "run");
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            if (axes[a].count > 0) fprintf(csv, ",%s", axes[a].name);
+        }
+        fprintf(csv, ",meanOccupancy,entries,rejections,rejectionRate,survivalTime,status\n");
+    }
+
+    for (int r = 0; r < total; r++) {
+        SweepRun* run = &runs[r];
+        printf("%-6d", r);
+        for (int a = 0; a < AXIS_COUNT; a++) {
+            if (axes[a].count > 0) printf(" %7d", run->params[a]);
+        }
+        if (run->ok) {
+            printf(" %9.3f %8d %10d %9.4f %9.2f\n", run->meanOccupancy, run->entries,
+                   run->rejections, run->rejectionRate, run->survivalTime);
+        } else {
+            printf("  (failed, see %s/console.txt)\n", run->dir);
+        }
+        if (csv) {
+            fprintf(csv, "%d", r);
+            for (int a = 0; a < AXIS_COUNT; a++) {
+                if (axes[a].count > 0) fprintf(csv, ",%d", run->params[a]);
+            }
+            fprintf(csv, ",%.3f,%d,%d,%.4f,%.2f,%d\n", run->meanOccupancy, run->entries,
+                    run->rejections, run->rejectionRate, run->survivalTime,
+                    run->ok ? 0 : (WIFEXITED(run->status) && WEXITSTATUS(run->status) != 0 ? WEXITSTATUS(run->status) : -1));
+        }
+    }
+    if (csv) fclose(csv);
+
+    double wall = (finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("[Sweep] Completed %d runs in %.1f s. Results written to %s.\n", total, wall, csvPath);
+    free(runs);
+    return 0;
+}